@@ -4,6 +4,7 @@ import rectpack
 import argparse
 import shutil
 import subprocess
+import struct
 import re
 
 from pathlib import (
@@ -33,24 +34,104 @@ from taiseilib.common import (
 )
 
 
-def write_sprite_def(dst, texture, region, size, overrides=None):
+# Must match the reader in src/resource/spritemap.c
+spritemap_magic = b'TAISEISM'
+spritemap_version = 1
+
+autogen_header = '# Autogenerated by the atlas packer, do not modify'
+
+sprite_keys = {
+    'texture': str,
+    'region_x': float,
+    'region_y': float,
+    'region_w': float,
+    'region_h': float,
+    'w': float,
+    'h': float,
+}
+
+animation_keys = {
+    'rows': int,
+    'cols': int,
+    'speed': int,
+}
+
+
+def parse_keyvalue(path, keys):
+    result = {}
+
+    for lineno, line in enumerate(path.read_text().splitlines(), 1):
+        line = line.strip()
+
+        if not line or line.startswith('#'):
+            continue
+
+        try:
+            key, val = (x.strip() for x in line.split('=', 1))
+            result[key] = keys[key](val)
+        except (ValueError, KeyError):
+            raise TaiseiError('{}:{}: bad line: {}'.format(path, lineno, line))
+
+    return result
+
+
+def write_spritemap(dst, sprites, animations):
+    """
+    Writes a binary manifest with all the sprite definitions of an atlas, as well as the animations made out of them.
+    The game reads it in one go instead of opening a .spr file for every sprite.
+
+    All values are little-endian. The header is followed by the sprite records, the animation records, and the
+    string table, which holds NUL-terminated names. Strings are referenced by their offset into the table.
+
+        header:     magic[8] version:u32 num_sprites:u32 num_animations:u32 strings_size:u32
+        sprite:     name:u32 texture:u32 region_x:f32 region_y:f32 region_w:f32 region_h:f32 w:f32 h:f32
+        animation:  name:u32 rows:i32 cols:i32 speed:i32
+    """
+
+    strings = bytearray()
+    string_offsets = {}
+
+    def string(s):
+        if s not in string_offsets:
+            string_offsets[s] = len(strings)
+            strings.extend(s.encode('utf-8') + b'\0')
+
+        return string_offsets[s]
+
+    records = bytearray()
+
+    for name, spr in sorted(sprites.items()):
+        records += struct.pack('<II6f',
+            string(name),
+            string(spr['texture']),
+            spr['region_x'], spr['region_y'], spr['region_w'], spr['region_h'],
+            # 0 means inferred from the region size
+            spr.get('w', 0), spr.get('h', 0),
+        )
+
+    for name, ani in sorted(animations.items()):
+        records += struct.pack('<Iiii', string(name), ani['rows'], ani['cols'], ani['speed'])
+
+    header = struct.pack('<8sIIII', spritemap_magic, spritemap_version, len(sprites), len(animations), len(strings))
+
     dst.parent.mkdir(exist_ok=True, parents=True)
+    dst.write_bytes(header + records + strings)
 
-    text = (
-        '# Autogenerated by the atlas packer, do not modify\n\n'
-        'texture = {texture}\n'
-        'region_x = {region[0]}\n'
-        'region_y = {region[1]}\n'
-        'region_w = {region[2]}\n'
-        'region_h = {region[3]}\n'
-        # 'w = {size[0]}\n'
-        # 'h = {size[1]}\n'
-    ).format(texture=texture, region=region, size=size)
 
-    if overrides is not None:
-        text += '\n# -- Pasted from the override file --\n\n{}\n'.format(overrides.strip())
+def is_generated_sprite_def(path, atlasname):
+    """
+    Checks whether a .spr file was written by an older version of this script for the given atlas.
+    Those have to go, because loose sprite files take priority over the manifest.
+    """
+
+    try:
+        text = path.read_text()
+    except UnicodeDecodeError:
+        return False
 
-    update_text_file(dst, text)
+    return text.startswith(autogen_header) and re.search(
+        r'^texture = atlas_{}_\d+$'.format(re.escape(atlasname)), text, re.MULTILINE
+    ) is not None
 
 
 def write_override_template(dst, size):
@@ -158,6 +239,8 @@ def gen_atlas(overrides, src, dst, binsize, atlasname, border=1, force_single=Fa
         # Yeah I'm too lazy to use Popen properly
         executor = stack.enter_context(ThreadPoolExecutor())
 
+        sprites = {}
+
         for i, bin in enumerate(packer):
             textureid = 'atlas_{}_{}'.format(atlasname, i)
             dstfile = temp_dst / '{}.png'.format(textureid)
@@ -201,19 +284,20 @@ def gen_atlas(overrides, src, dst, binsize, atlasname, border=1, force_single=Fa
 
                 override_path = overrides / get_override_file_name(name)
 
+                sprite = {
+                    'texture': textureid,
+                    'region_x': region[0],
+                    'region_y': region[1],
+                    'region_w': region[2] - region[0],
+                    'region_h': region[3] - region[1],
+                }
+
                 if override_path.exists():
-                    override_contents = override_path.read_text()
+                    sprite.update(parse_keyvalue(override_path, sprite_keys))
                 else:
-                    override_contents = None
                     write_override_template(override_path, img.size)
 
-                write_sprite_def(
-                    temp_dst / '{}.spr'.format(name),
-                    textureid,
-                    (region[0], region[1], region[2] - region[0], region[3] - region[1]),
-                    img.size,
-                    overrides=override_contents
-                )
+                sprites[name] = sprite
 
             print('Atlas texture area: ', rootimg.size[0] * rootimg.size[1])
             rootimg.save(dstfile)
@@ -221,6 +305,17 @@ def gen_atlas(overrides, src, dst, binsize, atlasname, border=1, force_single=Fa
             if leanify:
                 executor.submit(lambda: subprocess.check_call(["leanify", str(dstfile)]))
 
+        # Animations are defined in the overrides directory, next to the overrides of their frames
+        animations = {}
+
+        for path in overrides.glob('**/*.ani'):
+            name = path.relative_to(overrides).with_suffix('').as_posix()
+
+            if '{}.frame0000'.format(name) in sprites:
+                animations[name] = parse_keyvalue(path, animation_keys)
+
+        write_spritemap(temp_dst / 'atlas_{}.spritemap'.format(atlasname), sprites, animations)
+
         # Wait for leanify to complete
         executor.shutdown(wait=True)
 
@@ -228,6 +323,10 @@ def gen_atlas(overrides, src, dst, binsize, atlasname, border=1, force_single=Fa
         for path in dst.glob('atlas_{}_*.png'.format(atlasname)):
             path.unlink()
 
+        for path in dst.glob('**/*.spr'):
+            if is_generated_sprite_def(path, atlasname):
+                path.unlink()
+
         targets = list(temp_dst.glob('**/*'))
 
         for dir in (p.relative_to(temp_dst) for p in targets if p.is_dir()):
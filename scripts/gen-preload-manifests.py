@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+
+import argparse
+import re
+import struct
+
+from pathlib import (
+    Path,
+)
+
+from taiseilib.common import (
+    run_main,
+    update_text_file,
+    TaiseiError,
+)
+
+
+# Stage IDs and the sources of their scripts; see stage.c
+stages = {
+    1: ['stage1.c', 'stage1_events.c'],
+    2: ['stage2.c', 'stage2_events.c'],
+    3: ['stage3.c', 'stage3_events.c'],
+    4: ['stage4.c', 'stage4_events.c'],
+    5: ['stage5.c', 'stage5_events.c'],
+    6: ['stage6.c', 'stage6_events.c'],
+}
+
+string_arg = r'\s*"([^"]+)"'
+
+# (resource type, call pattern with the name as the first capture, name template)
+calls = [
+    ('sound',     r'\b(?:play_sound|play_sound_ex|play_sound_delayed|play_loop|PLAY_FOR)\(' + string_arg, '{}'),
+    ('sound',     r'\b(?:FROM_TO_SND|FROM_TO_INT_SND)\(' + string_arg, '{}'),
+    ('bgm',       r'\bstage_start_bgm\(' + string_arg, '{}'),
+    ('shader',    r'\bget_shader(?:_optional)?\(' + string_arg, '{}'),
+    ('model',     r'\bdraw_model\(' + string_arg, '{}'),
+    ('texture',   r'\bget_tex\(' + string_arg, '{}'),
+    ('sprite',    r'\bget_sprite\(' + string_arg, '{}'),
+    ('sprite',    r'\bdraw_sprite(?:_unaligned)?\([^;"]*?' + string_arg, '{}'),
+    ('animation', r'\bget_ani\(' + string_arg, '{}'),
+    ('animation', r'\bcreate_boss\(' + string_arg + r',' + string_arg, 'boss/{1}'),
+    ('sprite',    r'\bcreate_boss\(' + string_arg + r',' + string_arg + r',' + string_arg, '{2}'),
+]
+
+
+def spritemap_names(path):
+    """
+    Returns the sprite and animation names defined in a sprite map written by gen-atlases.py.
+    """
+
+    data = path.read_bytes()
+    magic, version, num_sprites, num_animations, strings_size = struct.unpack_from('<8sIIII', data)
+
+    if magic != b'TAISEISM' or version != 1:
+        raise TaiseiError('{}: not a sprite map'.format(path))
+
+    strings = data[len(data) - strings_size:]
+    string = lambda ofs: strings[ofs:strings.index(b'\0', ofs)].decode('utf-8')
+
+    sprites = [string(struct.unpack_from('<I', data, 24 + i * 32)[0]) for i in range(num_sprites)]
+    ofs = 24 + num_sprites * 32
+    animations = [string(struct.unpack_from('<I', data, ofs + i * 16)[0]) for i in range(num_animations)]
+
+    return sprites, animations
+
+
+def known_resources(resdir):
+    """
+    Finds the names of all the resources of each type, so that only the ones that exist end up in a manifest.
+    """
+
+    def names(subdir, *exts):
+        root = resdir / subdir
+        return {p.relative_to(root).with_suffix('').as_posix() for ext in exts for p in root.glob('**/*' + ext)}
+
+    known = {
+        'sound': names('sfx', '.ogg', '.wav'),
+        'bgm': names('bgm', '.bgm'),
+        'shader': names('shader', '.sha'),
+        'model': names('models', '.obj'),
+        'texture': names('gfx', '.png', '.jpg'),
+        'sprite': names('gfx', '.spr', '.png', '.jpg'),
+        'animation': names('gfx', '.ani'),
+    }
+
+    for path in (resdir / 'gfx').glob('*.spritemap'):
+        sprites, animations = spritemap_names(path)
+        known['sprite'].update(sprites)
+        known['animation'].update(animations)
+
+    return known
+
+
+def scan_stage(sources, known):
+    entries = set()
+
+    for src in sources:
+        text = src.read_text()
+
+        for restype, pattern, template in calls:
+            for m in re.finditer(pattern, text):
+                entries.add((restype, template.format(*m.groups())))
+
+        # projectile and particle sprites are relative to proj/ and part/; the sprite can be given either as the
+        # first argument or as a designated initializer anywhere in the argument list
+        for m in re.finditer(r'\b(PROJECTILE|PARTICLE)\(' + string_arg, text):
+            entries.add(('sprite', '{}/{}'.format('proj' if m.group(1) == 'PROJECTILE' else 'part', m.group(2))))
+
+        for m in re.finditer(r'\.sprite\s*=' + string_arg, text):
+            spawn = max(text.rfind('PROJECTILE(', 0, m.start()), text.rfind('PARTICLE(', 0, m.start()))
+
+            if spawn >= 0:
+                prefix = 'proj' if text.startswith('PROJECTILE(', spawn) else 'part'
+                entries.add(('sprite', '{}/{}'.format(prefix, m.group(1))))
+
+    return {(t, n) for t, n in entries if n in known[t]}
+
+
+def read_manifest(path):
+    entries = set()
+
+    if path.exists():
+        for line in path.read_text().splitlines():
+            line = line.strip()
+
+            if line and not line.startswith('#'):
+                restype, name = (x.strip() for x in line.split('=', 1))
+                entries.add((restype, name))
+
+    return entries
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description='Generate per-stage preload manifests from the stage sources', prog=args[0])
+
+    parser.add_argument('stages_dir',
+        help='Directory with the stage sources (src/stages)',
+        type=Path,
+    )
+
+    parser.add_argument('resources_dir',
+        help='Resources directory; the manifests are written into its preload subdirectory',
+        type=Path,
+    )
+
+    args = parser.parse_args(args[1:])
+    known = known_resources(args.resources_dir)
+
+    for stage_id, sources in stages.items():
+        name = 'stage{:04x}'.format(stage_id)
+        dst = args.resources_dir / 'preload' / '{}.preload'.format(name)
+
+        # keep whatever a recording (TAISEI_PRELOAD_RECORD=1) added; it sees the names that are built at runtime
+        entries = scan_stage([args.stages_dir / s for s in sources], known) | read_manifest(dst)
+
+        text = '# Resources used by {}, recorded with TAISEI_PRELOAD_RECORD=1 or found by {}\n'.format(
+            name, Path(__file__).name
+        )
+        text += ''.join(sorted('{} = {}\n'.format(*e) for e in entries))
+
+        update_text_file(dst, text)
+        print('{}: {} entries'.format(dst, len(entries)))
+
+
+if __name__ == '__main__':
+    run_main(main)
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+
+import argparse
+import struct
+
+from pathlib import (
+    Path,
+)
+
+from taiseilib.common import (
+    run_main,
+)
+
+# See replay.h; this writes REPLAY_STRUCT_VERSION_TS102000_REV3, uncompressed
+replay_magic = bytes((0x68, 0x6f, 0x6e, 0x6f, 0xe2, 0x9d, 0xa4, 0x75, 0x6d, 0x69))
+replay_version = 9
+replay_useless_byte = 0x69
+
+REPLAY_SFLAG_VISUAL_RNG = 1 << 3
+
+# player.h and config.h
+EV_PRESS, EV_RELEASE, EV_OVER = 0, 1, 2
+KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_FOCUS, KEY_SHOT, KEY_BOMB = range(7)
+
+D_Normal = 2
+VIEWPORT_W, VIEWPORT_H = 480, 560
+
+
+def scripted_input(length):
+    """
+    Holds the shot button and weaves left and right, focusing every other sweep, so that the player's
+    movement, shots and the enemies' reactions to them all feed into the logic checksums. The shot
+    button is pressed again before every sweep, which also pages through dialogs.
+
+    A replayed player can't run out of lives, and boss attacks eventually time out, so a long enough
+    replay plays through the whole stage.
+    """
+
+    events = [(1, EV_PRESS, KEY_SHOT)]
+    frame = 60
+    sweep = 0
+
+    while frame + 120 < length:
+        key = KEY_LEFT if sweep % 2 == 0 else KEY_RIGHT
+
+        events.append((frame - 1, EV_RELEASE, KEY_SHOT))
+        events.append((frame, EV_PRESS, KEY_SHOT))
+
+        if sweep % 4 >= 2:
+            events.append((frame, EV_PRESS, KEY_FOCUS))
+
+        events.append((frame, EV_PRESS, key))
+        events.append((frame + 40, EV_RELEASE, key))
+
+        if sweep % 4 >= 2:
+            events.append((frame + 40, EV_RELEASE, KEY_FOCUS))
+
+        frame += 80
+        sweep += 1
+
+    events.append((length, EV_OVER, 0))
+    return events
+
+
+def write_replay(dst, stage, seed, length):
+    events = scripted_input(length)
+
+    stageinfo = dict(
+        flags=REPLAY_SFLAG_VISUAL_RNG,
+        stage=stage,
+        seed=seed,
+        diff=D_Normal,
+        plr_points=0,
+        plr_continues_used=0,
+        plr_char=0,  # Marisa
+        plr_shot=0,  # laser
+        plr_pos_x=VIEWPORT_W // 2,
+        plr_pos_y=VIEWPORT_H - 64,
+        plr_focus=0,
+        plr_power=0,
+        plr_lives=9, # the scripted player is not very good at dodging
+        plr_life_fragments=0,
+        plr_bombs=3,
+        plr_bomb_fragments=0,
+        plr_inputflags=0,
+        plr_graze=0,
+        numevents=len(events),
+    )
+
+    # replay_calc_stageinfo_checksum()
+    checksum = sum(stageinfo.values()) & 0xFFFFFFFF
+
+    playername = b'test'
+    data = replay_magic + struct.pack('<H', replay_version)
+    data += struct.pack('<BBBH', 1, 2, 0, 0)  # game version
+    data += struct.pack('<B', len(playername)) + playername
+    data += struct.pack('<IH', 0, 1)  # flags, number of stages
+
+    s = stageinfo
+    data += struct.pack('<IHIBIBBBHHBHBBBBBHH',
+        s['flags'], s['stage'], s['seed'], s['diff'], s['plr_points'], s['plr_continues_used'],
+        s['plr_char'], s['plr_shot'], s['plr_pos_x'], s['plr_pos_y'], s['plr_focus'], s['plr_power'],
+        s['plr_lives'], s['plr_life_fragments'], s['plr_bombs'], s['plr_bomb_fragments'], s['plr_inputflags'],
+        s['plr_graze'], s['numevents'],
+    )
+    data += struct.pack('<I', -checksum & 0xFFFFFFFF)
+
+    for frame, evtype, value in events:
+        data += struct.pack('<IBH', frame, evtype, value)
+
+    data += bytes((replay_useless_byte,))
+    dst.write_bytes(data)
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description='Generate a replay with scripted input, for tests', prog=args[0])
+
+    parser.add_argument('output',
+        help='Replay file to write',
+        type=Path,
+    )
+
+    parser.add_argument('--stage', '-s',
+        help='Stage ID (default: 1)',
+        default=1,
+        type=int,
+    )
+
+    parser.add_argument('--seed',
+        help='Random seed (default: 1)',
+        default=1,
+        type=int,
+    )
+
+    parser.add_argument('--frames', '-f',
+        help='Length of the replay in logic frames (default: 3600)',
+        default=3600,
+        type=int,
+    )
+
+    args = parser.parse_args(args[1:])
+    write_replay(args.output, args.stage, args.seed, args.frames)
+
+
+if __name__ == '__main__':
+    run_main(main)
@@ -1,8 +1,11 @@
 #!/usr/bin/env python3
 
 import os
+import struct
 import sys
-from zipfile import ZipFile, ZIP_DEFLATED
+import zlib
+from bisect import bisect_left
+from zipfile import ZipFile, ZIP_DEFLATED, ZIP_STORED
 
 from taiseilib.common import write_depfile
 
@@ -12,14 +15,150 @@ sourcedir = sys.argv[2]
 depfile = sys.argv[3]
 directories = sys.argv[4:]
 
-with ZipFile(archive, "w", ZIP_DEFLATED) as zf:
+# Formats that are either compressed already, or big enough that we'd rather read them straight from the
+# memory-mapped archive than decompress them into a buffer. The game loads stored entries without copying.
+stored_exts = ('.png', '.jpg', '.ogg', '.ttf', '.otf')
+
+
+def collect_files():
     for directory in directories:
         for root, dirs, files in os.walk(directory):
             for fn in files:
                 abspath = os.path.join(root, fn)
                 rel = os.path.join(os.path.basename(directory), os.path.relpath(abspath, directory))
-                zf.write(abspath, rel)
+                yield rel.replace(os.sep, '/'), abspath
+
+
+def write_zip(files):
+    with ZipFile(archive, "w", ZIP_DEFLATED) as zf:
+        for rel, abspath in files:
+            compression = ZIP_STORED if rel.lower().endswith(stored_exts) else ZIP_DEFLATED
+            zf.write(abspath, rel, compress_type=compression)
+
+
+# See src/vfs/packfile.h for a description of the format.
+TPK_MAGIC = b'TAISEIPK'
+TPK_VERSION = 1
+TPK_HEADER = struct.Struct('<8sIIIIQQQQ')
+TPK_ENTRY = struct.Struct('<IIIIQQQII')
+TPK_ENTRY_DIR = 1
+TPK_ENTRY_ZLIB = 2
+TPK_PAGE_SIZE = 4096
+
+
+def fnv1a32(data):
+    h = 2166136261
+
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+
+    return h
+
+
+def align(n, alignment):
+    return (n + alignment - 1) // alignment * alignment
+
+
+def write_tpk(files):
+    contents = {}
+
+    for rel, abspath in files:
+        contents[rel] = abspath
+        parts = rel.split('/')
+
+        for i in range(1, len(parts)):
+            contents.setdefault('/'.join(parts[:i]), None)
+
+    # bytewise order, so that everything inside a directory ends up in one contiguous run
+    names = sorted(contents, key=lambda n: n.encode('utf-8'))
+    keys = [n.encode('utf-8') for n in names]
+
+    num_buckets = 1
+    while num_buckets < len(names) * 2:
+        num_buckets *= 2
+
+    buckets = [0] * num_buckets
+
+    for i, key in enumerate(keys):
+        b = fnv1a32(key) & (num_buckets - 1)
+
+        while buckets[b]:
+            b = (b + 1) & (num_buckets - 1)
+
+        buckets[b] = i + 1
+
+    names_blob = bytearray()
+    name_offsets = []
+
+    for key in keys:
+        name_offsets.append(len(names_blob))
+        names_blob += key + b'\0'
+
+    entries_offset = TPK_HEADER.size
+    buckets_offset = entries_offset + TPK_ENTRY.size * len(names)
+    names_offset = buckets_offset + 4 * num_buckets
+    data_offset = align(names_offset + len(names_blob), 8)
+
+    entries = []
+    blobs = []
+
+    for i, (name, key) in enumerate(zip(names, keys)):
+        abspath = contents[name]
+
+        if abspath is None:
+            prefix = key + b'/'
+            first = bisect_left(keys, prefix)
+            end = bisect_left(keys, key + b'0')  # '0' comes right after '/'
+            entries.append(TPK_ENTRY.pack(name_offsets[i], len(key), fnv1a32(key), TPK_ENTRY_DIR, first, end - first, 0, 0, 0))
+            continue
+
+        with open(abspath, 'rb') as f:
+            data = f.read()
+
+        flags = 0
+        stored = data
+
+        if not name.lower().endswith(stored_exts):
+            compressed = zlib.compress(data, 9)
+
+            if len(compressed) < len(data):
+                flags |= TPK_ENTRY_ZLIB
+                stored = compressed
+
+        if not flags & TPK_ENTRY_ZLIB:
+            # read in place from the mapped package, so keep it page-aligned
+            data_offset = align(data_offset, TPK_PAGE_SIZE)
+
+        entries.append(TPK_ENTRY.pack(
+            name_offsets[i], len(key), fnv1a32(key), flags,
+            data_offset, len(stored), len(data), zlib.crc32(data) & 0xFFFFFFFF, 0
+        ))
+
+        blobs.append((data_offset, stored))
+        data_offset += len(stored)
+
+    with open(archive, 'wb') as out:
+        out.write(TPK_HEADER.pack(
+            TPK_MAGIC, TPK_VERSION, len(names), num_buckets, 0,
+            entries_offset, buckets_offset, names_offset, len(names_blob)
+        ))
+
+        out.write(b''.join(entries))
+        out.write(struct.pack('<{}I'.format(num_buckets), *buckets))
+        out.write(names_blob)
+
+        for offset, blob in blobs:
+            out.write(b'\0' * (offset - out.tell()))
+            out.write(blob)
+
+
+files = sorted(collect_files())
+
+if archive.endswith('.tpk'):
+    write_tpk(files)
+else:
+    write_zip(files)
 
-    write_depfile(depfile, archive,
-        [os.path.join(sourcedir, x) for x in zf.namelist()] + [__file__]
-    )
+write_depfile(depfile, archive,
+    [os.path.join(sourcedir, rel) for rel, abspath in files] + [__file__]
+)
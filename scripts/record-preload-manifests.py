@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+import argparse
+import os
+import subprocess
+import tempfile
+
+from pathlib import (
+    Path,
+)
+
+from taiseilib.common import (
+    add_common_args,
+    run_main,
+    update_text_file,
+)
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description='Record the stage preload manifests by playing replays with TAISEI_PRELOAD_RECORD=1', prog=args[0])
+
+    parser.add_argument('executable',
+        help='Taisei executable',
+        type=Path,
+    )
+
+    parser.add_argument('replays',
+        help='Replays to play; together they should cover every stage',
+        type=Path,
+        nargs='+',
+    )
+
+    add_common_args(parser)
+    args = parser.parse_args(args[1:])
+
+    resources = args.rootdir / 'resources'
+
+    with tempfile.TemporaryDirectory() as storage:
+        env = dict(os.environ,
+            TAISEI_RES_PATH=str(resources),
+            TAISEI_STORAGE_PATH=storage,
+            TAISEI_PRELOAD_RECORD='1',
+            TAISEI_FLIGHTREC='0',
+            SDL_VIDEODRIVER='dummy',
+            SDL_AUDIODRIVER='dummy',
+        )
+
+        for replay in args.replays:
+            print('Playing {}'.format(replay))
+
+            # render every frame, since drawing code requests resources too
+            subprocess.check_call([str(args.executable), '--null-gl', '--frameskip=1', '--replay', str(replay)], env=env)
+
+        # recording merges with the shipped manifests, so these are complete
+        for src in sorted((Path(storage) / 'resources' / 'preload').glob('*.preload')):
+            dst = resources / 'preload' / src.name
+            update_text_file(dst, src.read_text())
+            print('{}: {} entries'.format(dst, sum(1 for l in src.read_text().splitlines() if l and not l.startswith('#'))))
+
+
+if __name__ == '__main__':
+    run_main(main)
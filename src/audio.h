@@ -68,8 +68,10 @@ void update_sounds(void); // checks if loops need to be stopped
 
 int get_default_sfx_volume(const char *sfx);
 
-Sound* get_sound(const char *name);
-Music* get_music(const char *music);
+Sound* _get_sound(const char *name, const char *caller);
+Music* _get_music(const char *name, const char *caller);
+#define get_sound(name) _get_sound(name, __func__)
+#define get_music(name) _get_music(name, __func__)
 
 void start_bgm(const char *name);
 void stop_bgm(bool force);
@@ -14,6 +14,7 @@
 #include "audio.h"
 #include "resource/resource.h"
 #include "global.h"
+#include "metrics.h"
 
 CurrentBGM current_bgm = { .name = NULL };
 
@@ -40,6 +41,10 @@ static void play_sound_internal(const char *name, bool is_ui, int cooldown, bool
 		return;
 	}
 
+	if(!is_ui) {
+		metrics_count(METRIC_SOUND_PLAYS);
+	}
+
 	if(!audio_backend_initialized() || global.frameskip) {
 		return;
 	}
@@ -150,13 +155,13 @@ void stop_sounds(void) {
 	audio_backend_sound_stop_all(SNDGROUP_MAIN);
 }
 
-Sound* get_sound(const char *name) {
-	Resource *res = get_resource(RES_SFX, name, RESF_OPTIONAL);
+Sound* _get_sound(const char *name, const char *caller) {
+	Resource *res = _get_resource(RES_SFX, name, RESF_OPTIONAL, caller);
 	return res ? res->sound : NULL;
 }
 
-Music* get_music(const char *name) {
-	Resource *res = get_resource(RES_BGM, name, RESF_OPTIONAL);
+Music* _get_music(const char *name, const char *caller) {
+	Resource *res = _get_resource(RES_BGM, name, RESF_OPTIONAL, caller);
 	return res ? res->music : NULL;
 }
 
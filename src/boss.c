@@ -206,6 +206,7 @@ static Projectile* spawn_boss_glow(Boss *boss, Color clr, int timeout) {
 		.args = { timeout, 0, aniplayer_get_frame(&boss->ani), add_ref(global.boss->ani.ani)}, // the ref is needed just to pass a pointer :/
 		.angle = M_PI * 2 * frand(),
 		.size = (1+I)*9000, // ensure it's drawn under everything else
+		.flags = PFLAG_PARALLEL,
 	);
 }
 
@@ -582,7 +583,11 @@ void process_boss(Boss **pboss) {
 		boss->global_rule(boss, global.frames - boss->birthtime);
 	}
 
-	spawn_particle_effects(boss);
+	if(!stage_skip_visual_logic()) {
+		stage_visual_logic_begin();
+		spawn_particle_effects(boss);
+		stage_visual_logic_end();
+	}
 
 	if(!boss->current || global.dialog) {
 		return;
@@ -44,6 +44,7 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 	struct TsOption taisei_opts[] =
 		{{{"replay", required_argument, 0, 'r'}, "Play a replay from %s", "FILE"},
 #ifdef DEBUG
+		{{"verify-replay", required_argument, 0, 'v'}, "Check that %s plays back the same with and without headless logic", "FILE"},
 		{{"play", no_argument, 0, 'p'}, "Play a specific stage", 0},
 		{{"sid", required_argument, 0, 'i'}, "Select stage by %s", "ID"},
 		{{"diff", required_argument, 0, 'd'}, "Select a difficulty (Easy/Normal/Hard/Lunatic)", "DIFF"},
@@ -53,6 +54,7 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 #endif
 		{{"frameskip", optional_argument, 0, 'f'}, "Disable FPS limiter, render only every %s frame", "FRAME"},
 		{{"credits", no_argument, 0, 'c'}, "Show the credits scene and exit"},
+		{{"null-gl", no_argument, 0, 'n'}, "Don't create a window, and run the renderer without a GPU"},
 		{{"help", no_argument, 0, 'h'}, "Display this help"},
 		{{0,0,0,0},0,0}
 	};
@@ -105,6 +107,10 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 			a->type = CLI_PlayReplay;
 			a->filename = strdup(optarg);
 			break;
+		case 'v':
+			a->type = CLI_VerifyReplay;
+			a->filename = strdup(optarg);
+			break;
 		case 'p':
 			a->type = CLI_SelectStage;
 			break;
@@ -156,13 +162,16 @@ int cli_args(int argc, char **argv, CLIAction *a) {
 		case 'c':
 			a->type = CLI_Credits;
 			break;
+		case 'n':
+			a->null_gl = true;
+			break;
 		default:
 			log_fatal("Unknown option (this shouldn’t happen)");
 		}
 	}
 
 	if(stageid) {
-		if(a->type != CLI_PlayReplay && a->type != CLI_SelectStage) {
+		if(a->type != CLI_PlayReplay && a->type != CLI_VerifyReplay && a->type != CLI_SelectStage) {
 			log_warn("--sid was ignored");
 		} else if(!stage_get(stageid)) {
 			log_fatal("Invalid stage id: %X", stageid);
@@ -0,0 +1,258 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "drawbuffer.h"
+#include "taiseigl.h"
+#include "log.h"
+
+// #define DRAWBUFFER_TEST
+
+void drawbuffer_reset(DrawBuffer *buf) {
+	buf->num_commands = 0;
+	buf->run = 0;
+	buf->run_commutative = false;
+}
+
+void drawbuffer_free(DrawBuffer *buf) {
+	free(buf->commands);
+	memset(buf, 0, sizeof(*buf));
+}
+
+void drawbuffer_set_layer(DrawBuffer *buf, uint8_t layer) {
+	buf->layer = layer;
+	// a layer change is a hard ordering boundary
+	buf->run_commutative = false;
+}
+
+static uint32_t drawbuffer_next_run(DrawBuffer *buf, bool commutative, DrawBlendMode blend) {
+	if(!commutative || !buf->run_commutative || buf->run_blend != blend) {
+		++buf->run;
+	}
+
+	buf->run_commutative = commutative;
+	buf->run_blend = blend;
+	return buf->run;
+}
+
+static DrawCommand* drawbuffer_add(DrawBuffer *buf, DrawCommandType type, DrawBlendMode blend, uint32_t shader, uint32_t texture) {
+	if(buf->num_commands == buf->capacity) {
+		buf->capacity = buf->capacity ? buf->capacity * 2 : 1024;
+		buf->commands = realloc(buf->commands, buf->capacity * sizeof(DrawCommand));
+	}
+
+	// blending with the destination in a way where order doesn't matter
+	bool commutative = type == DRAWCMD_SPRITE && blend != DRAW_BLEND_ALPHA;
+	uint32_t run = drawbuffer_next_run(buf, commutative, blend);
+
+	DrawCommand *cmd = buf->commands + buf->num_commands;
+	cmd->seq = buf->num_commands++;
+	cmd->type = type;
+	cmd->blend = blend;
+	cmd->shader = shader;
+	cmd->texture = texture;
+	cmd->key =
+		((uint64_t)buf->layer            << 56) |
+		((uint64_t)(run & 0xFFFFFF)      << 32) |
+		((uint64_t)(blend & 0x3)         << 30) |
+		((uint64_t)(shader & 0x3FFF)     << 16) |
+		((uint64_t)(texture & 0xFFFF));
+
+	return cmd;
+}
+
+DrawCommand* drawbuffer_add_sprite(DrawBuffer *buf, DrawBlendMode blend, uint32_t shader, Sprite *sprite, uint32_t texture) {
+	DrawCommand *cmd = drawbuffer_add(buf, DRAWCMD_SPRITE, blend, shader, texture);
+	cmd->sprite.sprite = sprite;
+	cmd->sprite.x = 0;
+	cmd->sprite.y = 0;
+	cmd->sprite.angle = 0;
+	cmd->sprite.scale = 1;
+	cmd->sprite.color = colortransform_identity;
+	return cmd;
+}
+
+DrawCommand* drawbuffer_add_callback(DrawBuffer *buf, DrawBlendMode blend, uint32_t shader, DrawCallback func, void *arg) {
+	DrawCommand *cmd = drawbuffer_add(buf, DRAWCMD_CALLBACK, blend, shader, 0);
+	cmd->callback.func = func;
+	cmd->callback.arg = arg;
+	return cmd;
+}
+
+static int drawbuffer_compare(const void *a, const void *b) {
+	const DrawCommand *c1 = a, *c2 = b;
+
+	if(c1->key != c2->key) {
+		return c1->key < c2->key ? -1 : 1;
+	}
+
+	// keep it stable
+	return (c1->seq > c2->seq) - (c1->seq < c2->seq);
+}
+
+static void drawbuffer_count(DrawCommand *cmd, DrawCommand *prev, DrawBufferStats *stats) {
+	++stats->commands;
+
+	if(!prev) {
+		stats->runs = stats->blend_changes = stats->shader_changes = stats->texture_changes = 1;
+		return;
+	}
+
+	stats->runs += (cmd->key >> 32) != (prev->key >> 32);
+	stats->blend_changes += cmd->blend != prev->blend;
+	stats->shader_changes += cmd->shader != prev->shader;
+	stats->texture_changes += cmd->type == DRAWCMD_SPRITE && cmd->texture != prev->texture;
+}
+
+void drawbuffer_sort(DrawBuffer *buf, DrawBufferStats *stats) {
+	qsort(buf->commands, buf->num_commands, sizeof(DrawCommand), drawbuffer_compare);
+
+	if(stats) {
+		memset(stats, 0, sizeof(*stats));
+
+		for(size_t i = 0; i < buf->num_commands; ++i) {
+			drawbuffer_count(buf->commands + i, i ? buf->commands + i - 1 : NULL, stats);
+		}
+	}
+}
+
+void drawbuffer_set_blend(DrawBlendMode old_mode, DrawBlendMode new_mode) {
+	if(old_mode == new_mode) {
+		return;
+	}
+
+	if(old_mode == DRAW_BLEND_SUB) {
+		glBlendEquation(GL_FUNC_ADD);
+	}
+
+	switch(new_mode) {
+		case DRAW_BLEND_ALPHA:
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			break;
+
+		case DRAW_BLEND_ADD:
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+			break;
+
+		case DRAW_BLEND_SUB:
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+			glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+			break;
+	}
+}
+
+static void drawbuffer_draw_sprite(DrawCommand *cmd) {
+	glPushMatrix();
+	glTranslatef(cmd->sprite.x, cmd->sprite.y, 0);
+	glRotatef(cmd->sprite.angle, 0, 0, 1);
+
+	if(cmd->sprite.scale != 1) {
+		glScalef(cmd->sprite.scale, cmd->sprite.scale, 1);
+	}
+
+	recolor_apply_transform(&cmd->sprite.color);
+	draw_sprite_p(0, 0, cmd->sprite.sprite);
+	glPopMatrix();
+}
+
+void drawbuffer_submit(DrawBuffer *buf, DrawBufferStats *stats) {
+	DrawBufferStats dummy;
+	drawbuffer_sort(buf, stats ? stats : &dummy);
+
+	// callers are expected to hand us the default alpha blending state, and get it back
+	DrawBlendMode blend = DRAW_BLEND_ALPHA;
+	uint32_t shader = 0;
+
+	for(size_t i = 0; i < buf->num_commands; ++i) {
+		DrawCommand *cmd = buf->commands + i;
+
+		drawbuffer_set_blend(blend, cmd->blend);
+		blend = cmd->blend;
+
+		if(cmd->shader != shader) {
+			glUseProgram(cmd->shader);
+			shader = cmd->shader;
+		}
+
+		switch(cmd->type) {
+			case DRAWCMD_SPRITE:
+				drawbuffer_draw_sprite(cmd);
+				break;
+
+			case DRAWCMD_CALLBACK:
+				cmd->callback.func(cmd->callback.arg);
+				break;
+		}
+	}
+
+	drawbuffer_set_blend(blend, DRAW_BLEND_ALPHA);
+	drawbuffer_reset(buf);
+}
+
+int drawbuffer_test(void) {
+#ifdef DRAWBUFFER_TEST
+	DrawBuffer buf = { 0 };
+	DrawBufferStats stats;
+
+	// a typical particle layer: additive sparks on three textures interleaved in spawn order,
+	// then a few alpha-blended things that must stay in order, then more sparks
+	static const struct { DrawBlendMode blend; uint32_t tex; } input[] = {
+		{ DRAW_BLEND_ADD, 3 }, { DRAW_BLEND_ADD, 1 }, { DRAW_BLEND_ADD, 2 }, { DRAW_BLEND_ADD, 1 },
+		{ DRAW_BLEND_ADD, 3 }, { DRAW_BLEND_ADD, 2 }, { DRAW_BLEND_ADD, 1 }, { DRAW_BLEND_ADD, 3 },
+		{ DRAW_BLEND_ALPHA, 5 }, { DRAW_BLEND_ALPHA, 4 }, { DRAW_BLEND_ALPHA, 5 },
+		{ DRAW_BLEND_SUB, 2 }, { DRAW_BLEND_SUB, 1 }, { DRAW_BLEND_SUB, 2 },
+		{ DRAW_BLEND_ADD, 2 }, { DRAW_BLEND_ADD, 1 },
+	};
+
+	const size_t num = sizeof(input)/sizeof(*input);
+	uint32_t unsorted_texture_changes = 1, unsorted_blend_changes = 1;
+
+	for(size_t i = 0; i < num; ++i) {
+		drawbuffer_add_sprite(&buf, input[i].blend, 1, NULL, input[i].tex);
+
+		if(i) {
+			unsorted_texture_changes += input[i].tex != input[i - 1].tex;
+			unsorted_blend_changes += input[i].blend != input[i - 1].blend;
+		}
+	}
+
+	drawbuffer_sort(&buf, &stats);
+
+	for(size_t i = 0; i < buf.num_commands; ++i) {
+		DrawCommand *cmd = buf.commands + i;
+		log_info("%2zu: seq %2u, blend %i, texture %u, key %016"PRIx64, i, cmd->seq, cmd->blend, cmd->texture, cmd->key);
+	}
+
+	log_info("%u commands in %u runs; texture changes: %u -> %u; blend changes: %u -> %u",
+		stats.commands, stats.runs,
+		unsorted_texture_changes, stats.texture_changes,
+		unsorted_blend_changes, stats.blend_changes
+	);
+
+	// commands never cross run boundaries, and alpha-blended ones keep their relative order
+	for(size_t i = 1; i < buf.num_commands; ++i) {
+		DrawCommand *a = buf.commands + i - 1, *b = buf.commands + i;
+		assert((a->key >> 32) <= (b->key >> 32));
+
+		if((a->key >> 32) == (b->key >> 32)) {
+			assert(a->blend == b->blend && a->blend != DRAW_BLEND_ALPHA);
+			assert(a->texture <= b->texture);
+		}
+	}
+
+	assert(stats.runs == 6);
+	assert(stats.blend_changes == unsorted_blend_changes);
+	assert(stats.texture_changes < unsorted_texture_changes);
+
+	drawbuffer_free(&buf);
+	return 1;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,102 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "recolor.h"
+#include "resource/sprite.h"
+
+/*
+ *  A recorded list of draw commands that is sorted by GL state before it's submitted.
+ *
+ *  Every command gets a sort key made of (layer, run, blend, shader, texture). A "run" is a
+ *  sequence of consecutive commands whose order doesn't affect the result: sprites drawn with
+ *  additive or subtractive blending commute, so all of them share one run and get sorted by
+ *  shader and texture. Anything else (alpha blending, arbitrary callbacks) starts a run of its
+ *  own, which preserves the original order. Sorting never moves a command across a run boundary.
+ *
+ *  Nothing here touches GL until drawbuffer_submit(), so buffers can be built and inspected
+ *  without a GPU (see drawbuffer_test).
+ */
+
+typedef enum DrawBlendMode {
+	DRAW_BLEND_ALPHA,
+	DRAW_BLEND_ADD,
+	DRAW_BLEND_SUB,
+} DrawBlendMode;
+
+typedef enum DrawCommandType {
+	DRAWCMD_SPRITE,
+	DRAWCMD_CALLBACK,
+} DrawCommandType;
+
+typedef void (*DrawCallback)(void *arg);
+
+typedef struct DrawCommand {
+	uint64_t key;
+	uint32_t seq;
+	DrawCommandType type;
+	DrawBlendMode blend;
+	uint32_t shader;
+	uint32_t texture;
+
+	union {
+		struct {
+			Sprite *sprite;
+			float x;
+			float y;
+			float angle; // in degrees
+			float scale;
+			ColorTransform color;
+		} sprite;
+
+		struct {
+			DrawCallback func;
+			void *arg;
+		} callback;
+	};
+} DrawCommand;
+
+typedef struct DrawBufferStats {
+	uint32_t commands;
+	uint32_t runs;
+	uint32_t blend_changes;
+	uint32_t shader_changes;
+	uint32_t texture_changes;
+} DrawBufferStats;
+
+typedef struct DrawBuffer {
+	DrawCommand *commands;
+	size_t num_commands;
+	size_t capacity;
+	uint8_t layer;
+	uint32_t run;
+	bool run_commutative;
+	DrawBlendMode run_blend;
+} DrawBuffer;
+
+void drawbuffer_reset(DrawBuffer *buf);
+void drawbuffer_free(DrawBuffer *buf);
+void drawbuffer_set_layer(DrawBuffer *buf, uint8_t layer);
+
+DrawCommand* drawbuffer_add_sprite(DrawBuffer *buf, DrawBlendMode blend, uint32_t shader, Sprite *sprite, uint32_t texture);
+DrawCommand* drawbuffer_add_callback(DrawBuffer *buf, DrawBlendMode blend, uint32_t shader, DrawCallback func, void *arg);
+
+// sorts the buffer and counts the state changes submitting it would take; doesn't touch GL
+void drawbuffer_sort(DrawBuffer *buf, DrawBufferStats *stats);
+
+// sorts and draws everything, then resets the buffer; stats may be NULL
+void drawbuffer_submit(DrawBuffer *buf, DrawBufferStats *stats);
+
+void drawbuffer_set_blend(DrawBlendMode old_mode, DrawBlendMode new_mode);
+
+int drawbuffer_test(void);
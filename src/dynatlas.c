@@ -0,0 +1,454 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <limits.h>
+
+#include "dynatlas.h"
+#include "global.h"
+
+// #define DYNATLAS_TEST
+
+// blank border around every region, so that linear filtering doesn't pick up the neighbours
+#define PADDING 1
+
+typedef struct SkylineNode {
+	int x;
+	int y;
+	int w;
+} SkylineNode;
+
+typedef struct DynAtlasPage {
+	DynAtlas *atlas;
+	Texture tex;
+
+	// the skyline: left to right, covering the whole width of the page
+	SkylineNode *nodes;
+	int num_nodes;
+
+	DynAtlasRegion *regions;
+	int num_regions;
+	uint64_t used_area;
+	uint32_t last_use;
+} DynAtlasPage;
+
+struct DynAtlas {
+	char *name;
+	int page_size;
+	int max_pages;
+	int num_pages;
+	DynAtlasPage *pages;
+	uint32_t clock;
+	uint32_t evictions;
+};
+
+static inline int imax(int a, int b) {
+	return a > b ? a : b;
+}
+
+static void skyline_init(DynAtlasPage *page, int size) {
+	// there can't be more nodes than pixels in a row
+	page->nodes = realloc(page->nodes, sizeof(SkylineNode) * (size + 1));
+	page->nodes[0] = (SkylineNode) { 0, 0, size };
+	page->num_nodes = 1;
+}
+
+// returns the lowest y at which a w*h rectangle fits with its left edge at node i, or -1
+static int skyline_fit(DynAtlasPage *page, int size, int i, int w, int h) {
+	int x = page->nodes[i].x;
+	int y = 0;
+
+	if(x + w > size) {
+		return -1;
+	}
+
+	for(int left = w; left > 0; left -= page->nodes[i++].w) {
+		y = imax(y, page->nodes[i].y);
+
+		if(y + h > size) {
+			return -1;
+		}
+	}
+
+	return y;
+}
+
+static void skyline_remove_node(DynAtlasPage *page, int i) {
+	memmove(page->nodes + i, page->nodes + i + 1, sizeof(SkylineNode) * (page->num_nodes - i - 1));
+	--page->num_nodes;
+}
+
+// bottom-left rule: the position where the top of the rectangle ends up lowest
+static bool skyline_alloc(DynAtlasPage *page, int size, int w, int h, int *out_x, int *out_y) {
+	int best = -1, best_bottom = INT_MAX, best_width = INT_MAX, best_y = 0;
+
+	for(int i = 0; i < page->num_nodes; ++i) {
+		int y = skyline_fit(page, size, i, w, h);
+
+		if(y < 0) {
+			continue;
+		}
+
+		if(y + h < best_bottom || (y + h == best_bottom && page->nodes[i].w < best_width)) {
+			best = i;
+			best_y = y;
+			best_bottom = y + h;
+			best_width = page->nodes[i].w;
+		}
+	}
+
+	if(best < 0) {
+		return false;
+	}
+
+	SkylineNode node = { page->nodes[best].x, best_y + h, w };
+
+	memmove(page->nodes + best + 1, page->nodes + best, sizeof(SkylineNode) * (page->num_nodes - best));
+	page->nodes[best] = node;
+	++page->num_nodes;
+
+	// cut away whatever the new node now covers
+	for(int i = best + 1; i < page->num_nodes;) {
+		SkylineNode *prev = page->nodes + i - 1;
+		SkylineNode *n = page->nodes + i;
+		int overlap = prev->x + prev->w - n->x;
+
+		if(overlap <= 0) {
+			break;
+		}
+
+		n->x += overlap;
+		n->w -= overlap;
+
+		if(n->w > 0) {
+			break;
+		}
+
+		skyline_remove_node(page, i);
+	}
+
+	for(int i = 0; i < page->num_nodes - 1;) {
+		if(page->nodes[i].y == page->nodes[i + 1].y) {
+			page->nodes[i].w += page->nodes[i + 1].w;
+			skyline_remove_node(page, i + 1);
+		} else {
+			++i;
+		}
+	}
+
+	*out_x = node.x;
+	*out_y = best_y;
+	return true;
+}
+
+static uint64_t skyline_area(DynAtlasPage *page) {
+	uint64_t area = 0;
+
+	for(int i = 0; i < page->num_nodes; ++i) {
+		area += (uint64_t)page->nodes[i].w * page->nodes[i].y;
+	}
+
+	return area;
+}
+
+static void page_init(DynAtlas *atlas, DynAtlasPage *page) {
+	memset(page, 0, sizeof(*page));
+	page->atlas = atlas;
+	page->tex.w = page->tex.h = atlas->page_size;
+	skyline_init(page, atlas->page_size);
+
+	glGenTextures(1, &page->tex.gltex);
+	glBindTexture(GL_TEXTURE_2D, page->tex.gltex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, page->tex.w, page->tex.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	log_debug("%s: new %ix%i page", atlas->name, page->tex.w, page->tex.h);
+}
+
+static void page_free_regions(DynAtlasPage *page, bool evict) {
+	for(DynAtlasRegion *r = page->regions, *next; r; r = next) {
+		next = r->next;
+
+		if(evict && r->evict) {
+			r->evict(r, r->userdata);
+		}
+
+		free(r);
+	}
+
+	page->regions = NULL;
+	page->num_regions = 0;
+	page->used_area = 0;
+	skyline_init(page, page->atlas->page_size);
+}
+
+static void page_evict(DynAtlasPage *page) {
+	log_debug("%s: evicting a page with %i regions", page->atlas->name, page->num_regions);
+	page_free_regions(page, true);
+	++page->atlas->evictions;
+}
+
+DynAtlas* dynatlas_new(const char *name, int page_size, int max_pages) {
+	assert(page_size > 0);
+	assert(max_pages > 0);
+
+	DynAtlas *atlas = calloc(1, sizeof(DynAtlas));
+	atlas->name = strdup(name);
+	atlas->page_size = page_size;
+	atlas->max_pages = max_pages;
+
+	// allocated up front, so that the regions' sprites can point to the textures
+	atlas->pages = calloc(max_pages, sizeof(DynAtlasPage));
+
+	return atlas;
+}
+
+void dynatlas_free(DynAtlas *atlas) {
+	for(int i = 0; i < atlas->num_pages; ++i) {
+		DynAtlasPage *page = atlas->pages + i;
+		page_free_regions(page, false);
+		glDeleteTextures(1, &page->tex.gltex);
+		free(page->nodes);
+	}
+
+	free(atlas->pages);
+	free(atlas->name);
+	free(atlas);
+}
+
+static DynAtlasRegion* page_alloc(DynAtlasPage *page, int w, int h) {
+	int pw = w + 2 * PADDING;
+	int ph = h + 2 * PADDING;
+	int x, y;
+
+	if(!skyline_alloc(page, page->atlas->page_size, pw, ph, &x, &y)) {
+		return NULL;
+	}
+
+	DynAtlasRegion *r = calloc(1, sizeof(DynAtlasRegion));
+	r->page = page;
+	r->x = x;
+	r->y = y;
+	r->w = w;
+	r->h = h;
+	r->sprite.tex = &page->tex;
+	r->sprite.tex_area = (FloatRect) { x + PADDING, y + PADDING, w, h };
+	r->sprite.w = w;
+	r->sprite.h = h;
+
+	r->next = page->regions;
+
+	if(r->next) {
+		r->next->prev = r;
+	}
+
+	page->regions = r;
+	++page->num_regions;
+	page->used_area += (uint64_t)pw * ph;
+
+	return r;
+}
+
+DynAtlasRegion* dynatlas_alloc(DynAtlas *atlas, int w, int h, DynAtlasEvictCallback evict, void *userdata) {
+	assert(w > 0);
+	assert(h > 0);
+
+	if(w + 2 * PADDING > atlas->page_size || h + 2 * PADDING > atlas->page_size) {
+		return NULL;
+	}
+
+	DynAtlasRegion *r = NULL;
+
+	for(int i = 0; i < atlas->num_pages && !r; ++i) {
+		r = page_alloc(atlas->pages + i, w, h);
+	}
+
+	if(!r && atlas->num_pages < atlas->max_pages) {
+		DynAtlasPage *page = atlas->pages + atlas->num_pages++;
+		page_init(atlas, page);
+		r = page_alloc(page, w, h);
+	}
+
+	if(!r) {
+		DynAtlasPage *lru = atlas->pages;
+
+		for(int i = 1; i < atlas->num_pages; ++i) {
+			if(atlas->pages[i].last_use < lru->last_use) {
+				lru = atlas->pages + i;
+			}
+		}
+
+		page_evict(lru);
+		r = page_alloc(lru, w, h);
+	}
+
+	assert(r != NULL);
+	r->evict = evict;
+	r->userdata = userdata;
+	dynatlas_touch(r);
+
+	return r;
+}
+
+void dynatlas_release(DynAtlasRegion *r) {
+	DynAtlasPage *page = r->page;
+
+	if(r->prev) {
+		r->prev->next = r->next;
+	} else {
+		page->regions = r->next;
+	}
+
+	if(r->next) {
+		r->next->prev = r->prev;
+	}
+
+	--page->num_regions;
+	page->used_area -= (uint64_t)(r->w + 2 * PADDING) * (r->h + 2 * PADDING);
+	free(r);
+
+	if(!page->num_regions) {
+		// now it's all free space again
+		skyline_init(page, page->atlas->page_size);
+	}
+}
+
+void dynatlas_upload(DynAtlasRegion *r, SDL_Surface *surf) {
+	assert(surf->w == r->w);
+	assert(surf->h == r->h);
+	assert(surf->format->BytesPerPixel == 4);
+
+	// the padding goes too; this space may have been used by something else before
+	int pw = r->w + 2 * PADDING;
+	int ph = r->h + 2 * PADDING;
+	uint32_t *pixels = calloc(pw * ph, sizeof(uint32_t));
+
+	for(int y = 0; y < r->h; ++y) {
+		memcpy(
+			pixels + (y + PADDING) * pw + PADDING,
+			(uint8_t*)surf->pixels + y * surf->pitch,
+			r->w * sizeof(uint32_t)
+		);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, r->page->tex.gltex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, r->x, r->y, pw, ph, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	free(pixels);
+}
+
+void dynatlas_touch(DynAtlasRegion *r) {
+	r->page->last_use = ++r->page->atlas->clock;
+}
+
+void dynatlas_get_stats(DynAtlas *atlas, DynAtlasStats *stats) {
+	memset(stats, 0, sizeof(*stats));
+	stats->pages = atlas->num_pages;
+	stats->evictions = atlas->evictions;
+
+	for(int i = 0; i < atlas->num_pages; ++i) {
+		DynAtlasPage *page = atlas->pages + i;
+		stats->regions += page->num_regions;
+		stats->page_area += (uint64_t)page->tex.w * page->tex.h;
+		stats->used_area += page->used_area;
+		stats->dead_area += skyline_area(page) - page->used_area;
+	}
+
+	if(stats->page_area) {
+		stats->occupancy = (double)stats->used_area / stats->page_area;
+	}
+
+	if(stats->used_area + stats->dead_area) {
+		stats->fragmentation = (double)stats->dead_area / (stats->used_area + stats->dead_area);
+	}
+}
+
+void dynatlas_log_stats(DynAtlas *atlas) {
+	DynAtlasStats stats;
+	dynatlas_get_stats(atlas, &stats);
+
+	log_info("%s: %i pages, %i regions, %.1f%% occupied, %.1f%% fragmented, %u evictions",
+		atlas->name,
+		stats.pages,
+		stats.regions,
+		100.0 * stats.occupancy,
+		100.0 * stats.fragmentation,
+		stats.evictions
+	);
+}
+
+int dynatlas_test(void) {
+#ifdef DYNATLAS_TEST
+	// exercises the packer alone; there's no GL context yet
+	const int size = 256;
+	DynAtlas atlas = { .name = "test", .page_size = size, .max_pages = 1 };
+	DynAtlasPage page = { .atlas = &atlas };
+	DynAtlasRegion *regions[512];
+	RandomState rnd;
+	int num = 0;
+
+	skyline_init(&page, size);
+	tsrand_init(&rnd, 1);
+
+	// text-like regions: wide and short
+	while(num < 512) {
+		DynAtlasRegion *r = page_alloc(&page, 8 + tsrand_p(&rnd) % 120, 10 + tsrand_p(&rnd) % 12);
+
+		if(!r) {
+			break;
+		}
+
+		// nothing may overlap anything else or stick out of the page
+		for(int i = 0; i < num; ++i) {
+			DynAtlasRegion *o = regions[i];
+			assert(r->x + r->w + 2 * PADDING <= size && r->y + r->h + 2 * PADDING <= size);
+			assert(
+				r->x >= o->x + o->w + 2 * PADDING || o->x >= r->x + r->w + 2 * PADDING ||
+				r->y >= o->y + o->h + 2 * PADDING || o->y >= r->y + r->h + 2 * PADDING
+			);
+		}
+
+		regions[num++] = r;
+	}
+
+	int sum = 0;
+
+	for(int i = 0; i < page.num_nodes; ++i) {
+		assert(page.nodes[i].x == sum);
+		sum += page.nodes[i].w;
+	}
+
+	assert(sum == size);
+
+	atlas.num_pages = 1;
+	atlas.pages = &page;
+	page.tex.w = page.tex.h = size;
+	dynatlas_log_stats(&atlas);
+
+	for(int i = 0; i < num; i += 2) {
+		dynatlas_release(regions[i]);
+	}
+
+	dynatlas_log_stats(&atlas);
+
+	for(int i = 1; i < num; i += 2) {
+		dynatlas_release(regions[i]);
+	}
+
+	assert(page.num_nodes == 1 && page.nodes[0].y == 0);
+	assert(page.used_area == 0);
+
+	free(page.nodes);
+	return 1;
+#else
+	return 0;
+#endif
+}
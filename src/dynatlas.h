@@ -0,0 +1,74 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <SDL.h>
+#include <stdbool.h>
+
+#include "resource/sprite.h"
+
+/*
+ *  Shared textures for images generated at runtime.
+ *
+ *  An atlas consists of up to max_pages square textures ("pages"). Each page is filled by a
+ *  skyline packer. Allocated regions keep their place until they are released or evicted, so
+ *  the sprite of a region can be drawn (and batched with anything else on the same page) for
+ *  as long as the region lives.
+ *
+ *  Space of released regions is only reclaimed once the whole page is empty. When there's no
+ *  room left for a new region, the least recently used page is evicted as a whole: the evict
+ *  callback is invoked for every region on it, after which those regions are invalid.
+ */
+
+typedef struct DynAtlas DynAtlas;
+typedef struct DynAtlasRegion DynAtlasRegion;
+
+typedef void (*DynAtlasEvictCallback)(DynAtlasRegion *region, void *userdata);
+
+struct DynAtlasRegion {
+	Sprite sprite; // w and h are in pixels; scale them as needed
+
+	// private
+	struct DynAtlasPage *page;
+	DynAtlasRegion *next;
+	DynAtlasRegion *prev;
+	DynAtlasEvictCallback evict;
+	void *userdata;
+	int x, y, w, h;
+};
+
+typedef struct DynAtlasStats {
+	int pages;
+	int regions;
+	uint64_t page_area;  // total area of all pages
+	uint64_t used_area;  // area covered by live regions
+	uint64_t dead_area;  // area under the skylines that is not covered by live regions
+	float occupancy;     // used_area / page_area
+	float fragmentation; // dead_area / (used_area + dead_area)
+	uint32_t evictions;  // pages evicted over the whole lifetime of the atlas
+} DynAtlasStats;
+
+DynAtlas* dynatlas_new(const char *name, int page_size, int max_pages);
+void dynatlas_free(DynAtlas *atlas);
+
+// returns NULL if the region can't fit into a page even after evicting everything
+DynAtlasRegion* dynatlas_alloc(DynAtlas *atlas, int w, int h, DynAtlasEvictCallback evict, void *userdata);
+void dynatlas_release(DynAtlasRegion *region);
+
+// surface must be 32-bit and exactly the size of the region
+void dynatlas_upload(DynAtlasRegion *region, SDL_Surface *surf);
+
+// marks the region as used, so that its page is less likely to be evicted
+void dynatlas_touch(DynAtlasRegion *region);
+
+void dynatlas_get_stats(DynAtlas *atlas, DynAtlasStats *stats);
+void dynatlas_log_stats(DynAtlas *atlas);
+
+int dynatlas_test(void);
@@ -16,6 +16,7 @@
 #include "list.h"
 #include "aniplayer.h"
 #include "stageobjects.h"
+#include "stage.h"
 
 #ifdef create_enemy_p
 #undef create_enemy_p
@@ -273,8 +274,10 @@ void process_enemies(Enemy **enemies) {
 			enemy = enemy->next;
 			delete_enemy(enemies, del);
 		} else {
-			if(enemy->visual_rule) {
+			if(enemy->visual_rule && !stage_skip_visual_logic()) {
+				stage_visual_logic_begin();
 				enemy->visual_rule(enemy, global.frames - enemy->birthtime, false);
+				stage_visual_logic_end();
 			}
 
 			enemy = enemy->next;
@@ -0,0 +1,355 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "flightrec.h"
+#include "global.h"
+#include "stageobjects.h"
+#include "version.h"
+
+#define FLIGHTREC_NAME_SIZE 40
+#define FLIGHTREC_MAX_NESTING 8
+#define FLIGHTREC_NUM_POOLS (sizeof(StageObjectPools)/sizeof(ObjectPool*))
+
+// in the order of StageObjectPools
+static const char *pool_names[] = {
+	"projectiles",
+	"items",
+	"enemies",
+	"lasers",
+};
+
+static const char *event_type_names[] = {
+	[FLIGHTREC_ZONE]          = "zone",
+	[FLIGHTREC_RESOURCE_LOAD] = "load",
+	[FLIGHTREC_LAZY_LOAD]     = "lazy load",
+	[FLIGHTREC_RESOURCE_FREE] = "free",
+	[FLIGHTREC_INPUT]         = "input",
+};
+
+typedef struct FlightRecFrame {
+	uint64_t begin;
+	uint64_t end;
+	uint32_t seq;
+	uint32_t game_frame; // global.frames, which is also the replay frame number in a stage
+	uint16_t stage;
+	uint32_t objects[FLIGHTREC_NUM_POOLS];
+} FlightRecFrame;
+
+typedef struct FlightRecEvent {
+	uint64_t begin;
+	uint64_t end;
+	uint32_t frame_seq;
+	int32_t value;
+	uint8_t type;
+	uint8_t depth;
+	char name[FLIGHTREC_NAME_SIZE];
+} FlightRecEvent;
+
+static struct {
+	bool enabled;
+	bool dumping;
+	char *dir;          // system path of storage/flightrec
+	SDL_threadID main_thread;
+	uint64_t freq;
+	uint64_t budget;    // in performance counter ticks
+	uint32_t max_dumps;
+	uint32_t num_dumps;
+	uint32_t last_dump_seq;
+
+	// indexed by seq; an entry is valid only if its seq matches, since frames of nested loops end
+	// before the frame they interrupted
+	FlightRecFrame frames[FLIGHTREC_FRAMES];
+	uint32_t frame_seq;   // number of frames begun so far
+
+	struct {
+		uint64_t begin;
+		uint32_t seq;
+		bool interrupted;
+	} open_frames[FLIGHTREC_MAX_NESTING];
+	int frame_depth;
+
+	FlightRecEvent events[FLIGHTREC_EVENTS];
+	uint32_t event_head;  // where the next event goes
+	uint32_t num_events;
+} flightrec;
+
+bool flightrec_enabled(void) {
+	return flightrec.enabled;
+}
+
+void flightrec_init(void) {
+	memset(&flightrec, 0, sizeof(flightrec));
+
+	if(!getenvint("TAISEI_FLIGHTREC", 1)) {
+		return;
+	}
+
+	// dumps are written with stdio, so that the fatal error path doesn't have to go through the VFS
+	if(!vfs_mkdir("storage/flightrec") || !(flightrec.dir = vfs_syspath("storage/flightrec"))) {
+		log_warn("Flight recorder disabled: VFS error: %s", vfs_get_error());
+		return;
+	}
+
+	static_assert(sizeof(pool_names)/sizeof(*pool_names) == FLIGHTREC_NUM_POOLS, "pool_names is out of date");
+
+	flightrec.freq = SDL_GetPerformanceFrequency();
+	flightrec.budget = flightrec.freq * max(1, getenvint("TAISEI_FLIGHTREC_BUDGET", 50)) / 1000;
+	flightrec.max_dumps = max(0, getenvint("TAISEI_FLIGHTREC_MAX_DUMPS", 10));
+	flightrec.main_thread = SDL_ThreadID();
+	flightrec.enabled = true;
+}
+
+void flightrec_shutdown(void) {
+	flightrec.enabled = false;
+	free(flightrec.dir);
+	flightrec.dir = NULL;
+}
+
+static void copy_name(char *dst, const char *src) {
+	// names end up in JSON strings; rather than escaping anything, just mangle what would need it
+	int i;
+
+	for(i = 0; i < FLIGHTREC_NAME_SIZE - 1 && src[i]; ++i) {
+		char c = src[i];
+		dst[i] = (c == '"' || c == '\\' || (unsigned char)c < 0x20) ? '?' : c;
+	}
+
+	dst[i] = 0;
+}
+
+void flightrec_span(FlightRecEventType type, const char *name, uint64_t begin, uint64_t end, int depth, int32_t value) {
+	if(!flightrec.enabled || flightrec.dumping || SDL_ThreadID() != flightrec.main_thread) {
+		return;
+	}
+
+	FlightRecEvent *e = flightrec.events + flightrec.event_head;
+	flightrec.event_head = (flightrec.event_head + 1) % FLIGHTREC_EVENTS;
+
+	if(flightrec.num_events < FLIGHTREC_EVENTS) {
+		++flightrec.num_events;
+	}
+
+	e->begin = begin;
+	e->end = end;
+	e->frame_seq = flightrec.frame_seq;
+	e->value = value;
+	e->type = type;
+	e->depth = depth;
+	copy_name(e->name, name);
+}
+
+void flightrec_instant(FlightRecEventType type, const char *name, int32_t value) {
+	if(!flightrec.enabled) {
+		return;
+	}
+
+	uint64_t now = SDL_GetPerformanceCounter();
+	flightrec_span(type, name, now, now, 0, value);
+}
+
+void flightrec_frame_begin(void) {
+	if(!flightrec.enabled) {
+		return;
+	}
+
+	if(flightrec.frame_depth == FLIGHTREC_MAX_NESTING) {
+		log_fatal("Main loops are nested too deep");
+	}
+
+	if(flightrec.frame_depth > 0) {
+		flightrec.open_frames[flightrec.frame_depth - 1].interrupted = true;
+	}
+
+	++flightrec.frame_seq;
+	flightrec.open_frames[flightrec.frame_depth].begin = SDL_GetPerformanceCounter();
+	flightrec.open_frames[flightrec.frame_depth].seq = flightrec.frame_seq;
+	flightrec.open_frames[flightrec.frame_depth].interrupted = false;
+	++flightrec.frame_depth;
+}
+
+void flightrec_frame_end(void) {
+	if(!flightrec.enabled) {
+		return;
+	}
+
+	assert(flightrec.frame_depth > 0);
+
+	uint64_t now = SDL_GetPerformanceCounter();
+	--flightrec.frame_depth;
+	uint64_t begin = flightrec.open_frames[flightrec.frame_depth].begin;
+	uint32_t seq = flightrec.open_frames[flightrec.frame_depth].seq;
+
+	if(flightrec.open_frames[flightrec.frame_depth].interrupted) {
+		// the time went into a menu or a stage, and that has been recorded already
+		return;
+	}
+
+	FlightRecFrame *f = flightrec.frames + seq % FLIGHTREC_FRAMES;
+	f->begin = begin;
+	f->end = now;
+	f->seq = seq;
+	f->game_frame = global.frames;
+	f->stage = global.stage ? global.stage->id : 0;
+
+	for(int i = 0; i < FLIGHTREC_NUM_POOLS; ++i) {
+		ObjectPool *pool = (&stage_object_pools.first)[i];
+		ObjectPoolStats stats = { 0 };
+
+		if(pool) {
+			objpool_get_stats(pool, &stats);
+		}
+
+		f->objects[i] = stats.usage;
+	}
+
+	if(
+		now - begin > flightrec.budget &&
+		flightrec.num_dumps < flightrec.max_dumps &&
+		(!flightrec.num_dumps || flightrec.frame_seq - flightrec.last_dump_seq >= FLIGHTREC_FRAMES / 2)
+	) {
+		log_warn("Frame took %.1f ms, dumping the flight recorder", (now - begin) * 1000.0 / flightrec.freq);
+		flightrec_dump("hitch");
+	}
+}
+
+static double flightrec_usec(uint64_t t, uint64_t epoch) {
+	return (int64_t)(t - epoch) * 1e6 / flightrec.freq;
+}
+
+static const char* replay_mode_name(void) {
+	switch(global.replaymode) {
+		case REPLAY_RECORD: return "record";
+		case REPLAY_PLAY:   return "play";
+		default:            return "none";
+	}
+}
+
+void flightrec_dump(const char *reason) {
+	if(!flightrec.enabled || flightrec.dumping) {
+		return;
+	}
+
+	if(SDL_ThreadID() != flightrec.main_thread) {
+		// the main thread is still writing to the buffers
+		log_warn("Not dumping the flight recorder from a worker thread");
+		return;
+	}
+
+	flightrec.dumping = true;
+	++flightrec.num_dumps;
+	flightrec.last_dump_seq = flightrec.frame_seq;
+
+	char timestamp[32];
+	time_t rawtime;
+	time(&rawtime);
+	strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H-%M-%S", localtime(&rawtime));
+
+	char *path = strfmt("%s/%s_%s_%u.json", flightrec.dir, reason, timestamp, flightrec.num_dumps);
+	FILE *out = fopen(path, "w");
+
+	if(!out) {
+		log_warn("Couldn't write %s: %s", path, strerror(errno));
+		free(path);
+		flightrec.dumping = false;
+		return;
+	}
+
+	uint32_t oldest_seq = flightrec.frame_seq >= FLIGHTREC_FRAMES ? flightrec.frame_seq - FLIGHTREC_FRAMES + 1 : 0;
+	uint32_t num_frames = 0;
+	uint64_t epoch = SDL_GetPerformanceCounter();
+
+	for(uint32_t seq = oldest_seq; seq != flightrec.frame_seq + 1; ++seq) {
+		FlightRecFrame *f = flightrec.frames + seq % FLIGHTREC_FRAMES;
+
+		if(f->seq == seq && f->end) {
+			epoch = f->begin < epoch ? f->begin : epoch;
+			++num_frames;
+		}
+	}
+
+	fprintf(out,
+		"{\"displayTimeUnit\":\"ms\",\"otherData\":{"
+		"\"reason\":\"%s\",\"version\":\"%s\",\"stage\":\"%X\",\"frame\":%u,\"replay\":\"%s\",\"budget_ms\":%.1f"
+		"},\"traceEvents\":[\n",
+		reason,
+		TAISEI_VERSION_FULL,
+		global.stage ? global.stage->id : 0,
+		global.frames,
+		replay_mode_name(),
+		flightrec.budget * 1000.0 / flightrec.freq
+	);
+
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"frames\"}}\n");
+	fprintf(out, ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"zones\"}}\n");
+	fprintf(out, ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"events\"}}\n");
+
+	for(uint32_t seq = oldest_seq; seq != flightrec.frame_seq + 1; ++seq) {
+		FlightRecFrame *f = flightrec.frames + seq % FLIGHTREC_FRAMES;
+
+		if(f->seq != seq || !f->end) {
+			continue;
+		}
+
+		double ts = flightrec_usec(f->begin, epoch);
+
+		fprintf(out,
+			",{\"name\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,"
+			"\"args\":{\"seq\":%u,\"frame\":%u,\"stage\":\"%X\"}}\n",
+			ts, flightrec_usec(f->end, epoch) - ts, f->seq, f->game_frame, f->stage
+		);
+
+		fprintf(out, ",{\"name\":\"objects\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{", ts);
+
+		for(int i = 0; i < FLIGHTREC_NUM_POOLS; ++i) {
+			fprintf(out, "%s\"%s\":%u", i ? "," : "", pool_names[i], f->objects[i]);
+		}
+
+		fprintf(out, "}}\n");
+	}
+
+	uint32_t first_event = (flightrec.event_head + FLIGHTREC_EVENTS - flightrec.num_events) % FLIGHTREC_EVENTS;
+
+	for(uint32_t i = 0; i < flightrec.num_events; ++i) {
+		FlightRecEvent *e = flightrec.events + (first_event + i) % FLIGHTREC_EVENTS;
+
+		if(e->frame_seq < oldest_seq) {
+			continue;
+		}
+
+		double ts = flightrec_usec(e->begin, epoch);
+
+		if(e->end == e->begin) {
+			fprintf(out,
+				",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":3,"
+				"\"args\":{\"value\":%i}}\n",
+				e->name, event_type_names[e->type], ts, e->value
+			);
+		} else {
+			fprintf(out,
+				",{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%i,"
+				"\"args\":{\"value\":%i}}\n",
+				e->name, event_type_names[e->type], ts, flightrec_usec(e->end, epoch) - ts,
+				e->type == FLIGHTREC_ZONE ? 2 : 3, e->value
+			);
+		}
+	}
+
+	fprintf(out, "]}\n");
+	fclose(out);
+
+	log_info("Saved the last %u frames to %s", num_frames, path);
+	free(path);
+
+	flightrec.dumping = false;
+}
@@ -0,0 +1,56 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Flight recorder for hitches.
+ *
+ *  Keeps the last FLIGHTREC_FRAMES frames in memory: their timing, stage object counts, resource
+ *  loads and frees, and player input. Builds with -Dprofiler=true also record profiler zones.
+ *  Nothing is written out unless a frame takes longer than TAISEI_FLIGHTREC_BUDGET milliseconds,
+ *  or the game is about to crash with a fatal error. Then the whole buffer is dumped into
+ *  storage/flightrec/ in the Chrome trace event format, along with the stage and replay frame
+ *  number.
+ *
+ *  Timestamps are raw SDL performance counter values. Events are only recorded, and the buffer is
+ *  only dumped, on the main thread. Dumps are written with stdio rather than through the VFS.
+ *
+ *  Enabled by default; TAISEI_FLIGHTREC=0 turns it off.
+ */
+
+#define FLIGHTREC_FRAMES 300
+#define FLIGHTREC_EVENTS 8192
+
+typedef enum FlightRecEventType {
+	FLIGHTREC_ZONE,           // a profiler zone; depth is its nesting level
+	FLIGHTREC_RESOURCE_LOAD,  // finished loading a resource on the main thread
+	FLIGHTREC_LAZY_LOAD,      // a resource that wasn't preloaded was loaded on demand
+	FLIGHTREC_RESOURCE_FREE,  // value is the number of resources freed
+	FLIGHTREC_INPUT,          // value is the key or axis value
+	FLIGHTREC_NUM_EVENT_TYPES,
+} FlightRecEventType;
+
+void flightrec_init(void);
+void flightrec_shutdown(void);
+bool flightrec_enabled(void);
+
+// brackets one iteration of the main loop; frames of nested loops (menus) are recorded as usual,
+// but the frame they interrupt is never considered a hitch
+void flightrec_frame_begin(void);
+void flightrec_frame_end(void);
+
+void flightrec_span(FlightRecEventType type, const char *name, uint64_t begin, uint64_t end, int depth, int32_t value);
+void flightrec_instant(FlightRecEventType type, const char *name, int32_t value);
+
+// writes out the buffer now; reason becomes a part of the file name, and should be a short identifier
+void flightrec_dump(const char *reason);
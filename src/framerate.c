@@ -11,6 +11,7 @@
 #include "framerate.h"
 #include "global.h"
 #include "video.h"
+#include "flightrec.h"
 
 void fpscounter_reset(FPSCounter *fps) {
 	hrtime_t frametime = 1.0 / FPS;
@@ -41,6 +42,85 @@ void fpscounter_update(FPSCounter *fps) {
 	fps->last_update_time = time_get();
 }
 
+/*
+ *  The frame limiter sleeps until shortly before the deadline, then spins for the rest.
+ *  How much shorter is calibrated at runtime from how badly SDL_Delay actually overshoots,
+ *  which varies wildly between systems (think 1ms vs. 15ms timer resolution).
+ *
+ *  The margin never takes more than half of the frame, and decays on frames that had no time
+ *  left to sleep, so that a bad estimate can't lock the limiter into spinning for good.
+ */
+
+static struct {
+	hrtime_t overshoot_avg;
+	hrtime_t overshoot_dev;
+	uint32_t frames;
+} limiter = {
+	.overshoot_avg = 0.001,
+	.overshoot_dev = 0.0005,
+};
+
+#define LIMITER_WEIGHT (1.0 / 16)
+
+static void limiter_calibrate(hrtime_t overshoot) {
+	const hrtime_t weight = LIMITER_WEIGHT;
+
+	// a system stall isn't the timer's fault; let samples this far off move the estimate only a little
+	hrtime_t limit = limiter.overshoot_avg + 4 * max(limiter.overshoot_dev, 0.0005);
+	overshoot = min(overshoot, limit);
+
+	hrtime_t dev = overshoot - limiter.overshoot_avg;
+
+	limiter.overshoot_avg += dev * weight;
+	limiter.overshoot_dev += (fabsl(dev) - limiter.overshoot_dev) * weight;
+}
+
+static void limiter_decay(void) {
+	limiter.overshoot_avg *= 1 - LIMITER_WEIGHT;
+	limiter.overshoot_dev *= 1 - LIMITER_WEIGHT;
+}
+
+static hrtime_t limiter_margin(hrtime_t target_frame_time) {
+	hrtime_t margin = limiter.overshoot_avg + 2 * limiter.overshoot_dev;
+	return clamp(margin, 0.0001, target_frame_time / 2);
+}
+
+static void limiter_wait(hrtime_t deadline, hrtime_t target_frame_time, bool adaptive) {
+	FrameLimiterStats *stats = &global.fps.limiter;
+	hrtime_t start = time_get();
+	hrtime_t now = start;
+
+	stats->sleep_time = 0;
+	stats->sleep_margin = limiter_margin(target_frame_time);
+
+	if(adaptive) {
+		int32_t ms = (int32_t)(1000 * (deadline - now - stats->sleep_margin));
+
+		if(ms > 0) {
+			SDL_Delay(ms);
+			now = time_get();
+			stats->sleep_time = now - start;
+			limiter_calibrate(stats->sleep_time - ms / (hrtime_t)1000);
+		} else {
+			limiter_decay();
+		}
+	}
+
+	while(now < deadline) {
+		now = time_get();
+	}
+
+	stats->spin_time = now - start - stats->sleep_time;
+	stats->lateness = now - deadline;
+	stats->lateness_avg += (stats->lateness - stats->lateness_avg) / 16;
+
+	if(!(limiter.frames++ % FPS)) {
+		stats->lateness_peak = 0;
+	}
+
+	stats->lateness_peak = max(stats->lateness_peak, stats->lateness);
+}
+
 uint32_t get_effective_frameskip(void) {
 	uint32_t frameskip;
 
@@ -66,12 +146,14 @@ void loop_at_fps(LogicFrameFunc logic_frame, RenderFrameFunc render_frame, void
 	FrameAction lframe_action = LFRAME_WAIT;
 
 	int32_t delay = getenvint("TAISEI_FRAMELIMITER_SLEEP", 0);
+	bool adaptive_delay = delay <= 0 && getenvint("TAISEI_FRAMELIMITER_ADAPTIVE", 1);
 	bool exact_delay = getenvint("TAISEI_FRAMELIMITER_SLEEP_EXACT", 1);
 	bool compensate = getenvint("TAISEI_FRAMELIMITER_COMPENSATE", 1);
 	bool uncapped_rendering_env = getenvint("TAISEI_FRAMELIMITER_LOGIC_ONLY", 0);
 	bool late_swap = config_get_int(CONFIG_VID_LATE_SWAP);
 
 	uint32_t frame_num = 0;
+	hrtime_t last_render_time = frame_start_time;
 
 	// don't care about thread safety, we can render only on the main thread anyway
 	static uint8_t recursion_detector;
@@ -82,6 +164,7 @@ void loop_at_fps(LogicFrameFunc logic_frame, RenderFrameFunc render_frame, void
 		frame_start_time = time_get();
 
 begin_frame:
+		flightrec_frame_begin();
 
 #ifdef DEBUG
 		if(gamekeypressed(KEY_FPSLIMIT_OFF)) {
@@ -105,7 +188,9 @@ begin_frame:
 			while(lframe_action != LFRAME_STOP && next_frame_time < frame_start_time) {
 				uint8_t rval = recursion_detector;
 
+				hrtime_t logic_start = time_get();
 				lframe_action = logic_frame(arg);
+				global.fps.logic_time = time_get() - logic_start;
 				fpscounter_update(&global.fps.logic);
 				++logic_frames;
 
@@ -144,18 +229,27 @@ begin_frame:
 				);
 			}
 		} else {
+			hrtime_t logic_start = time_get();
 			lframe_action = logic_frame(arg);
+			global.fps.logic_time = time_get() - logic_start;
 			fpscounter_update(&global.fps.logic);
 		}
 
 		if(!uncapped_rendering && frame_num % get_effective_frameskip()) {
 			rframe_action = RFRAME_DROP;
+		} else if(!uncapped_rendering && lframe_action == LFRAME_SKIP && time_get() - last_render_time < target_frame_time) {
+			// fast-forwarding: logic runs as fast as it can, but there's no point in presenting more often than usual
+			rframe_action = RFRAME_DROP;
 		} else {
+			hrtime_t render_start = time_get();
 			rframe_action = render_frame(arg);
+			last_render_time = time_get();
+			global.fps.render_time = last_render_time - render_start;
 			fpscounter_update(&global.fps.render);
 		}
 
 		if(lframe_action == LFRAME_STOP) {
+			flightrec_frame_end();
 			break;
 		}
 
@@ -164,6 +258,7 @@ begin_frame:
 		}
 
 		fpscounter_update(&global.fps.busy);
+		flightrec_frame_end();
 
 		if(lframe_action == LFRAME_SKIP || uncapped_rendering) {
 			continue;
@@ -208,8 +303,6 @@ begin_frame:
 			}
 		}
 
-		while(time_get() < next_frame_time) {
-			continue;
-		}
+		limiter_wait(next_frame_time, target_frame_time, adaptive_delay);
 	}
 }
@@ -18,6 +18,15 @@ typedef struct {
     hrtime_t last_update_time; // internal; last time the average was recalculated
 } FPSCounter;
 
+typedef struct {
+    hrtime_t lateness; // how far past its deadline the last frame started
+    hrtime_t lateness_avg; // running average of the above
+    hrtime_t lateness_peak; // worst lateness over the last second
+    hrtime_t sleep_time; // time spent sleeping before the last frame
+    hrtime_t spin_time; // time spent busy-waiting before the last frame
+    hrtime_t sleep_margin; // how early the limiter wakes up to make up for sleep inaccuracy
+} FrameLimiterStats;
+
 typedef enum FrameAction {
     RFRAME_SWAP,
     RFRAME_DROP,
@@ -0,0 +1,214 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "glmatrix.h"
+#include "global.h"
+
+#define TAISEIGL_NO_EXT_ABSTRACTION
+#include "taiseigl.h"
+#undef TAISEIGL_NO_EXT_ABSTRACTION
+
+static struct {
+	bool enabled;
+	bool dirty;
+	GLenum mode;
+	MatrixStack modelview;
+} glmatrix;
+
+bool glmatrix_enabled(void) {
+	return glmatrix.enabled;
+}
+
+float (*glmatrix_get_modelview(void))[4] {
+	if(!glmatrix.enabled) {
+		return NULL;
+	}
+
+	return matstack_current(&glmatrix.modelview);
+}
+
+#ifndef LINK_TO_LIBGL
+
+// names are given without the gl prefix, so that they don't get macro-expanded
+#define REAL(name) static tsgl##name##_ptr real_##name;
+
+REAL(MatrixMode)
+REAL(PushMatrix)
+REAL(PopMatrix)
+REAL(LoadIdentity)
+REAL(Translatef)
+REAL(Rotatef)
+REAL(Scalef)
+REAL(LoadMatrixf)
+REAL(DrawArrays)
+REAL(DrawElements)
+REAL(DrawArraysInstanced)
+
+#undef REAL
+
+static inline bool glmatrix_intercept(void) {
+	return glmatrix.mode == GL_MODELVIEW;
+}
+
+static void glmatrix_flush(void) {
+	if(!glmatrix.dirty) {
+		return;
+	}
+
+	if(glmatrix.mode != GL_MODELVIEW) {
+		real_MatrixMode(GL_MODELVIEW);
+	}
+
+	real_LoadMatrixf(&matstack_current(&glmatrix.modelview)[0][0]);
+
+	if(glmatrix.mode != GL_MODELVIEW) {
+		real_MatrixMode(glmatrix.mode);
+	}
+
+	glmatrix.dirty = false;
+}
+
+static void GLAPIENTRY cpu_MatrixMode(GLenum mode) {
+	glmatrix.mode = mode;
+	real_MatrixMode(mode);
+}
+
+static void GLAPIENTRY cpu_PushMatrix(void) {
+	if(!glmatrix_intercept()) {
+		real_PushMatrix();
+		return;
+	}
+
+	// doesn't change the current matrix, so nothing to upload
+	matstack_push(&glmatrix.modelview);
+}
+
+static void GLAPIENTRY cpu_PopMatrix(void) {
+	if(!glmatrix_intercept()) {
+		real_PopMatrix();
+		return;
+	}
+
+	matstack_pop(&glmatrix.modelview);
+	glmatrix.dirty = true;
+}
+
+static void GLAPIENTRY cpu_LoadIdentity(void) {
+	if(!glmatrix_intercept()) {
+		real_LoadIdentity();
+		return;
+	}
+
+	matstack_identity(&glmatrix.modelview);
+	glmatrix.dirty = true;
+}
+
+static void GLAPIENTRY cpu_Translatef(GLfloat x, GLfloat y, GLfloat z) {
+	if(!glmatrix_intercept()) {
+		real_Translatef(x, y, z);
+		return;
+	}
+
+	matstack_translate(&glmatrix.modelview, x, y, z);
+	glmatrix.dirty = true;
+}
+
+static void GLAPIENTRY cpu_Rotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+	if(!glmatrix_intercept()) {
+		real_Rotatef(angle, x, y, z);
+		return;
+	}
+
+	matstack_rotate(&glmatrix.modelview, angle * M_PI / 180, x, y, z);
+	glmatrix.dirty = true;
+}
+
+static void GLAPIENTRY cpu_Scalef(GLfloat x, GLfloat y, GLfloat z) {
+	if(!glmatrix_intercept()) {
+		real_Scalef(x, y, z);
+		return;
+	}
+
+	matstack_scale(&glmatrix.modelview, x, y, z);
+	glmatrix.dirty = true;
+}
+
+static void GLAPIENTRY cpu_LoadMatrixf(const GLfloat *m) {
+	if(!glmatrix_intercept()) {
+		real_LoadMatrixf(m);
+		return;
+	}
+
+	memcpy(matstack_current(&glmatrix.modelview), m, sizeof(Matrix));
+	glmatrix.dirty = true;
+}
+
+static void GLAPIENTRY cpu_DrawArrays(GLenum mode, GLint first, GLsizei count) {
+	glmatrix_flush();
+	real_DrawArrays(mode, first, count);
+}
+
+static void GLAPIENTRY cpu_DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices) {
+	glmatrix_flush();
+	real_DrawElements(mode, count, type, indices);
+}
+
+static void APIENTRY cpu_DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount) {
+	glmatrix_flush();
+	real_DrawArraysInstanced(mode, first, count, instancecount);
+}
+
+#define INSTALL(name) do { \
+	real_##name = tsgl##name; \
+	tsgl##name = cpu_##name; \
+} while(0)
+
+static void glmatrix_install(void) {
+	INSTALL(MatrixMode);
+	INSTALL(PushMatrix);
+	INSTALL(PopMatrix);
+	INSTALL(LoadIdentity);
+	INSTALL(Translatef);
+	INSTALL(Rotatef);
+	INSTALL(Scalef);
+	INSTALL(LoadMatrixf);
+	INSTALL(DrawArrays);
+	INSTALL(DrawElements);
+
+	if(glext.DrawArraysInstanced) {
+		real_DrawArraysInstanced = glext.DrawArraysInstanced;
+		glext.DrawArraysInstanced = cpu_DrawArraysInstanced;
+	}
+}
+
+#undef INSTALL
+
+#endif // !LINK_TO_LIBGL
+
+void glmatrix_init(void) {
+	memset(&glmatrix, 0, sizeof(glmatrix));
+
+	if(!getenvint("TAISEI_CPU_MATRICES", 1)) {
+		return;
+	}
+
+#ifdef LINK_TO_LIBGL
+	log_warn("The CPU matrix stack is not available in builds linked directly to libGL");
+#else
+	glmatrix_install();
+	glmatrix.enabled = true;
+	matstack_reset(&glmatrix.modelview);
+
+	// GL's initial state; make sure that's actually what we're in
+	glmatrix.mode = GL_MODELVIEW;
+	real_MatrixMode(GL_MODELVIEW);
+	glmatrix.dirty = true;
+#endif
+}
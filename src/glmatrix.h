@@ -0,0 +1,32 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdbool.h>
+
+#include "matrix.h"
+
+/*
+ *  Keeps the modelview matrix stack on the CPU.
+ *
+ *  glPushMatrix, glPopMatrix, glLoadIdentity, glTranslatef, glRotatef and glScalef are
+ *  intercepted while GL_MODELVIEW is the current matrix mode, and applied to a MatrixStack
+ *  instead. The resulting matrix is uploaded with a single glLoadMatrixf right before a draw
+ *  call, and only if it changed since the last one. Other matrix modes are left to GL.
+ *
+ *  Enabled by default; TAISEI_CPU_MATRICES=0 turns it off.
+ */
+
+// must be called after the function table is loaded, and after glstate_init
+void glmatrix_init(void);
+bool glmatrix_enabled(void);
+
+// the current modelview matrix, column-major; NULL if the CPU stack is disabled
+float (*glmatrix_get_modelview(void))[4];
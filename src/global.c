@@ -29,6 +29,8 @@ void init_global(CLIAction *cli) {
 		log_warn("FPS limiter disabled. Gotta go fast! (frameskip = %i)", global.frameskip);
 	}
 
+	global.null_gl = cli->null_gl || getenvint("TAISEI_NULL_GL", 0);
+
 	fpscounter_reset(&global.fps.logic);
 	fpscounter_reset(&global.fps.render);
 	fpscounter_reset(&global.fps.busy);
@@ -84,6 +84,12 @@ enum {
 	GAMEOVER_TRANSITIONING = -1,
 };
 
+typedef enum HeadlessLogicMode {
+	HEADLESS_LOGIC_AUTO, // only while fast-forwarding a replay
+	HEADLESS_LOGIC_NEVER,
+	HEADLESS_LOGIC_ALWAYS,
+} HeadlessLogicMode;
+
 typedef struct {
 	int8_t diff; // this holds values of type Difficulty, but should be signed to prevent obscure overflow errors
 	Player plr;
@@ -100,6 +106,7 @@ typedef struct {
 	int stage_start_frame;
 
 	int frameskip;
+	bool null_gl;
 
 	Boss *boss;
 	Dialog *dialog;
@@ -112,6 +119,9 @@ typedef struct {
 		FPSCounter logic;
 		FPSCounter render;
 		FPSCounter busy;
+		hrtime_t logic_time; // time spent in the last logic frame
+		hrtime_t render_time; // time spent in the last rendered frame
+		FrameLimiterStats limiter;
 	} fps;
 
 	Replay replay;
@@ -127,6 +137,13 @@ typedef struct {
 	StageInfo *stage;
 
 	bool is_practice_mode;
+
+	// visual-only logic draws from rand_visual rather than rand_game; see REPLAY_SFLAG_VISUAL_RNG
+	bool separate_visual_rng;
+
+	// nothing from the current logic frame is going to be seen; see stage_skip_visual_logic()
+	bool headless_logic;
+	HeadlessLogicMode headless_mode;
 } Global;
 
 extern Global global;
@@ -0,0 +1,368 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "glstate.h"
+#include "global.h"
+#include "taiseigl.h"
+
+#define GLSTATE_UNITS 8
+
+// tristate for capabilities
+#define CAP_UNKNOWN -1
+
+// value that no real object name can have (0 is valid: it unbinds)
+#define NAME_UNKNOWN ((GLuint)-1)
+#define ENUM_UNKNOWN ((GLenum)-1)
+
+static const char *category_names[] = {
+	[GLSTATE_TEXTURE]        = "textures",
+	[GLSTATE_ACTIVE_TEXTURE] = "active unit",
+	[GLSTATE_PROGRAM]        = "program",
+	[GLSTATE_BLEND_FUNC]     = "blend func",
+	[GLSTATE_BLEND_EQUATION] = "blend equation",
+	[GLSTATE_CAPS]           = "caps",
+	[GLSTATE_FRAMEBUFFER]    = "framebuffer",
+};
+
+static struct {
+	bool enabled;
+
+	GLuint active_unit; // index, not the GL_TEXTUREi enum; GLSTATE_UNITS if unknown or out of range
+	GLuint textures[GLSTATE_UNITS];
+	int8_t texture_2d[GLSTATE_UNITS];
+	GLuint program;
+	GLenum blend_func[4];
+	GLenum blend_eq[2];
+	int8_t blend;
+	int8_t depth_test;
+	int8_t cull_face;
+	GLuint framebuffer;
+
+	GLStateCacheStats stats;
+} glstate;
+
+bool glstate_enabled(void) {
+	return glstate.enabled;
+}
+
+void glstate_get_stats(GLStateCacheStats *stats) {
+	*stats = glstate.stats;
+}
+
+void glstate_reset_stats(void) {
+	memset(&glstate.stats, 0, sizeof(glstate.stats));
+}
+
+void glstate_log_stats(const char *context) {
+	if(!glstate.enabled) {
+		return;
+	}
+
+	uint64_t calls = 0, skipped = 0;
+	char buf[512] = { 0 };
+	size_t ofs = 0;
+
+	for(int i = 0; i < GLSTATE_NUM_CATEGORIES; ++i) {
+		calls += glstate.stats.calls[i];
+		skipped += glstate.stats.skipped[i];
+
+		if(glstate.stats.calls[i] && ofs < sizeof(buf)) {
+			ofs += snprintf(buf + ofs, sizeof(buf) - ofs, "%s%s %.1f%%",
+				ofs ? ", " : "",
+				category_names[i],
+				100.0 * glstate.stats.skipped[i] / glstate.stats.calls[i]
+			);
+		}
+	}
+
+	if(calls) {
+		log_info("%s: skipped %"PRIu64" of %"PRIu64" GL state changes (%.1f%%): %s",
+			context, skipped, calls, 100.0 * skipped / calls, buf
+		);
+	}
+
+	glstate_reset_stats();
+}
+
+#ifndef LINK_TO_LIBGL
+
+// returns true if the call should be dropped
+static inline bool glstate_check(GLStateCategory cat, bool redundant) {
+	++glstate.stats.calls[cat];
+	glstate.stats.skipped[cat] += redundant;
+	return redundant;
+}
+
+static int8_t* glstate_cap(GLenum cap) {
+	switch(cap) {
+		case GL_BLEND:      return &glstate.blend;
+		case GL_DEPTH_TEST: return &glstate.depth_test;
+		case GL_CULL_FACE:  return &glstate.cull_face;
+
+		case GL_TEXTURE_2D:
+			if(glstate.active_unit < GLSTATE_UNITS) {
+				return glstate.texture_2d + glstate.active_unit;
+			}
+
+			return NULL;
+
+		default:
+			return NULL;
+	}
+}
+
+// names are given without the gl prefix, so that they don't get macro-expanded
+#define REAL(name) static tsgl##name##_ptr real_##name;
+
+REAL(ActiveTexture)
+REAL(BindTexture)
+REAL(DeleteTextures)
+REAL(UseProgram)
+REAL(DeleteProgram)
+REAL(BlendFunc)
+REAL(BlendFuncSeparate)
+REAL(BlendEquation)
+REAL(BlendEquationSeparate)
+REAL(Enable)
+REAL(Disable)
+REAL(BindFramebuffer)
+REAL(DeleteFramebuffers)
+
+#undef REAL
+
+static void GLAPIENTRY cached_ActiveTexture(GLenum texture) {
+	GLuint unit = texture - GL_TEXTURE0;
+
+	if(glstate_check(GLSTATE_ACTIVE_TEXTURE, unit < GLSTATE_UNITS && unit == glstate.active_unit)) {
+		return;
+	}
+
+	glstate.active_unit = unit < GLSTATE_UNITS ? unit : GLSTATE_UNITS;
+	real_ActiveTexture(texture);
+}
+
+static void GLAPIENTRY cached_BindTexture(GLenum target, GLuint texture) {
+	if(target != GL_TEXTURE_2D || glstate.active_unit >= GLSTATE_UNITS) {
+		real_BindTexture(target, texture);
+		return;
+	}
+
+	GLuint *bound = glstate.textures + glstate.active_unit;
+
+	if(glstate_check(GLSTATE_TEXTURE, *bound == texture)) {
+		return;
+	}
+
+	*bound = texture;
+	real_BindTexture(target, texture);
+}
+
+static void GLAPIENTRY cached_DeleteTextures(GLsizei n, const GLuint *textures) {
+	// deleting a bound texture reverts the binding to 0
+	for(GLsizei i = 0; i < n; ++i) {
+		for(int u = 0; u < GLSTATE_UNITS; ++u) {
+			if(glstate.textures[u] == textures[i]) {
+				glstate.textures[u] = 0;
+			}
+		}
+	}
+
+	real_DeleteTextures(n, textures);
+}
+
+static void APIENTRY cached_UseProgram(GLuint program) {
+	if(glstate_check(GLSTATE_PROGRAM, program == glstate.program)) {
+		return;
+	}
+
+	glstate.program = program;
+	real_UseProgram(program);
+}
+
+static void APIENTRY cached_DeleteProgram(GLuint program) {
+	// the program stays in use until something else is bound, but its name may be recycled after that
+	if(program == glstate.program) {
+		glstate.program = NAME_UNKNOWN;
+	}
+
+	real_DeleteProgram(program);
+}
+
+static void APIENTRY cached_BlendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha) {
+	GLenum *f = glstate.blend_func;
+
+	if(glstate_check(GLSTATE_BLEND_FUNC, f[0] == srcRGB && f[1] == dstRGB && f[2] == srcAlpha && f[3] == dstAlpha)) {
+		return;
+	}
+
+	f[0] = srcRGB;
+	f[1] = dstRGB;
+	f[2] = srcAlpha;
+	f[3] = dstAlpha;
+	real_BlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+static void GLAPIENTRY cached_BlendFunc(GLenum sfactor, GLenum dfactor) {
+	GLenum *f = glstate.blend_func;
+
+	if(glstate_check(GLSTATE_BLEND_FUNC, f[0] == sfactor && f[1] == dfactor && f[2] == sfactor && f[3] == dfactor)) {
+		return;
+	}
+
+	f[0] = f[2] = sfactor;
+	f[1] = f[3] = dfactor;
+	real_BlendFunc(sfactor, dfactor);
+}
+
+static void APIENTRY cached_BlendEquationSeparate(GLenum modeRGB, GLenum modeAlpha) {
+	GLenum *e = glstate.blend_eq;
+
+	if(glstate_check(GLSTATE_BLEND_EQUATION, e[0] == modeRGB && e[1] == modeAlpha)) {
+		return;
+	}
+
+	e[0] = modeRGB;
+	e[1] = modeAlpha;
+	real_BlendEquationSeparate(modeRGB, modeAlpha);
+}
+
+static void GLAPIENTRY cached_BlendEquation(GLenum mode) {
+	GLenum *e = glstate.blend_eq;
+
+	if(glstate_check(GLSTATE_BLEND_EQUATION, e[0] == mode && e[1] == mode)) {
+		return;
+	}
+
+	e[0] = e[1] = mode;
+	real_BlendEquation(mode);
+}
+
+static void GLAPIENTRY cached_Enable(GLenum cap) {
+	int8_t *state = glstate_cap(cap);
+
+	if(state) {
+		if(glstate_check(GLSTATE_CAPS, *state == 1)) {
+			return;
+		}
+
+		*state = 1;
+	}
+
+	real_Enable(cap);
+}
+
+static void GLAPIENTRY cached_Disable(GLenum cap) {
+	int8_t *state = glstate_cap(cap);
+
+	if(state) {
+		if(glstate_check(GLSTATE_CAPS, *state == 0)) {
+			return;
+		}
+
+		*state = 0;
+	}
+
+	real_Disable(cap);
+}
+
+static void APIENTRY cached_BindFramebuffer(GLenum target, GLuint framebuffer) {
+	if(target != GL_FRAMEBUFFER) {
+		// binds only one of the draw/read targets; we no longer know what's what
+		glstate.framebuffer = NAME_UNKNOWN;
+		real_BindFramebuffer(target, framebuffer);
+		return;
+	}
+
+	if(glstate_check(GLSTATE_FRAMEBUFFER, framebuffer == glstate.framebuffer)) {
+		return;
+	}
+
+	glstate.framebuffer = framebuffer;
+	real_BindFramebuffer(target, framebuffer);
+}
+
+static void APIENTRY cached_DeleteFramebuffers(GLsizei n, const GLuint *framebuffers) {
+	for(GLsizei i = 0; i < n; ++i) {
+		if(framebuffers[i] == glstate.framebuffer) {
+			glstate.framebuffer = 0;
+		}
+	}
+
+	real_DeleteFramebuffers(n, framebuffers);
+}
+
+#define INSTALL(name) do { \
+	real_##name = tsgl##name; \
+	tsgl##name = cached_##name; \
+} while(0)
+
+static void glstate_install(void) {
+	INSTALL(ActiveTexture);
+	INSTALL(BindTexture);
+	INSTALL(DeleteTextures);
+	INSTALL(UseProgram);
+	INSTALL(DeleteProgram);
+	INSTALL(BlendFunc);
+	INSTALL(BlendFuncSeparate);
+	INSTALL(BlendEquation);
+	INSTALL(BlendEquationSeparate);
+	INSTALL(Enable);
+	INSTALL(Disable);
+	INSTALL(BindFramebuffer);
+	INSTALL(DeleteFramebuffers);
+}
+
+#undef INSTALL
+
+#endif // !LINK_TO_LIBGL
+
+void glstate_invalidate(void) {
+	glstate.active_unit = GLSTATE_UNITS;
+	glstate.program = NAME_UNKNOWN;
+	glstate.framebuffer = NAME_UNKNOWN;
+	glstate.blend = glstate.depth_test = glstate.cull_face = CAP_UNKNOWN;
+
+	for(int i = 0; i < GLSTATE_UNITS; ++i) {
+		glstate.textures[i] = NAME_UNKNOWN;
+		glstate.texture_2d[i] = CAP_UNKNOWN;
+	}
+
+	for(int i = 0; i < 4; ++i) {
+		glstate.blend_func[i] = ENUM_UNKNOWN;
+	}
+
+	for(int i = 0; i < 2; ++i) {
+		glstate.blend_eq[i] = ENUM_UNKNOWN;
+	}
+
+#ifndef LINK_TO_LIBGL
+	if(glstate.enabled) {
+		// most code never touches the active unit, so we'd better know which one it is
+		real_ActiveTexture(GL_TEXTURE0);
+		glstate.active_unit = 0;
+	}
+#endif
+}
+
+void glstate_init(void) {
+	memset(&glstate, 0, sizeof(glstate));
+
+	if(!getenvint("TAISEI_GL_STATE_CACHE", 1)) {
+		return;
+	}
+
+#ifdef LINK_TO_LIBGL
+	log_warn("The GL state cache is not available in builds linked directly to libGL");
+#else
+	glstate_install();
+	glstate.enabled = true;
+	glstate_invalidate();
+#endif
+}
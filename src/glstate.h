@@ -0,0 +1,53 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Shadow copy of some GL state, sitting in front of the tsgl* function table.
+ *
+ *  Calls that would set a piece of state to the value it already has are dropped before they
+ *  reach the driver. Tracked are: texture bindings per unit, the active texture unit, the
+ *  current program, blend function and equation, GL_BLEND/GL_DEPTH_TEST/GL_CULL_FACE, per-unit
+ *  GL_TEXTURE_2D, and the framebuffer binding. Anything not tracked goes through untouched.
+ *
+ *  Enabled by default; TAISEI_GL_STATE_CACHE=0 turns it off.
+ */
+
+typedef enum GLStateCategory {
+	GLSTATE_TEXTURE,
+	GLSTATE_ACTIVE_TEXTURE,
+	GLSTATE_PROGRAM,
+	GLSTATE_BLEND_FUNC,
+	GLSTATE_BLEND_EQUATION,
+	GLSTATE_CAPS,
+	GLSTATE_FRAMEBUFFER,
+	GLSTATE_NUM_CATEGORIES,
+} GLStateCategory;
+
+typedef struct GLStateCacheStats {
+	uint64_t calls[GLSTATE_NUM_CATEGORIES];
+	uint64_t skipped[GLSTATE_NUM_CATEGORIES];
+} GLStateCacheStats;
+
+// must be called after the function table is loaded, and after glstats_init
+void glstate_init(void);
+bool glstate_enabled(void);
+
+// forget everything; call after something changed GL state behind our back
+void glstate_invalidate(void);
+
+void glstate_get_stats(GLStateCacheStats *stats);
+void glstate_reset_stats(void);
+
+// logs the hit rate since the last reset, then resets the counters
+void glstate_log_stats(const char *context);
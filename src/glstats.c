@@ -0,0 +1,282 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "glstats.h"
+#include "global.h"
+
+#define TAISEIGL_NO_EXT_ABSTRACTION
+#include "taiseigl.h"
+#undef TAISEIGL_NO_EXT_ABSTRACTION
+
+static struct {
+	bool enabled;
+	GLFrameStats current;
+	GLFrameStats history[GLSTATS_HISTORY];
+	int history_head; // where the next frame goes
+	int history_size;
+} glstats;
+
+bool glstats_enabled(void) {
+	return glstats.enabled;
+}
+
+#ifndef LINK_TO_LIBGL
+
+// names are given without the gl prefix, so that they don't get macro-expanded
+#define GLSTATS_WRAP(name, params, args, count) \
+	static tsgl##name##_ptr real_##name; \
+	static void APIENTRY stats_##name params { \
+		count; \
+		real_##name args; \
+	}
+
+#define COUNT(counter) (++glstats.current.counter)
+#define COUNT_DRAW(numverts) (++glstats.current.draw_calls, glstats.current.vertices += (numverts))
+
+GLSTATS_WRAP(DrawArrays,
+	(GLenum mode, GLint first, GLsizei count),
+	(mode, first, count),
+	COUNT_DRAW(count))
+
+GLSTATS_WRAP(DrawElements,
+	(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices),
+	(mode, count, type, indices),
+	COUNT_DRAW(count))
+
+// glext.DrawArraysInstanced points to whichever variant the driver supports
+static tsglDrawArraysInstanced_ptr real_DrawArraysInstanced;
+static void APIENTRY stats_DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount) {
+	COUNT_DRAW((uint64_t)count * instancecount);
+	real_DrawArraysInstanced(mode, first, count, instancecount);
+}
+
+GLSTATS_WRAP(BindTexture,
+	(GLenum target, GLuint texture),
+	(target, texture),
+	COUNT(texture_binds))
+
+GLSTATS_WRAP(BindFramebuffer,
+	(GLenum target, GLuint framebuffer),
+	(target, framebuffer),
+	COUNT(framebuffer_binds))
+
+GLSTATS_WRAP(UseProgram,
+	(GLuint program),
+	(program),
+	COUNT(program_switches))
+
+GLSTATS_WRAP(BlendFunc,
+	(GLenum sfactor, GLenum dfactor),
+	(sfactor, dfactor),
+	COUNT(blend_changes))
+
+GLSTATS_WRAP(BlendFuncSeparate,
+	(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha),
+	(sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha),
+	COUNT(blend_changes))
+
+GLSTATS_WRAP(BlendEquation,
+	(GLenum mode),
+	(mode),
+	COUNT(blend_changes))
+
+GLSTATS_WRAP(BlendEquationSeparate,
+	(GLenum modeRGB, GLenum modeAlpha),
+	(modeRGB, modeAlpha),
+	COUNT(blend_changes))
+
+#define GLSTATS_WRAP_UNIFORM(name, params, args) \
+	GLSTATS_WRAP(name, params, args, COUNT(uniform_uploads))
+
+#define GLSTATS_WRAP_UNIFORM_V(name, type) \
+	GLSTATS_WRAP_UNIFORM(name, (GLint location, GLsizei count, const type *value), (location, count, value))
+
+GLSTATS_WRAP_UNIFORM(Uniform1f, (GLint location, GLfloat v0), (location, v0))
+GLSTATS_WRAP_UNIFORM(Uniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+GLSTATS_WRAP_UNIFORM(Uniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+GLSTATS_WRAP_UNIFORM(Uniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+GLSTATS_WRAP_UNIFORM(Uniform1i, (GLint location, GLint v0), (location, v0))
+GLSTATS_WRAP_UNIFORM_V(Uniform1fv, GLfloat)
+GLSTATS_WRAP_UNIFORM_V(Uniform2fv, GLfloat)
+GLSTATS_WRAP_UNIFORM_V(Uniform3fv, GLfloat)
+GLSTATS_WRAP_UNIFORM_V(Uniform4fv, GLfloat)
+GLSTATS_WRAP_UNIFORM_V(Uniform1iv, GLint)
+GLSTATS_WRAP_UNIFORM_V(Uniform2iv, GLint)
+GLSTATS_WRAP_UNIFORM_V(Uniform3iv, GLint)
+GLSTATS_WRAP_UNIFORM_V(Uniform4iv, GLint)
+GLSTATS_WRAP_UNIFORM_V(Uniform1uiv, GLuint)
+GLSTATS_WRAP_UNIFORM_V(Uniform2uiv, GLuint)
+GLSTATS_WRAP_UNIFORM_V(Uniform3uiv, GLuint)
+GLSTATS_WRAP_UNIFORM_V(Uniform4uiv, GLuint)
+
+#undef GLSTATS_WRAP_UNIFORM_V
+#undef GLSTATS_WRAP_UNIFORM
+#undef COUNT_DRAW
+#undef COUNT
+#undef GLSTATS_WRAP
+
+#define INSTALL(name) do { \
+	real_##name = tsgl##name; \
+	tsgl##name = stats_##name; \
+} while(0)
+
+static void glstats_install(void) {
+	INSTALL(DrawArrays);
+	INSTALL(DrawElements);
+	INSTALL(BindTexture);
+	INSTALL(BindFramebuffer);
+	INSTALL(UseProgram);
+	INSTALL(BlendFunc);
+	INSTALL(BlendFuncSeparate);
+	INSTALL(BlendEquation);
+	INSTALL(BlendEquationSeparate);
+	INSTALL(Uniform1f);
+	INSTALL(Uniform2f);
+	INSTALL(Uniform3f);
+	INSTALL(Uniform4f);
+	INSTALL(Uniform1i);
+	INSTALL(Uniform1fv);
+	INSTALL(Uniform2fv);
+	INSTALL(Uniform3fv);
+	INSTALL(Uniform4fv);
+	INSTALL(Uniform1iv);
+	INSTALL(Uniform2iv);
+	INSTALL(Uniform3iv);
+	INSTALL(Uniform4iv);
+	INSTALL(Uniform1uiv);
+	INSTALL(Uniform2uiv);
+	INSTALL(Uniform3uiv);
+	INSTALL(Uniform4uiv);
+
+	if(glext.DrawArraysInstanced) {
+		real_DrawArraysInstanced = glext.DrawArraysInstanced;
+		glext.DrawArraysInstanced = stats_DrawArraysInstanced;
+	}
+}
+
+#undef INSTALL
+
+#endif // !LINK_TO_LIBGL
+
+void glstats_init(void) {
+	if(!getenvint("TAISEI_GL_STATS", 0)) {
+		return;
+	}
+
+#ifdef LINK_TO_LIBGL
+	log_warn("GL statistics are not available in builds linked directly to libGL");
+#else
+	memset(&glstats, 0, sizeof(glstats));
+	glstats_install();
+	glstats.enabled = true;
+	log_info("GL call statistics enabled");
+#endif
+}
+
+void glstats_shutdown(void) {
+	if(!glstats.enabled) {
+		return;
+	}
+
+	const char *path = getenv("TAISEI_GL_STATS_FILE");
+
+	if(!path || !*path) {
+		path = "storage/glstats.csv";
+	}
+
+	glstats_export(path);
+}
+
+void glstats_frame_end(void) {
+	if(!glstats.enabled) {
+		return;
+	}
+
+	GLFrameStats *s = &glstats.current;
+	s->frame = global.frames;
+	s->stage = global.stage ? global.stage->id : 0;
+
+	glstats.history[glstats.history_head] = *s;
+	glstats.history_head = (glstats.history_head + 1) % GLSTATS_HISTORY;
+
+	if(glstats.history_size < GLSTATS_HISTORY) {
+		++glstats.history_size;
+	}
+
+	memset(s, 0, sizeof(*s));
+}
+
+const GLFrameStats* glstats_get_frame(int age) {
+	if(age < 0 || age >= glstats.history_size) {
+		return NULL;
+	}
+
+	int idx = glstats.history_head - 1 - age;
+
+	if(idx < 0) {
+		idx += GLSTATS_HISTORY;
+	}
+
+	return glstats.history + idx;
+}
+
+void glstats_get_peak(GLFrameStats *peak) {
+	memset(peak, 0, sizeof(*peak));
+
+	#define PEAK(field) if(s->field > peak->field) peak->field = s->field
+
+	for(int i = 0; i < glstats.history_size; ++i) {
+		const GLFrameStats *s = glstats.history + i;
+		PEAK(draw_calls);
+		PEAK(vertices);
+		PEAK(texture_binds);
+		PEAK(program_switches);
+		PEAK(uniform_uploads);
+		PEAK(blend_changes);
+		PEAK(framebuffer_binds);
+	}
+
+	#undef PEAK
+}
+
+bool glstats_export(const char *vfspath) {
+	SDL_RWops *out = vfs_open(vfspath, VFS_MODE_WRITE);
+
+	if(!out) {
+		log_warn("VFS error: %s", vfs_get_error());
+		return false;
+	}
+
+	SDL_RWprintf(out, "frame,stage,draw_calls,vertices,texture_binds,program_switches,uniform_uploads,blend_changes,framebuffer_binds\n");
+
+	for(int age = glstats.history_size - 1; age >= 0; --age) {
+		const GLFrameStats *s = glstats_get_frame(age);
+
+		SDL_RWprintf(out, "%u,%X,%u,%"PRIu64",%u,%u,%u,%u,%u\n",
+			s->frame,
+			s->stage,
+			s->draw_calls,
+			s->vertices,
+			s->texture_binds,
+			s->program_switches,
+			s->uniform_uploads,
+			s->blend_changes,
+			s->framebuffer_binds
+		);
+	}
+
+	SDL_RWclose(out);
+
+	char *syspath = vfs_repr(vfspath, true);
+	log_info("Saved GL statistics for %i frames to %s", glstats.history_size, syspath);
+	free(syspath);
+
+	return true;
+}
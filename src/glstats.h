@@ -0,0 +1,52 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Optional instrumentation of the GL function table.
+ *
+ *  When enabled with TAISEI_GL_STATS, the draw, bind, blend and uniform entry points are
+ *  replaced by wrappers that count calls before forwarding them. The counters are collected
+ *  into a ring buffer every time a frame is presented.
+ */
+
+#define GLSTATS_HISTORY 600
+
+typedef struct GLFrameStats {
+	uint32_t frame;      // value of global.frames when the frame was presented
+	uint16_t stage;      // id of the stage that was running, 0 if none
+	uint32_t draw_calls;
+	uint64_t vertices;
+	uint32_t texture_binds;
+	uint32_t program_switches;
+	uint32_t uniform_uploads;
+	uint32_t blend_changes;
+	uint32_t framebuffer_binds;
+} GLFrameStats;
+
+// installs the wrappers; must be called after the function table and glext are initialized
+void glstats_init(void);
+void glstats_shutdown(void);
+bool glstats_enabled(void);
+
+// moves the current counters into the history and resets them
+void glstats_frame_end(void);
+
+// 0 is the last completed frame; returns NULL if there's no such frame in the history
+const GLFrameStats* glstats_get_frame(int age);
+
+// largest value of every counter in the history
+void glstats_get_peak(GLFrameStats *peak);
+
+// writes the history as CSV, oldest frame first
+bool glstats_export(const char *vfspath);
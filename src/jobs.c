@@ -0,0 +1,518 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "jobs.h"
+#include "util.h"
+
+#include <SDL_atomic.h>
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
+
+// #define JOBS_BENCHMARK
+
+enum {
+	JOBS_MAX_THREADS = 32,
+	JOBS_DEQUE_SIZE = 4096, // must be a power of two
+	JOBS_WAIT_SPINS = 64,
+};
+
+typedef struct ParallelFor {
+	JobRangeFunc func;
+	void *arg;
+	size_t count;
+	size_t grain;
+	int num_chunks;
+	SDL_atomic_t next_chunk;
+} ParallelFor;
+
+struct Job {
+	JobFunc func;
+	void *arg;
+	ParallelFor *pfor; // owned by the job, if any
+
+	SDL_atomic_t refs;
+	SDL_atomic_t pending; // unfinished dependencies, plus one until submitted
+	SDL_atomic_t done;
+
+	SDL_SpinLock lock; // protects everything below
+	bool finished;
+	Job **dependents;
+	size_t num_dependents;
+	size_t dependents_capacity;
+};
+
+typedef struct JobDeque {
+	SDL_SpinLock lock;
+	uint32_t top;    // thieves take from here
+	uint32_t bottom; // the owner pushes and pops here
+	Job *ring[JOBS_DEQUE_SIZE];
+} JobDeque;
+
+static struct {
+	JobDeque *deques;
+	JobDeque idle; // see job_submit_idle
+	SDL_Thread **threads;
+	int num_threads; // including the main thread
+	SDL_sem *wake;
+	SDL_atomic_t num_sleeping;
+	SDL_atomic_t shutdown;
+} jobs;
+
+static _Thread_local int jobs_thread_index = -1;
+
+static bool deque_push(JobDeque *dq, Job *job) {
+	bool ok = false;
+	SDL_AtomicLock(&dq->lock);
+
+	if(dq->bottom - dq->top < JOBS_DEQUE_SIZE) {
+		dq->ring[dq->bottom++ & (JOBS_DEQUE_SIZE - 1)] = job;
+		ok = true;
+	}
+
+	SDL_AtomicUnlock(&dq->lock);
+	return ok;
+}
+
+static Job* deque_pop(JobDeque *dq) {
+	Job *job = NULL;
+	SDL_AtomicLock(&dq->lock);
+
+	if(dq->bottom != dq->top) {
+		job = dq->ring[--dq->bottom & (JOBS_DEQUE_SIZE - 1)];
+	}
+
+	SDL_AtomicUnlock(&dq->lock);
+	return job;
+}
+
+static Job* deque_steal(JobDeque *dq) {
+	Job *job = NULL;
+
+	if(!SDL_AtomicTryLock(&dq->lock)) {
+		// someone else is busy with it, try another victim
+		return NULL;
+	}
+
+	if(dq->bottom != dq->top) {
+		job = dq->ring[dq->top++ & (JOBS_DEQUE_SIZE - 1)];
+	}
+
+	SDL_AtomicUnlock(&dq->lock);
+	return job;
+}
+
+static Job* deque_take(JobDeque *dq) {
+	Job *job = NULL;
+	SDL_AtomicLock(&dq->lock);
+
+	if(dq->bottom != dq->top) {
+		job = dq->ring[dq->top++ & (JOBS_DEQUE_SIZE - 1)];
+	}
+
+	SDL_AtomicUnlock(&dq->lock);
+	return job;
+}
+
+static Job* jobs_find(int self) {
+	Job *job = NULL;
+
+	if(!jobs.deques) {
+		return NULL;
+	}
+
+	if(self >= 0 && (job = deque_pop(jobs.deques + self))) {
+		return job;
+	}
+
+	for(int i = 1; i <= jobs.num_threads; ++i) {
+		int victim = (self + i + jobs.num_threads) % jobs.num_threads;
+
+		if(victim != self && (job = deque_steal(jobs.deques + victim))) {
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void jobs_run(Job *job);
+
+static void jobs_schedule(Job *job) {
+	int self = jobs_thread_index < 0 ? 0 : jobs_thread_index;
+
+	if(!jobs.deques || !deque_push(jobs.deques + self, job)) {
+		// not running, or the queue is full; either way it's our job now
+		jobs_run(job);
+		return;
+	}
+
+	if(SDL_AtomicGet(&jobs.num_sleeping) > 0) {
+		SDL_SemPost(jobs.wake);
+	}
+}
+
+static void job_free(Job *job) {
+	free(job->dependents);
+	free(job->pfor);
+	free(job);
+}
+
+void job_release(Job *job) {
+	if(SDL_AtomicDecRef(&job->refs)) {
+		job_free(job);
+	}
+}
+
+static void jobs_run(Job *job) {
+	if(job->func) {
+		job->func(job->arg);
+	}
+
+	SDL_AtomicLock(&job->lock);
+	job->finished = true;
+	Job **dependents = job->dependents;
+	size_t num_dependents = job->num_dependents;
+	job->dependents = NULL;
+	job->num_dependents = job->dependents_capacity = 0;
+	SDL_AtomicUnlock(&job->lock);
+
+	for(size_t i = 0; i < num_dependents; ++i) {
+		if(SDL_AtomicDecRef(&dependents[i]->pending)) {
+			jobs_schedule(dependents[i]);
+		}
+	}
+
+	free(dependents);
+	SDL_AtomicSet(&job->done, 1);
+
+	// the scheduler's reference, taken in job_submit
+	job_release(job);
+}
+
+Job* job_create(JobFunc func, void *arg) {
+	Job *job = calloc(1, sizeof(Job));
+	job->func = func;
+	job->arg = arg;
+	SDL_AtomicSet(&job->refs, 1);
+	SDL_AtomicSet(&job->pending, 1);
+	return job;
+}
+
+void job_depends_on(Job *job, Job *dependency) {
+	SDL_AtomicLock(&dependency->lock);
+
+	if(!dependency->finished) {
+		if(dependency->num_dependents == dependency->dependents_capacity) {
+			dependency->dependents_capacity = dependency->dependents_capacity ? dependency->dependents_capacity * 2 : 4;
+			dependency->dependents = realloc(dependency->dependents, dependency->dependents_capacity * sizeof(Job*));
+		}
+
+		dependency->dependents[dependency->num_dependents++] = job;
+		SDL_AtomicIncRef(&job->pending);
+	}
+
+	SDL_AtomicUnlock(&dependency->lock);
+}
+
+void job_submit(Job *job) {
+	SDL_AtomicIncRef(&job->refs);
+
+	if(SDL_AtomicDecRef(&job->pending)) {
+		jobs_schedule(job);
+	}
+}
+
+void job_submit_idle(Job *job) {
+	// a finished dependency would schedule it into the normal queues
+	assert(SDL_AtomicGet(&job->pending) == 1);
+
+	SDL_AtomicIncRef(&job->refs);
+	SDL_AtomicSet(&job->pending, 0);
+
+	if(jobs.num_threads < 2 || !deque_push(&jobs.idle, job)) {
+		jobs_run(job);
+		return;
+	}
+
+	if(SDL_AtomicGet(&jobs.num_sleeping) > 0) {
+		SDL_SemPost(jobs.wake);
+	}
+}
+
+bool job_is_done(Job *job) {
+	return SDL_AtomicGet(&job->done);
+}
+
+void job_wait(Job *job) {
+	int idle = 0;
+
+	while(!SDL_AtomicGet(&job->done)) {
+		Job *other = jobs_find(jobs_thread_index);
+
+		if(other) {
+			jobs_run(other);
+			idle = 0;
+		} else if(++idle > JOBS_WAIT_SPINS) {
+			// whatever we're waiting for is running elsewhere
+			SDL_Delay(0);
+		}
+	}
+}
+
+static void parallel_for_work(void *arg) {
+	ParallelFor *pf = arg;
+
+	for(;;) {
+		int chunk = SDL_AtomicAdd(&pf->next_chunk, 1);
+
+		if(chunk >= pf->num_chunks) {
+			break;
+		}
+
+		size_t begin = chunk * pf->grain;
+		size_t end = begin + pf->grain;
+
+		if(end > pf->count) {
+			end = pf->count;
+		}
+
+		pf->func(pf->arg, begin, end);
+	}
+}
+
+Job* jobs_parallel_for_async(size_t count, size_t grain, JobRangeFunc func, void *arg) {
+	if(grain < 1) {
+		grain = 1;
+	}
+
+	ParallelFor *pf = calloc(1, sizeof(ParallelFor));
+	pf->func = func;
+	pf->arg = arg;
+	pf->count = count;
+	pf->grain = grain;
+	pf->num_chunks = (count + grain - 1) / grain;
+
+	Job *root = job_create(NULL, NULL);
+	root->pfor = pf;
+
+	// One runner per thread is enough, they take chunks until there are none left.
+	// Whoever waits for the root job will pick up the runners it still has queued.
+	int num_runners = jobs.num_threads > 1 ? jobs.num_threads : 1;
+
+	if(num_runners > pf->num_chunks) {
+		num_runners = pf->num_chunks;
+	}
+
+	for(int i = 0; i < num_runners; ++i) {
+		Job *runner = job_create(parallel_for_work, pf);
+		job_depends_on(root, runner);
+		job_submit(runner);
+		job_release(runner);
+	}
+
+	job_submit(root);
+	return root;
+}
+
+void jobs_parallel_for(size_t count, size_t grain, JobRangeFunc func, void *arg) {
+	Job *job = jobs_parallel_for_async(count, grain, func, arg);
+	job_wait(job);
+	job_release(job);
+}
+
+static Job* jobs_find_worker(int self) {
+	Job *job = jobs_find(self);
+	return job ? job : deque_take(&jobs.idle);
+}
+
+static int jobs_worker_thread(void *arg) {
+	jobs_thread_index = (intptr_t)arg;
+
+	for(;;) {
+		Job *job = jobs_find_worker(jobs_thread_index);
+
+		if(job) {
+			jobs_run(job);
+			continue;
+		}
+
+		SDL_AtomicIncRef(&jobs.num_sleeping);
+
+		// check again now that we're counted as sleeping, or we could miss a wakeup
+		if(!(job = jobs_find_worker(jobs_thread_index)) && !SDL_AtomicGet(&jobs.shutdown)) {
+			SDL_SemWait(jobs.wake);
+		}
+
+		SDL_AtomicAdd(&jobs.num_sleeping, -1);
+
+		if(job) {
+			jobs_run(job);
+		} else if(SDL_AtomicGet(&jobs.shutdown)) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void jobs_start(int num_workers) {
+	if(num_workers > JOBS_MAX_THREADS - 1) {
+		num_workers = JOBS_MAX_THREADS - 1;
+	}
+
+	if(num_workers < 0) {
+		num_workers = 0;
+	}
+
+	memset(&jobs, 0, sizeof(jobs));
+	jobs_thread_index = 0;
+
+	if(!(jobs.wake = SDL_CreateSemaphore(0))) {
+		log_warn("SDL_CreateSemaphore() failed: %s", SDL_GetError());
+		num_workers = 0;
+	}
+
+	jobs.deques = calloc(num_workers + 1, sizeof(JobDeque));
+	jobs.threads = calloc(num_workers + 1, sizeof(SDL_Thread*));
+	jobs.num_threads = num_workers + 1;
+
+	for(int i = 1; i <= num_workers; ++i) {
+		if(!(jobs.threads[i] = SDL_CreateThread(jobs_worker_thread, "jobs", (void*)(intptr_t)i))) {
+			log_warn("SDL_CreateThread() failed: %s", SDL_GetError());
+			jobs.num_threads = i;
+			break;
+		}
+	}
+
+	log_debug("Running jobs on %i threads", jobs.num_threads);
+}
+
+void jobs_init(void) {
+	int num_workers = getenvint("TAISEI_JOB_THREADS", -1);
+
+	if(num_workers < 0) {
+		num_workers = SDL_GetCPUCount() - 1;
+	}
+
+	jobs_start(num_workers);
+}
+
+void jobs_shutdown(void) {
+	if(!jobs.deques) {
+		return;
+	}
+
+	// finish whatever is left in our own queue, the workers drain theirs and the idle one before quitting
+	for(Job *job; (job = deque_pop(jobs.deques));) {
+		jobs_run(job);
+	}
+
+	SDL_AtomicSet(&jobs.shutdown, 1);
+
+	for(int i = 1; i < jobs.num_threads; ++i) {
+		SDL_SemPost(jobs.wake);
+	}
+
+	for(int i = 1; i < jobs.num_threads; ++i) {
+		SDL_WaitThread(jobs.threads[i], NULL);
+	}
+
+	if(jobs.wake) {
+		SDL_DestroySemaphore(jobs.wake);
+	}
+
+	free(jobs.deques);
+	free(jobs.threads);
+	memset(&jobs, 0, sizeof(jobs));
+	jobs_thread_index = -1;
+}
+
+int jobs_num_threads(void) {
+	return jobs.num_threads > 0 ? jobs.num_threads : 1;
+}
+
+int jobs_thread_id(void) {
+	return jobs_thread_index;
+}
+
+#ifdef JOBS_BENCHMARK
+
+typedef struct BenchBullet {
+	complex pos;
+	complex vel;
+	float angle;
+	int alive;
+} BenchBullet;
+
+static void jobs_benchmark_update(void *arg, size_t begin, size_t end) {
+	BenchBullet *b = arg;
+
+	for(size_t i = begin; i < end; ++i) {
+		// roughly what an asymptotic bullet with some rotation does every frame
+		b[i].vel *= cexp(I * 0.01);
+		b[i].pos += b[i].vel;
+		b[i].angle = carg(b[i].vel);
+		b[i].alive = creal(b[i].pos) > -100 && creal(b[i].pos) < 600 && cimag(b[i].pos) > -100 && cimag(b[i].pos) < 700;
+	}
+}
+
+static void jobs_benchmark_reset(BenchBullet *b, size_t num) {
+	for(size_t i = 0; i < num; ++i) {
+		b[i].pos = 240 + 280 * I;
+		b[i].vel = cexp(I * 2 * M_PI * i / num) * (1 + (i % 7) * 0.25);
+	}
+}
+
+#endif
+
+int jobs_benchmark(void) {
+#ifdef JOBS_BENCHMARK
+	const size_t num_bullets = getenvint("TAISEI_JOBS_BENCHMARK_BULLETS", 100000);
+	const int num_frames = getenvint("TAISEI_JOBS_BENCHMARK_FRAMES", 600);
+	const size_t grain = 1024;
+
+	int max_threads = SDL_GetCPUCount();
+	BenchBullet *bullets = calloc(num_bullets, sizeof(BenchBullet));
+	double base_time = 0;
+
+	if(max_threads > JOBS_MAX_THREADS) {
+		max_threads = JOBS_MAX_THREADS;
+	}
+
+	for(int threads = 1; threads <= max_threads; ++threads) {
+		jobs_start(threads - 1);
+		jobs_benchmark_reset(bullets, num_bullets);
+
+		uint64_t start = SDL_GetPerformanceCounter();
+
+		for(int frame = 0; frame < num_frames; ++frame) {
+			jobs_parallel_for(num_bullets, grain, jobs_benchmark_update, bullets);
+		}
+
+		double elapsed = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+		jobs_shutdown();
+
+		if(threads == 1) {
+			base_time = elapsed;
+		}
+
+		log_info("%2i thread%s: %i frames of %zu bullets in %.3f s (%.2f ms/frame, %.2fx)",
+			threads, threads > 1 ? "s" : " ",
+			num_frames, num_bullets, elapsed,
+			1000 * elapsed / num_frames, base_time / elapsed
+		);
+	}
+
+	free(bullets);
+	return 1;
+#else
+	return 0;
+#endif
+}
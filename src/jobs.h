@@ -0,0 +1,63 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *  A small work-stealing job scheduler.
+ *
+ *  Every worker thread, and the main thread, owns a deque of jobs. A thread pushes and pops its
+ *  own jobs from the bottom; idle threads steal from the top of everyone else's. Threads that
+ *  wait for a job keep running other jobs in the meantime, so waiting from inside a job is fine.
+ *
+ *  Jobs are reference counted. job_create() returns a reference owned by the caller, which must
+ *  eventually be dropped with job_release(), whether or not the job is waited for.
+ */
+
+typedef struct Job Job;
+typedef void (*JobFunc)(void *arg);
+typedef void (*JobRangeFunc)(void *arg, size_t begin, size_t end);
+
+void jobs_init(void);
+void jobs_shutdown(void);
+
+// number of threads that may run jobs, including the main thread
+int jobs_num_threads(void);
+
+// 0 on the main thread, 1 to jobs_num_threads()-1 on workers, -1 on any other thread
+int jobs_thread_id(void);
+
+// creates a job, but doesn't schedule it yet; func may be NULL for a pure synchronization point
+Job* job_create(JobFunc func, void *arg);
+
+// job won't start until dependency has finished; must be called before job_submit(job)
+void job_depends_on(Job *job, Job *dependency);
+
+void job_submit(Job *job);
+
+// for work that may take a long time and must not hold up a frame, like loading resources;
+// only the worker threads run these, and only when they have nothing else to do. The job can't
+// have dependencies. Without worker threads it runs right away, on the calling thread.
+void job_submit_idle(Job *job);
+
+void job_wait(Job *job);
+bool job_is_done(Job *job);
+void job_release(Job *job);
+
+// splits [0, count) into chunks of at most grain indices and runs func on them in parallel;
+// the returned job finishes when all of them are done
+Job* jobs_parallel_for_async(size_t count, size_t grain, JobRangeFunc func, void *arg);
+
+// same as above, but returns only once everything has been processed
+void jobs_parallel_for(size_t count, size_t grain, JobRangeFunc func, void *arg);
+
+int jobs_benchmark(void);
@@ -18,6 +18,7 @@
 #include "log.h"
 #include "util.h"
 #include "list.h"
+#include "flightrec.h"
 
 #ifdef __WINDOWS__
 	#define LOG_EOL "\r\n"
@@ -79,6 +80,8 @@ static char* format_log_string(LogLevel lvl, const char *funcname, const char *f
 }
 
 noreturn static void log_abort(const char *msg) {
+	flightrec_dump("fatal");
+
 #ifdef LOG_FATAL_MSGBOX
 	if(msg) {
 		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Taisei error", msg, NULL);
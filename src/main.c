@@ -26,14 +26,24 @@
 #include "vfs/setup.h"
 #include "version.h"
 #include "credits.h"
+#include "jobs.h"
+#include "drawbuffer.h"
+#include "dynatlas.h"
+#include "profiler.h"
+#include "flightrec.h"
+#include "metrics.h"
 
 static void taisei_shutdown(void) {
 	log_info("Shutting down");
 
+	profiler_shutdown();
+	flightrec_shutdown();
+	metrics_shutdown();
 	config_save();
 	progress_save();
 	progress_unload();
 
+	jobs_shutdown();
 	free_all_refs();
 	free_resources(true);
 	uninit_fonts();
@@ -123,6 +133,18 @@ static int run_tests(void) {
 		return 1;
 	}
 
+	if(jobs_benchmark()) {
+		return 1;
+	}
+
+	if(drawbuffer_test()) {
+		return 1;
+	}
+
+	if(dynatlas_test()) {
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -220,7 +242,7 @@ int main(int argc, char **argv) {
 
 		free_cli_action(&a);
 		return 0;
-	} else if(a.type == CLI_PlayReplay) {
+	} else if(a.type == CLI_PlayReplay || a.type == CLI_VerifyReplay) {
 		if(!replay_load_syspath(&replay, a.filename, REPLAY_READ_ALL)) {
 			free_cli_action(&a);
 			return 1;
@@ -266,6 +288,10 @@ int main(int argc, char **argv) {
 
 	init_sdl();
 	time_init();
+	flightrec_init();
+	profiler_init();
+	metrics_init();
+	jobs_init();
 	init_global(&a);
 	events_init();
 	init_fonts();
@@ -294,6 +320,14 @@ int main(int argc, char **argv) {
 		return 0;
 	}
 
+#ifdef DEBUG
+	if(a.type == CLI_VerifyReplay) {
+		bool ok = replay_verify_headless(&replay, replay_idx);
+		replay_destroy(&replay);
+		return ok ? 0 : 1;
+	}
+#endif
+
 #ifdef DEBUG
 	log_warn("Compiled with DEBUG flag!");
 
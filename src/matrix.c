@@ -122,3 +122,109 @@ void normalize(Vector v) {
 float length(Vector v) {
 	return sqrt(pow(v[0],2) + pow(v[1],2) + pow(v[2],2));
 }
+
+void matstack_reset(MatrixStack *ms) {
+	ms->top = 0;
+	matcpy(ms->stack[0], _identity);
+}
+
+void matstack_push(MatrixStack *ms) {
+	if(ms->top == MATSTACK_DEPTH - 1) {
+		log_fatal("Matrix stack overflow");
+	}
+
+	matcpy(ms->stack[ms->top + 1], ms->stack[ms->top]);
+	++ms->top;
+}
+
+void matstack_pop(MatrixStack *ms) {
+	if(ms->top == 0) {
+		log_fatal("Matrix stack underflow");
+	}
+
+	--ms->top;
+}
+
+void matstack_identity(MatrixStack *ms) {
+	matcpy(ms->stack[ms->top], _identity);
+}
+
+// In column-major terms, right-multiplying the current matrix by a transform only mixes its
+// columns, so every function below is a handful of 4-wide multiply-adds.
+
+void matstack_translate(MatrixStack *ms, float x, float y, float z) {
+	float (*m)[4] = ms->stack[ms->top];
+
+	for(int i = 0; i < 4; ++i) {
+		m[3][i] += m[0][i] * x + m[1][i] * y + m[2][i] * z;
+	}
+}
+
+void matstack_scale(MatrixStack *ms, float x, float y, float z) {
+	float (*m)[4] = ms->stack[ms->top];
+
+	for(int i = 0; i < 4; ++i) {
+		m[0][i] *= x;
+		m[1][i] *= y;
+		m[2][i] *= z;
+	}
+}
+
+void matstack_rotate(MatrixStack *ms, float angle, float x, float y, float z) {
+	float (*m)[4] = ms->stack[ms->top];
+	float c = cos(angle);
+	float s = sin(angle);
+
+	if(x == 0 && y == 0) {
+		// by far the most common case, rotation in the screen plane
+		if(z < 0) {
+			s = -s;
+		}
+
+		for(int i = 0; i < 4; ++i) {
+			float c0 = m[0][i], c1 = m[1][i];
+			m[0][i] = c0 * c + c1 * s;
+			m[1][i] = c1 * c - c0 * s;
+		}
+
+		return;
+	}
+
+	Vector axis = { x, y, z };
+	normalize(axis);
+	x = axis[0]; y = axis[1]; z = axis[2];
+
+	// same as in matrotate, row-major: r[row][col]
+	float r[3][3] = {
+		{x*x*(1-c)+c, x*y*(1-c)-z*s, x*z*(1-c)+y*s},
+		{y*x*(1-c)+z*s, y*y*(1-c)+c, y*z*(1-c)-x*s},
+		{x*z*(1-c)-y*s, y*z*(1-c)+x*s, z*z*(1-c)+c},
+	};
+
+	float cols[3][4];
+	memcpy(cols, m, sizeof(cols));
+
+	for(int j = 0; j < 3; ++j) {
+		for(int i = 0; i < 4; ++i) {
+			m[j][i] = cols[0][i] * r[0][j] + cols[1][i] * r[1][j] + cols[2][i] * r[2][j];
+		}
+	}
+}
+
+void matstack_mul(MatrixStack *ms, Matrix m) {
+	// both column-major, so as row-major arrays this is (top * m)^T = m^T * top^T
+	Matrix tmp;
+	matmul(tmp, m, ms->stack[ms->top]);
+	matcpy(ms->stack[ms->top], tmp);
+}
+
+void matstack_transform(MatrixStack *ms, Vector v) {
+	float (*m)[4] = ms->stack[ms->top];
+	Vector tmp;
+
+	for(int i = 0; i < 3; ++i) {
+		tmp[i] = m[0][i] * v[0] + m[1][i] * v[1] + m[2][i] * v[2] + m[3][i];
+	}
+
+	memcpy(v, tmp, sizeof(Vector));
+}
@@ -28,3 +28,34 @@ void matvecv(Matrix m, Vector *vs, int size);
 
 void normalize(Vector v);
 float length(Vector v);
+
+/*
+ *  A matrix stack that works like the legacy GL one, but on the CPU.
+ *
+ *  Unlike everything above, matrices on the stack are stored column-major, i.e. m[column][row],
+ *  which is the layout glLoadMatrixf wants. It also lets every transformation be written as a
+ *  few operations on whole 4-float columns, which compilers turn into SIMD code.
+ */
+
+#define MATSTACK_DEPTH 32
+
+typedef struct MatrixStack {
+	Matrix stack[MATSTACK_DEPTH];
+	int top;
+} MatrixStack;
+
+void matstack_reset(MatrixStack *ms);
+void matstack_push(MatrixStack *ms);
+void matstack_pop(MatrixStack *ms);
+void matstack_identity(MatrixStack *ms);
+void matstack_translate(MatrixStack *ms, float x, float y, float z);
+void matstack_rotate(MatrixStack *ms, float angle, float x, float y, float z); // radians
+void matstack_scale(MatrixStack *ms, float x, float y, float z);
+void matstack_mul(MatrixStack *ms, Matrix m); // m is column-major too
+
+static inline float (*matstack_current(MatrixStack *ms))[4] {
+	return ms->stack[ms->top];
+}
+
+// transforms a point by the current matrix
+void matstack_transform(MatrixStack *ms, Vector v);
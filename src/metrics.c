@@ -0,0 +1,185 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "metrics.h"
+#include "global.h"
+#include "stageobjects.h"
+
+#define METRICS_NUM_POOLS (sizeof(StageObjectPools)/sizeof(ObjectPool*))
+
+static const char *counter_names[] = {
+	[METRIC_SOUND_PLAYS] = "sound_plays",
+	[METRIC_LAZY_LOADS]  = "lazy_loads",
+};
+
+static struct {
+	SDL_RWops *out;
+	char *path;
+	bool json;
+	bool header_written;
+	bool writing_header;
+	bool first_field;
+	int interval;
+	uint32_t rows;
+	uint32_t counters[METRIC_NUM_COUNTERS];
+} metrics;
+
+bool metrics_enabled(void) {
+	return metrics.out;
+}
+
+void metrics_init(void) {
+	memset(&metrics, 0, sizeof(metrics));
+
+	if(!getenvint("TAISEI_METRICS", 0)) {
+		return;
+	}
+
+	const char *format = getenv("TAISEI_METRICS_FORMAT");
+	metrics.json = format && !strcmp(format, "json");
+
+	const char *path = getenv("TAISEI_METRICS_FILE");
+
+	if(!path || !*path) {
+		path = metrics.json ? "storage/metrics.jsonl" : "storage/metrics.csv";
+	}
+
+	metrics.out = vfs_open(path, VFS_MODE_WRITE);
+
+	if(!metrics.out) {
+		log_warn("Metrics disabled: VFS error: %s", vfs_get_error());
+		return;
+	}
+
+	metrics.path = strdup(path);
+	metrics.interval = max(1, getenvint("TAISEI_METRICS_INTERVAL", 1));
+	log_info("Writing %s metrics every %i frames", metrics.json ? "JSON" : "CSV", metrics.interval);
+}
+
+void metrics_shutdown(void) {
+	if(!metrics.out) {
+		return;
+	}
+
+	SDL_RWclose(metrics.out);
+
+	char *syspath = vfs_repr(metrics.path, true);
+	log_info("Saved %u rows of metrics to %s", metrics.rows, syspath);
+	free(syspath);
+	free(metrics.path);
+
+	memset(&metrics, 0, sizeof(metrics));
+}
+
+void metrics_count(MetricsCounter counter) {
+	if(metrics.out) {
+		++metrics.counters[counter];
+	}
+}
+
+static uint32_t count_objects(void *head) {
+	uint32_t count = 0;
+
+	for(List *e = head; e; e = e->next) {
+		++count;
+	}
+
+	return count;
+}
+
+static double last_frametime_ms(FPSCounter *fps) {
+	return 1000.0 * fps->frametimes[sizeof(fps->frametimes)/sizeof(*fps->frametimes) - 1];
+}
+
+// writes "name":value for JSON, or just the value (or the name, in the header) for CSV
+static void metrics_field(const char *name, const char *fmt, ...) __attribute__((format(FORMAT_ATTR, 2, 3)));
+
+static void metrics_field(const char *name, const char *fmt, ...) {
+	const char *sep = metrics.first_field ? "" : ",";
+	metrics.first_field = false;
+
+	if(metrics.writing_header) {
+		SDL_RWprintf(metrics.out, "%s%s", sep, name);
+		return;
+	}
+
+	char buf[64];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	if(metrics.json) {
+		SDL_RWprintf(metrics.out, "%s\"%s\":%s", sep, name, buf);
+	} else {
+		SDL_RWprintf(metrics.out, "%s%s", sep, buf);
+	}
+}
+
+static void metrics_row(void) {
+	metrics.first_field = true;
+
+	if(metrics.json) {
+		SDL_RWprintf(metrics.out, "{");
+	}
+
+	metrics_field("frame", "%i", global.frames);
+	metrics_field("stage", metrics.json ? "\"%X\"" : "%X", global.stage ? global.stage->id : 0);
+	metrics_field("difficulty", "%i", global.diff);
+
+	metrics_field("projectiles", "%u", count_objects(global.projs));
+	metrics_field("particles",   "%u", count_objects(global.particles));
+	metrics_field("lasers",      "%u", count_objects(global.lasers));
+	metrics_field("enemies",     "%u", count_objects(global.enemies));
+	metrics_field("items",       "%u", count_objects(global.items));
+
+	for(int i = 0; i < METRICS_NUM_POOLS; ++i) {
+		ObjectPool *pool = (&stage_object_pools.first)[i];
+		ObjectPoolStats stats = { .tag = "pool" };
+		char name[32];
+
+		if(pool) {
+			objpool_get_stats(pool, &stats);
+		}
+
+		snprintf(name, sizeof(name), "%s_usage", stats.tag);
+		metrics_field(name, "%zu", stats.usage);
+		snprintf(name, sizeof(name), "%s_peak", stats.tag);
+		metrics_field(name, "%zu", stats.peak_usage);
+	}
+
+	// these are from the previous frame; the current one isn't over yet
+	metrics_field("logic_ms",  "%.3f", (double)global.fps.logic_time * 1000.0);
+	metrics_field("render_ms", "%.3f", (double)global.fps.render_time * 1000.0);
+	metrics_field("busy_ms",   "%.3f", last_frametime_ms(&global.fps.busy));
+
+	for(int i = 0; i < METRIC_NUM_COUNTERS; ++i) {
+		metrics_field(counter_names[i], "%u", metrics.counters[i]);
+	}
+
+	SDL_RWprintf(metrics.out, metrics.json ? "}\n" : "\n");
+}
+
+void metrics_frame(void) {
+	if(!metrics.out || global.frames % metrics.interval) {
+		return;
+	}
+
+	if(!metrics.json && !metrics.header_written) {
+		metrics.writing_header = true;
+		metrics_row();
+		metrics.writing_header = false;
+		metrics.header_written = true;
+	}
+
+	metrics_row();
+	memset(metrics.counters, 0, sizeof(metrics.counters));
+	++metrics.rows;
+}
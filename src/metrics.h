@@ -0,0 +1,39 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include <stdbool.h>
+
+/*
+ *  Per-frame metrics stream.
+ *
+ *  When TAISEI_METRICS=1, every TAISEI_METRICS_INTERVAL-th stage logic frame appends a row of
+ *  object counts, object pool usage, frame times and event counters to TAISEI_METRICS_FILE.
+ *  The format is CSV, or JSON Lines (one object per row) if TAISEI_METRICS_FORMAT=json.
+ *
+ *  Everything but the frame times is deterministic for a given replay, so the output of a
+ *  headless replay playback can be diffed between builds.
+ */
+
+typedef enum MetricsCounter {
+	METRIC_SOUND_PLAYS,  // sound effects requested by the game logic, whether audible or not
+	METRIC_LAZY_LOADS,   // resources that had to be loaded because they weren't preloaded
+	METRIC_NUM_COUNTERS,
+} MetricsCounter;
+
+void metrics_init(void);
+void metrics_shutdown(void);
+bool metrics_enabled(void);
+
+// counters are reset every time a row is written
+void metrics_count(MetricsCounter counter);
+
+// called at the end of every stage logic frame
+void metrics_frame(void);
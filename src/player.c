@@ -15,6 +15,7 @@
 #include "plrmodes.h"
 #include "stage.h"
 #include "stagetext.h"
+#include "flightrec.h"
 
 void player_init(Player *plr) {
 	memset(plr, 0, sizeof(Player));
@@ -445,11 +446,27 @@ static bool player_set_axis(int *aptr, uint16_t value) {
 	return true;
 }
 
+static const char *player_event_names[] = {
+	[EV_PRESS]        = "press",
+	[EV_RELEASE]      = "release",
+	[EV_OVER]         = "over",
+	[EV_AXIS_LR]      = "axis lr",
+	[EV_AXIS_UD]      = "axis ud",
+	[EV_CHECK_DESYNC] = "check desync",
+	[EV_FPS]          = "fps",
+	[EV_INFLAGS]      = "inflags",
+	[EV_CONTINUE]     = "continue",
+};
+
 void player_event(Player *plr, uint8_t type, uint16_t value, bool *out_useful, bool *out_cheat) {
 	bool useful = true;
 	bool cheat = false;
 	bool is_replay = global.replaymode == REPLAY_PLAY;
 
+	if(type < sizeof(player_event_names)/sizeof(*player_event_names)) {
+		flightrec_instant(FLIGHTREC_INPUT, player_event_names[type], value);
+	}
+
 	switch(type) {
 		case EV_PRESS:
 			if(global.dialog && (value == KEY_SHOT || value == KEY_BOMB)) {
@@ -0,0 +1,189 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "profiler.h"
+#include "global.h"
+#include "flightrec.h"
+
+#ifdef TAISEI_BUILDCONF_PROFILER
+
+#define PROFILER_MAX_DEPTH 32
+
+// about 48 MB worth of events, or over half an hour of gameplay
+#define PROFILER_MAX_EVENTS (1 << 21)
+
+typedef struct ProfilerEvent {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+} ProfilerEvent;
+
+typedef struct ProfilerZone {
+	const char *name;
+	uint64_t begin;
+	uint32_t event; // index into events, UINT32_MAX if not traced
+} ProfilerZone;
+
+static struct {
+	bool tracing;   // recording a trace for TAISEI_PROFILER
+	bool active;    // tracking zones at all; the flight recorder wants them too
+	bool overflow;
+	SDL_threadID main_thread;
+	uint64_t epoch;
+	uint64_t freq;
+
+	ProfilerEvent *events;
+	uint32_t num_events;
+	uint32_t capacity;
+
+	ProfilerZone stack[PROFILER_MAX_DEPTH];
+	int depth;
+} profiler;
+
+bool profiler_enabled(void) {
+	return profiler.tracing;
+}
+
+void profiler_init(void) {
+	memset(&profiler, 0, sizeof(profiler));
+
+	profiler.tracing = getenvint("TAISEI_PROFILER", 0);
+	profiler.active = profiler.tracing || flightrec_enabled();
+	profiler.main_thread = SDL_ThreadID();
+	profiler.freq = SDL_GetPerformanceFrequency();
+	profiler.epoch = SDL_GetPerformanceCounter();
+
+	if(profiler.tracing) {
+		log_info("Zone profiler enabled");
+	}
+}
+
+static uint32_t profiler_new_event(const char *name, uint64_t begin) {
+	if(profiler.num_events == profiler.capacity) {
+		if(profiler.capacity == PROFILER_MAX_EVENTS) {
+			if(!profiler.overflow) {
+				log_warn("Too many zones recorded, the rest of the session won't be profiled");
+				profiler.overflow = true;
+			}
+
+			return UINT32_MAX;
+		}
+
+		profiler.capacity = profiler.capacity ? profiler.capacity * 2 : 4096;
+		profiler.events = realloc(profiler.events, profiler.capacity * sizeof(*profiler.events));
+	}
+
+	ProfilerEvent *e = profiler.events + profiler.num_events;
+	e->name = name;
+	e->begin = begin;
+	e->end = 0;
+
+	return profiler.num_events++;
+}
+
+void profiler_begin(const char *name) {
+	if(!profiler.active || SDL_ThreadID() != profiler.main_thread) {
+		return;
+	}
+
+	if(profiler.depth == PROFILER_MAX_DEPTH) {
+		log_fatal("Zone %s is nested too deep", name);
+	}
+
+	ProfilerZone *z = profiler.stack + profiler.depth++;
+	z->name = name;
+	z->begin = SDL_GetPerformanceCounter();
+	z->event = profiler.tracing ? profiler_new_event(name, z->begin) : UINT32_MAX;
+}
+
+void profiler_end(const char *name) {
+	if(!profiler.active || SDL_ThreadID() != profiler.main_thread) {
+		return;
+	}
+
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	if(profiler.depth == 0) {
+		log_fatal("Zone %s ended, but none is open", name);
+	}
+
+	ProfilerZone *z = profiler.stack + --profiler.depth;
+
+	if(z->name != name && strcmp(z->name, name)) {
+		log_fatal("Zone %s ended while %s is open", name, z->name);
+	}
+
+	if(z->event != UINT32_MAX) {
+		profiler.events[z->event].end = now;
+	}
+
+	flightrec_span(FLIGHTREC_ZONE, name, z->begin, now, profiler.depth, 0);
+}
+
+static double profiler_usec(uint64_t t) {
+	return (t - profiler.epoch) * 1e6 / profiler.freq;
+}
+
+static bool profiler_export(const char *vfspath) {
+	SDL_RWops *out = vfs_open(vfspath, VFS_MODE_WRITE);
+
+	if(!out) {
+		log_warn("VFS error: %s", vfs_get_error());
+		return false;
+	}
+
+	SDL_RWprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	uint32_t written = 0;
+
+	for(uint32_t i = 0; i < profiler.num_events; ++i) {
+		ProfilerEvent *e = profiler.events + i;
+
+		if(!e->end) {
+			// still open
+			continue;
+		}
+
+		double ts = profiler_usec(e->begin);
+		double dur = profiler_usec(e->end) - ts;
+
+		SDL_RWprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}\n",
+			written ? "," : "", e->name, ts, dur
+		);
+
+		++written;
+	}
+
+	SDL_RWprintf(out, "]}\n");
+	SDL_RWclose(out);
+
+	char *syspath = vfs_repr(vfspath, true);
+	log_info("Saved %u profiler zones to %s", written, syspath);
+	free(syspath);
+
+	return true;
+}
+
+void profiler_shutdown(void) {
+	if(profiler.tracing) {
+		const char *path = getenv("TAISEI_PROFILER_FILE");
+
+		if(!path || !*path) {
+			path = "storage/profile.json";
+		}
+
+		profiler_export(path);
+	}
+
+	free(profiler.events);
+	memset(&profiler, 0, sizeof(profiler));
+}
+
+#endif // TAISEI_BUILDCONF_PROFILER
@@ -0,0 +1,53 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+/*
+ *  Hierarchical zone profiler.
+ *
+ *  Code is instrumented with nested PROFILE_BEGIN/PROFILE_END pairs. Every zone is timestamped
+ *  when it opens and closes, and the whole recording is written to TAISEI_PROFILER_FILE in the
+ *  Chrome trace event format on shutdown. It can be opened in chrome://tracing or Perfetto.
+ *
+ *  Built only with -Dprofiler=true; otherwise the macros expand to nothing. Zones are tracked
+ *  only if TAISEI_PROFILER=1, or the flight recorder is enabled (it keeps the zones of the last
+ *  few frames). Zones are only recorded on the main thread.
+ *
+ *  Zone names must be string literals (or otherwise outlive the profiler), and must not need
+ *  escaping in JSON.
+ */
+
+#ifdef TAISEI_BUILDCONF_PROFILER
+
+#include <stdbool.h>
+
+void profiler_init(void);
+void profiler_shutdown(void);
+bool profiler_enabled(void);
+
+void profiler_begin(const char *name);
+void profiler_end(const char *name);
+
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END(name) profiler_end(name)
+
+#else
+
+static inline void profiler_init(void) { }
+static inline void profiler_shutdown(void) { }
+
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END(name) ((void)0)
+
+#endif
+
+// brackets a statement or block with a zone; don't jump out of it with return, break or goto
+#define PROFILE_ZONE(name) \
+	for(int _profile_zone_once = (PROFILE_BEGIN(name), 1); _profile_zone_once; PROFILE_END(name), _profile_zone_once = 0)
@@ -15,6 +15,10 @@
 #include "list.h"
 #include "vbo.h"
 #include "stageobjects.h"
+#include "stage.h"
+#include "jobs.h"
+#include "drawbuffer.h"
+#include "glmatrix.h"
 
 static ProjArgs defaults_proj = {
 	.sprite = "proj/",
@@ -170,8 +174,24 @@ Projectile* create_projectile(ProjArgs *args) {
 	return _create_projectile(args);
 }
 
+static bool particle_rule_is_parallel(ProjRule rule) {
+	// the stock motion rules only ever touch the projectile they are given
+	return
+		rule == timeout ||
+		rule == timeout_linear ||
+		rule == timeout_linear_fixangle ||
+		rule == linear ||
+		rule == accelerated ||
+		rule == asymptotic;
+}
+
 Projectile* create_particle(ProjArgs *args) {
 	process_projectile_args(args, &defaults_part);
+
+	if(particle_rule_is_parallel(args->rule)) {
+		args->flags |= PFLAG_PARALLEL;
+	}
+
 	return _create_projectile(args);
 }
 
@@ -348,52 +368,38 @@ void proj_clrtransform_particle(Projectile *p, int t, Color c, ColorTransform *o
 	static_clrtransform_particle(c, out);
 }
 
-typedef enum ProjBlendMode {
-	PBM_NORMAL,
-	PBM_ADD,
-	PBM_SUB,
-} ProjBlendMode;
+static DrawBuffer proj_drawbuffer;
 
-static inline void draw_projectile(Projectile *proj, ProjBlendMode *cur_blend_mode) {
-	ProjBlendMode blend_mode;
+static float proj_spawn_scale(Projectile *proj, int t) {
+	if(t >= 16) {
+		return 1;
+	}
 
-	if(proj->flags & PFLAG_DRAWADD) {
-		blend_mode = PBM_ADD;
-	} else if(proj->flags & PFLAG_DRAWSUB) {
-		blend_mode = PBM_SUB;
-	} else {
-		blend_mode = PBM_NORMAL;
+	if(proj->flags & PFLAG_NOSPAWNZOOM) {
+		return 1;
 	}
 
-	if(blend_mode != *cur_blend_mode) {
-		if(*cur_blend_mode == PBM_SUB) {
-			glBlendEquation(GL_FUNC_ADD);
-		}
+	if(proj->type != EnemyProj && proj->type != FakeProj) {
+		return 1;
+	}
 
-		switch(blend_mode) {
-			case PBM_NORMAL:
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-				break;
+	return 2.0-t/16.0;
+}
 
-			case PBM_ADD:
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-				break;
+static inline DrawBlendMode proj_blend_mode(Projectile *proj) {
+	if(proj->flags & PFLAG_DRAWADD) {
+		return DRAW_BLEND_ADD;
+	} else if(proj->flags & PFLAG_DRAWSUB) {
+		return DRAW_BLEND_SUB;
+	}
 
-			case PBM_SUB:
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-				glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-				break;
-		}
+	return DRAW_BLEND_ALPHA;
+}
 
-		*cur_blend_mode = blend_mode;
-	}
+static void draw_projectile_callback(void *arg) {
+	Projectile *proj = arg;
 
 #ifdef PROJ_DEBUG
-	if(proj->type == PlrProj) {
-		set_debug_info(&proj->debug);
-		log_fatal("Projectile with type PlrProj");
-	}
-
 	static Projectile prev_state;
 	memcpy(&prev_state, proj, sizeof(Projectile));
 
@@ -418,33 +424,94 @@ static inline void draw_projectile(Projectile *proj, ProjBlendMode *cur_blend_mo
 #endif
 }
 
+/*
+ *  Plain sprites are culled against the viewport before they're recorded. This needs the modelview
+ *  matrix on the CPU, and is only done when it's a 2D transform, which is how objects are normally
+ *  drawn on top of the viewport projection. Anything else, like the reflections in stage 1, is
+ *  drawn as is.
+ */
+static float (*proj_cull_matrix(void))[4] {
+	float (*m)[4] = glmatrix_get_modelview();
+
+	if(!m || m[0][2] || m[1][2] || m[2][0] || m[2][1] || m[0][3] || m[1][3] || m[3][3] != 1) {
+		return NULL;
+	}
+
+	return m;
+}
+
+static inline bool proj_sprite_visible(Projectile *proj, float scale, float (*m)[4]) {
+	float x = creal(proj->pos);
+	float y = cimag(proj->pos);
+
+	// m is column-major, see matrix.h
+	float vx = m[0][0] * x + m[1][0] * y + m[3][0];
+	float vy = m[0][1] * x + m[1][1] * y + m[3][1];
+	float mscale = fmaxf(hypotf(m[0][0], m[0][1]), hypotf(m[1][0], m[1][1]));
+
+	// bounding circle, since the sprite can have any rotation
+	float r = 0.5 * hypotf(proj->sprite->w, proj->sprite->h) * scale * mscale;
+
+	return vx + r > 0 && vx - r < VIEWPORT_W && vy + r > 0 && vy - r < VIEWPORT_H;
+}
+
+static inline void record_projectile(Projectile *proj, GLuint shader, float (*cull)[4]) {
+	DrawBlendMode blend_mode = proj_blend_mode(proj);
+
+#ifdef PROJ_DEBUG
+	if(proj->type == PlrProj) {
+		set_debug_info(&proj->debug);
+		log_fatal("Projectile with type PlrProj");
+	}
+#endif
+
+	if(proj->draw_rule != ProjDraw) {
+		// custom draw rules may do anything, so keep them in order
+		drawbuffer_add_callback(&proj_drawbuffer, blend_mode, shader, draw_projectile_callback, proj);
+		return;
+	}
+
+	// the common case: a plain recolored sprite, which we can reorder
+	int t = global.frames - proj->birthtime;
+	float scale = proj_spawn_scale(proj, t);
+
+	if(cull && !proj_sprite_visible(proj, scale, cull)) {
+		return;
+	}
+
+	DrawCommand *cmd = drawbuffer_add_sprite(&proj_drawbuffer, blend_mode, shader, proj->sprite, proj->sprite->tex->gltex);
+	cmd->sprite.x = creal(proj->pos);
+	cmd->sprite.y = cimag(proj->pos);
+	cmd->sprite.angle = proj->angle*180/M_PI+90;
+	cmd->sprite.scale = scale;
+	proj->color_transform_rule(proj, t, proj->color, &cmd->sprite.color);
+}
+
 void draw_projectiles(Projectile *projs, ProjPredicate predicate) {
-	ProjBlendMode blend_mode = PBM_NORMAL;
+	GLuint shader = recolor_get_shader()->prog;
+	float (*cull)[4] = proj_cull_matrix();
 
-	glUseProgram(recolor_get_shader()->prog);
+	glUseProgram(shader);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	if(predicate) {
 		for(Projectile *proj = projs; proj; proj = proj->next) {
 			if(predicate(proj)) {
-				draw_projectile(proj, &blend_mode);
+				record_projectile(proj, shader, cull);
 			}
 		}
 	} else {
 		for(Projectile *proj = projs; proj; proj = proj->next) {
-			draw_projectile(proj, &blend_mode);
+			record_projectile(proj, shader, cull);
 		}
 	}
 
+	drawbuffer_submit(&proj_drawbuffer, NULL);
 	glUseProgram(0);
+}
 
-	if(blend_mode != PBM_NORMAL) {
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-		if(blend_mode == PBM_SUB) {
-			glBlendEquation(GL_FUNC_ADD);
-		}
-	}
+void projectiles_free_drawbuffer(void) {
+	drawbuffer_free(&proj_drawbuffer);
 }
 
 bool projectile_in_viewport(Projectile *proj) {
@@ -556,6 +623,133 @@ void process_projectiles(Projectile **projs, bool collision) {
 	}
 }
 
+/*
+ *  Particles flagged with PFLAG_PARALLEL are updated as jobs (see jobs.h) at the start of
+ *  process_particles(). Their rules must not touch anything but the particle itself, but they may
+ *  use the RNG: each job thread has its own visual random state, so rand_game is never consumed
+ *  from a job. Everything else (other rules, death events, removal from the list) still happens on
+ *  the main thread afterwards, in list order.
+ */
+
+enum {
+	PARTICLE_BATCH_CHUNK = 128,
+	PARTICLE_BATCH_MIN = 512,
+};
+
+static struct {
+	RandomState *rand; // one per job thread
+	int num_threads;
+	Projectile **batch;
+	size_t batch_size;
+	size_t batch_capacity;
+} particle_workers;
+
+static void particle_batch_work(void *arg, size_t begin, size_t end) {
+	int thread = jobs_thread_id();
+	assert(thread >= 0 && thread < particle_workers.num_threads);
+	RandomState *prev_rand = tsrand_switch(particle_workers.rand + thread);
+
+	for(size_t i = begin; i < end; ++i) {
+		Projectile *p = particle_workers.batch[i];
+		int action = p->rule(p, global.frames - p->birthtime);
+
+		if(!projectile_in_viewport(p)) {
+			action = ACTION_DESTROY;
+		}
+
+		p->parallel_action = action;
+	}
+
+	tsrand_switch(prev_rand);
+}
+
+void particle_workers_init(void) {
+	memset(&particle_workers, 0, sizeof(particle_workers));
+
+	if(jobs_num_threads() < 2 || !getenvint("TAISEI_PARALLEL_PARTICLES", 1)) {
+		log_debug("Parallel particle updates disabled");
+		return;
+	}
+
+	particle_workers.num_threads = jobs_num_threads();
+	particle_workers.rand = calloc(particle_workers.num_threads, sizeof(RandomState));
+
+	for(int i = 0; i < particle_workers.num_threads; ++i) {
+		tsrand_init(particle_workers.rand + i, tsrand_p(&global.rand_visual));
+	}
+}
+
+void particle_workers_shutdown(void) {
+	free(particle_workers.rand);
+	free(particle_workers.batch);
+	memset(&particle_workers, 0, sizeof(particle_workers));
+}
+
+static void process_particles_parallel(Projectile *parts) {
+	if(!particle_workers.num_threads || global.headless_logic) {
+		return;
+	}
+
+	particle_workers.batch_size = 0;
+
+	for(Projectile *p = parts; p; p = p->next) {
+		if(!(p->flags & PFLAG_PARALLEL)) {
+			continue;
+		}
+
+		if(particle_workers.batch_size == particle_workers.batch_capacity) {
+			particle_workers.batch_capacity = particle_workers.batch_capacity ? particle_workers.batch_capacity * 2 : 1024;
+			particle_workers.batch = realloc(particle_workers.batch, particle_workers.batch_capacity * sizeof(Projectile*));
+		}
+
+		particle_workers.batch[particle_workers.batch_size++] = p;
+	}
+
+	if(particle_workers.batch_size < PARTICLE_BATCH_MIN) {
+		// not worth waking anyone up, the serial pass will handle these
+		return;
+	}
+
+	for(size_t i = 0; i < particle_workers.batch_size; ++i) {
+		particle_workers.batch[i]->parallel_pending = true;
+	}
+
+	// the main thread takes chunks too, and this returns once all of them are done
+	jobs_parallel_for(particle_workers.batch_size, PARTICLE_BATCH_CHUNK, particle_batch_work, NULL);
+}
+
+void process_particles(Projectile **parts) {
+	process_particles_parallel(*parts);
+
+	// In headless mode nobody is going to see the particles, so drop the ones that can't
+	// possibly affect the game. That's all of them if they have their own RNG stream.
+	bool drop_all = stage_skip_visual_logic();
+
+	stage_visual_logic_begin();
+
+	for(Projectile *p = *parts, *next; p; p = next) {
+		next = p->next;
+
+		bool fatal;
+
+		if(global.headless_logic && (drop_all || (p->flags & PFLAG_PARALLEL))) {
+			fatal = true;
+		} else if(p->parallel_pending) {
+			p->parallel_pending = false;
+			fatal = p->parallel_action == ACTION_DESTROY;
+		} else {
+			int action = p->rule(p, global.frames - p->birthtime);
+			fatal = action == ACTION_DESTROY || !projectile_in_viewport(p);
+		}
+
+		if(fatal) {
+			delete_projectile(parts, p);
+		}
+	}
+
+	stage_visual_logic_end();
+}
+
 int trace_projectile(Projectile *p, ProjCollisionResult *out_col, ProjCollisionType stopflags, int timeofs) {
 	int t;
 
@@ -618,19 +812,7 @@ static inline void apply_common_transforms(Projectile *proj, int t) {
 	glTranslatef(creal(proj->pos), cimag(proj->pos), 0);
 	glRotatef(proj->angle*180/M_PI+90, 0, 0, 1);
 
-	if(t >= 16) {
-		return;
-	}
-
-	if(proj->flags & PFLAG_NOSPAWNZOOM) {
-		return;
-	}
-
-	if(proj->type != EnemyProj && proj->type != FakeProj) {
-		return;
-	}
-
-	float s = 2.0-t/16.0;
+	float s = proj_spawn_scale(proj, t);
 	if(s != 1) {
 		glScalef(s, s, 1);
 	}
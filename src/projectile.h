@@ -58,6 +58,7 @@ typedef enum ProjFlags {
 	PFLAG_GRAZESPAM = (1 << 8),
 	PFLAG_NOREFLECT = (1 << 9),
 	PFLAG_REQUIREDPARTICLE = (1 << 10),
+	PFLAG_PARALLEL = (1 << 11), // rule only touches the projectile itself; see process_particles()
 } ProjFlags;
 
 struct Projectile {
@@ -78,6 +79,8 @@ struct Projectile {
 	int max_viewport_dist;
 	int priority_override;
 	ProjFlags flags;
+	int parallel_action;
+	bool parallel_pending;
 	bool grazed;
 
 #ifdef PROJ_DEBUG
@@ -139,12 +142,14 @@ Projectile* create_particle(ProjArgs *args);
 void delete_projectile(Projectile **dest, Projectile *proj);
 void delete_projectiles(Projectile **dest);
 void draw_projectiles(Projectile *projs, ProjPredicate predicate);
+void projectiles_free_drawbuffer(void);
 
 void calc_projectile_collision(Projectile *p, ProjCollisionResult *out_col);
 void apply_projectile_collision(Projectile **projlist, Projectile *p, ProjCollisionResult *col);
 int trace_projectile(Projectile *p, ProjCollisionResult *out_col, ProjCollisionType stopflags, int timeofs);
 bool projectile_in_viewport(Projectile *proj);
 void process_projectiles(Projectile **projs, bool collision);
+void process_particles(Projectile **parts);
 bool projectile_is_clearable(Projectile *p);
 
 Projectile* spawn_projectile_collision_effect(Projectile *proj);
@@ -179,5 +184,8 @@ void Blast(Projectile *p, int t);
 
 void projectiles_preload(void);
 
+void particle_workers_init(void);
+void particle_workers_shutdown(void);
+
 List* proj_insert_sizeprio(List **dest, List *elem) __attribute__((hot));
 List* proj_insert_colorprio(List **dest, List *elem);
@@ -14,7 +14,8 @@
 #include "global.h"
 #include "random.h"
 
-static RandomState *tsrand_current;
+// thread-local so that job threads can have their own streams, see process_particles
+static _Thread_local RandomState *tsrand_current;
 
 /*
  *  Complementary-multiply-with-carry algorithm
@@ -65,8 +66,10 @@ void tsrand_seed_p(RandomState *rnd, uint32_t seed) {
 	}
 }
 
-void tsrand_switch(RandomState *rnd) {
+RandomState* tsrand_switch(RandomState *rnd) {
+	RandomState *prev = tsrand_current;
 	tsrand_current = rnd;
+	return prev;
 }
 
 void tsrand_init(RandomState *rnd, uint32_t seed) {
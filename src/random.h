@@ -27,7 +27,7 @@ typedef struct RandomState RandomState;
 int tsrand_test(void);
 
 void tsrand_init(RandomState *rnd, uint32_t seed);
-void tsrand_switch(RandomState *rnd);
+RandomState* tsrand_switch(RandomState *rnd); // returns the previous state
 void tsrand_seed_p(RandomState *rnd, uint32_t seed);
 uint32_t tsrand_p(RandomState *rnd);
 
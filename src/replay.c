@@ -16,6 +16,7 @@
 #include <time.h>
 
 #include "global.h"
+#include "stage.h"
 
 static uint8_t replay_magic_header[] = REPLAY_MAGIC_HEADER;
 
@@ -359,6 +360,7 @@ static bool replay_read_header(Replay *rpy, SDL_RWops *file, int64_t filesize, s
 		case REPLAY_STRUCT_VERSION_TS102000_REV0:
 		case REPLAY_STRUCT_VERSION_TS102000_REV1:
 		case REPLAY_STRUCT_VERSION_TS102000_REV2:
+		case REPLAY_STRUCT_VERSION_TS102000_REV3:
 		{
 			if(taisei_version_read(file, &rpy->game_version) != TAISEI_VERSION_SIZE) {
 				log_warn("%s: Failed to read game version", source);
@@ -785,3 +787,60 @@ void replay_play(Replay *rpy, int firstidx) {
 	global.replay_stage = NULL;
 	free_resources(false);
 }
+
+#ifdef DEBUG
+bool replay_verify_headless(Replay *rpy, int firstidx) {
+	static const HeadlessLogicMode modes[] = { HEADLESS_LOGIC_NEVER, HEADLESS_LOGIC_ALWAYS };
+	StageChecksumTrace traces[2] = { 0 };
+
+	HeadlessLogicMode saved_mode = global.headless_mode;
+	int saved_frameskip = global.frameskip;
+
+	// nothing needs to be seen here, so don't bother rendering
+	global.frameskip = INT_MAX;
+
+	for(int i = 0; i < 2; ++i) {
+		Replay copy = { 0 };
+		replay_copy(&copy, rpy, false);
+
+		global.headless_mode = modes[i];
+		stage_trace_checksums(traces + i);
+
+		hrtime_t start_time = time_get();
+		replay_play(&copy, firstidx);
+		hrtime_t elapsed = time_get() - start_time;
+
+		stage_trace_checksums(NULL);
+		replay_destroy(&copy);
+
+		log_info("Pass %i (headless %s): %zu frames in %f seconds",
+			i, modes[i] == HEADLESS_LOGIC_ALWAYS ? "on" : "off", traces[i].num_sums, (double)elapsed
+		);
+	}
+
+	global.headless_mode = saved_mode;
+	global.frameskip = saved_frameskip;
+
+	bool ok = traces[0].num_sums == traces[1].num_sums;
+	size_t num = traces[0].num_sums < traces[1].num_sums ? traces[0].num_sums : traces[1].num_sums;
+
+	for(size_t f = 0; f < num; ++f) {
+		if(traces[0].sums[f] != traces[1].sums[f]) {
+			log_warn("Headless logic diverged at logic frame %zu (%08x != %08x)", f, traces[0].sums[f], traces[1].sums[f]);
+			ok = false;
+			break;
+		}
+	}
+
+	if(ok) {
+		log_info("Headless logic is deterministic over %zu frames", num);
+	} else if(traces[0].num_sums != traces[1].num_sums) {
+		log_warn("Headless logic ran for %zu frames, normal logic for %zu", traces[1].num_sums, traces[0].num_sums);
+	}
+
+	free(traces[0].sums);
+	free(traces[1].sums);
+
+	return ok;
+}
+#endif
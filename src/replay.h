@@ -38,13 +38,16 @@
 
 	// Taisei v1.2 revision 2: adds graze points
 	#define REPLAY_STRUCT_VERSION_TS102000_REV2 8
+
+	// Taisei v1.2 revision 3: same layout; visual-only logic no longer consumes the game RNG (REPLAY_SFLAG_VISUAL_RNG)
+	#define REPLAY_STRUCT_VERSION_TS102000_REV3 9
 /* END supported struct versions */
 
 #define REPLAY_VERSION_COMPRESSION_BIT 0x8000
 #define REPLAY_COMPRESSION_CHUNK_SIZE 4096
 
 // What struct version to use when saving recorded replays
-#define REPLAY_STRUCT_VERSION_WRITE (REPLAY_STRUCT_VERSION_TS102000_REV2 | REPLAY_VERSION_COMPRESSION_BIT)
+#define REPLAY_STRUCT_VERSION_WRITE (REPLAY_STRUCT_VERSION_TS102000_REV3 | REPLAY_VERSION_COMPRESSION_BIT)
 
 #define REPLAY_ALLOC_INITIAL 256
 
@@ -203,6 +206,7 @@ typedef enum ReplayStageFlags {
 	REPLAY_SFLAG_CONTINUES          = (1 << 0), // a continue was used in this stage
 	REPLAY_SFLAG_CHEATS             = (1 << 1), // a cheat was used in this stage
 	REPLAY_SFLAG_CLEAR              = (1 << 2), // this stage was cleared
+	REPLAY_SFLAG_VISUAL_RNG         = (1 << 3), // visual-only logic did not touch the game RNG in this stage
 } ReplayStageFlags;
 
 void replay_init(Replay *rpy);
@@ -226,4 +230,10 @@ void replay_copy(Replay *dst, Replay *src, bool steal_events);
 
 void replay_play(Replay *rpy, int firstidx);
 
+#ifdef DEBUG
+// Plays the replay twice, once with headless logic forced on and once with it off,
+// and compares stage_logic_checksum() frame by frame. Returns true if they match.
+bool replay_verify_headless(Replay *rpy, int firstidx);
+#endif
+
 int replay_find_stage_idx(Replay *rpy, uint8_t stageid);
@@ -9,6 +9,7 @@
 #include "taisei.h"
 
 #include "animation.h"
+#include "spritemap.h"
 #include "texture.h"
 #include "resource.h"
 #include "list.h"
@@ -32,8 +33,13 @@ void* load_animation_begin(const char *filename, unsigned int flags) {
 	strcpy(name, basename);
 
 	Animation *ani = calloc(1, sizeof(Animation));
+	const SpriteMapAnimation *def = NULL;
 
-	if(!parse_keyvalue_file_with_spec(filename, (KVSpec[]){
+	if(!vfs_query(filename).exists && (def = spritemap_get_animation(basename))) {
+		ani->rows = def->rows;
+		ani->cols = def->cols;
+		ani->speed = def->speed;
+	} else if(!parse_keyvalue_file_with_spec(filename, (KVSpec[]){
 		{ "rows",  .out_int = &ani->rows },
 		{ "cols",  .out_int = &ani->cols },
 		{ "speed", .out_int = &ani->speed },
@@ -100,8 +106,8 @@ void unload_animation(void *vani) {
 	free(ani);
 }
 
-Animation *get_ani(const char *name) {
-	return get_resource(RES_ANIM, name, RESF_DEFAULT)->animation;
+Animation* _get_ani(const char *name, const char *caller) {
+	return _get_resource(RES_ANIM, name, RESF_DEFAULT, caller)->animation;
 }
 
 static Sprite* get_animation_frame(Animation *ani, int col, int row) {
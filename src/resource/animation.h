@@ -32,7 +32,8 @@ void* load_animation_begin(const char *filename, unsigned int flags);
 void* load_animation_end(void *opaque, const char *filename, unsigned int flags);
 void unload_animation(void *vani);
 
-Animation *get_ani(const char *name);
+Animation* _get_ani(const char *name, const char *caller);
+#define get_ani(name) _get_ani(name, __func__)
 
 void draw_animation(float x, float y, int col, int row, const char *name);
 void draw_animation_p(float x, float y, int col, int row, Animation *ani);
@@ -11,11 +11,36 @@
 #include "font.h"
 #include "global.h"
 #include "util.h"
-#include "objectpool.h"
-#include "objectpool_util.h"
+#include "list.h"
+#include "vbo.h"
+#include "dynatlas.h"
 
 #define CACHE_EXPIRE_TIME 1000
 
+// how much memory prerendered text may take up, in bytes
+#define CACHE_BUDGET (8 << 20)
+
+// must be a power of two
+#define CACHE_INDEX_MIN_SIZE 256
+
+// number of wrap_text() results kept around
+#define TEXT_LAYOUT_CACHE_SIZE 256
+
+// kerning for pairs of characters below this is kept in a table
+#define KERNING_TABLE_SIZE 128
+#define KERNING_UNKNOWN INT8_MIN
+
+// at quality == 1.0; grows as needed
+#define GLYPH_ATLAS_SIZE 256
+#define GLYPH_ATLAS_MAX_SIZE 4096
+
+// glyphs are looked up in a two-level table covering the BMP, which is all SDL_ttf can render
+#define GLYPH_PAGE_SIZE 256
+#define GLYPH_NUM_PAGES 256
+
+// vertices per draw call when drawing text from the glyph atlas
+#define TEXT_VBO_SIZE 4096
+
 #ifdef DEBUG
 	// #define VERBOSE_CACHE_LOG
 #endif
@@ -27,34 +52,78 @@
 #endif
 
 typedef struct CacheEntry {
-	OBJECT_INTERFACE(struct CacheEntry);
+	LIST_INTERFACE(struct CacheEntry);
 
+	Font *font;
 	SDL_Surface *surf;
-	int width;
-	int height;
+	DynAtlasRegion *region; // NULL if not uploaded, or evicted from the atlas
 	uint32_t ref_time;
-
-	struct {
-		 // to simplify invalidation
-		Hashtable *ht;
-		char *ht_key;
-	} owner;
+	uint32_t hash;
+	size_t size;
+	char text[];
 } CacheEntry;
 
 typedef struct FontRenderer {
-	Texture tex;
-	Sprite sprite;
+	DynAtlas *atlas; // for prerendered text
 	float quality;
-	uint32_t *pixbuf;
+	VBO vbo;
+	Vertex verts[TEXT_VBO_SIZE];
 } FontRenderer;
 
-static ObjectPool *cache_pool;
-static CacheEntry *cache_entries;
+typedef struct Glyph {
+	// metrics; enough to lay out text
+	int16_t advance;
+	int16_t minx;
+	bool measured;
+
+	// only valid if rasterized
+	int16_t x, y, w, h; // area in the atlas, not including the padding; w == 0 for blank glyphs
+	int16_t ox, oy;     // offset of that area from the pen position and the top of the line
+	bool rasterized;
+} Glyph;
+
+typedef struct GlyphAtlas {
+	Texture tex;
+	uint32_t *pixels; // copy of the texture, so that it can be grown without reading it back
+	int shelf_x;
+	int shelf_y;
+	int shelf_h;
+} GlyphAtlas;
+
+typedef struct TextLayout {
+	LIST_INTERFACE(struct TextLayout);
+	Font *font;
+	char *key;
+	char *text;
+} TextLayout;
+
 static FontRenderer font_renderer;
 
+static struct {
+	CacheEntry *head; // most recently used
+	CacheEntry *tail;
+	size_t size;
+	uint32_t num_entries;
+
+	// open addressing with linear probing; never more than half full
+	CacheEntry **index;
+	uint32_t index_size;
+
+	uint32_t (*hashfunc)(uint32_t crc, const char *str);
+} text_cache;
+
+static struct {
+	TextLayout *head; // most recently used
+	TextLayout *tail;
+	int count;
+} layout_cache;
+
 struct Font {
 	TTF_Font *ttf;
-	Hashtable *cache;
+	Hashtable *layouts;
+	GlyphAtlas atlas;
+	Glyph *glyphs[GLYPH_NUM_PAGES];
+	int8_t *kerning;
 };
 
 struct Fonts _fonts;
@@ -83,162 +152,531 @@ static TTF_Font* load_ttf(char *vfspath, int size) {
 	return f;
 }
 
+static void glyph_atlas_upload(GlyphAtlas *atlas) {
+	glBindTexture(GL_TEXTURE_2D, atlas->tex.gltex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas->tex.w, atlas->tex.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas->pixels);
+}
+
+static void glyph_atlas_init(GlyphAtlas *atlas) {
+	int size = GLYPH_ATLAS_SIZE * ftopow2(font_renderer.quality);
+
+	memset(atlas, 0, sizeof(*atlas));
+	atlas->tex.w = size;
+	atlas->tex.h = size;
+	atlas->pixels = calloc(size * size, sizeof(uint32_t));
+
+	glGenTextures(1, &atlas->tex.gltex);
+	glBindTexture(GL_TEXTURE_2D, atlas->tex.gltex);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glyph_atlas_upload(atlas);
+}
+
+static void glyph_atlas_wipe(GlyphAtlas *atlas) {
+	// no need to upload this; every glyph carries its own (blank) padding when it's written
+	memset(atlas->pixels, 0, atlas->tex.w * atlas->tex.h * sizeof(uint32_t));
+	atlas->shelf_x = atlas->shelf_y = atlas->shelf_h = 0;
+}
+
+static void glyph_atlas_free(GlyphAtlas *atlas) {
+	glDeleteTextures(1, &atlas->tex.gltex);
+	free(atlas->pixels);
+}
+
+static int glyph_atlas_max_size(void) {
+	static int max_size;
+
+	if(!max_size) {
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+		if(max_size <= 0 || max_size > GLYPH_ATLAS_MAX_SIZE) {
+			max_size = GLYPH_ATLAS_MAX_SIZE;
+		}
+	}
+
+	return max_size;
+}
+
+static bool glyph_atlas_grow(GlyphAtlas *atlas) {
+	int w = atlas->tex.w;
+	int h = atlas->tex.h;
+	int max_size = glyph_atlas_max_size();
+
+	// grow downwards first: the shelves are full width, so this gives us room for new shelves
+	if(h < w && h * 2 <= max_size) {
+		h *= 2;
+	} else if(w * 2 <= max_size) {
+		w *= 2;
+	} else if(h * 2 <= max_size) {
+		h *= 2;
+	} else {
+		return false;
+	}
+
+	uint32_t *pixels = calloc(w * h, sizeof(uint32_t));
+
+	for(int y = 0; y < atlas->tex.h; ++y) {
+		memcpy(pixels + y * w, atlas->pixels + y * atlas->tex.w, atlas->tex.w * sizeof(uint32_t));
+	}
+
+	free(atlas->pixels);
+	atlas->pixels = pixels;
+	atlas->tex.w = w;
+	atlas->tex.h = h;
+	glyph_atlas_upload(atlas);
+
+	log_debug("Glyph atlas %u grown to %ix%i", atlas->tex.gltex, w, h);
+	return true;
+}
+
+// finds room for a w*h area with one pixel of padding around it
+static bool glyph_atlas_alloc(GlyphAtlas *atlas, int w, int h, int *x, int *y) {
+	int pw = w + 2;
+	int ph = h + 2;
+
+	while(true) {
+		if(atlas->shelf_x + pw > atlas->tex.w) {
+			atlas->shelf_y += atlas->shelf_h;
+			atlas->shelf_x = 0;
+			atlas->shelf_h = 0;
+		}
+
+		if(pw <= atlas->tex.w && atlas->shelf_y + ph <= atlas->tex.h) {
+			break;
+		}
+
+		if(!glyph_atlas_grow(atlas)) {
+			return false;
+		}
+	}
+
+	*x = atlas->shelf_x + 1;
+	*y = atlas->shelf_y + 1;
+	atlas->shelf_x += pw;
+	atlas->shelf_h = max(atlas->shelf_h, ph);
+
+	return true;
+}
+
+static void wipe_glyphs(Font *font) {
+	glyph_atlas_wipe(&font->atlas);
+
+	for(int i = 0; i < GLYPH_NUM_PAGES; ++i) {
+		if(font->glyphs[i]) {
+			for(int j = 0; j < GLYPH_PAGE_SIZE; ++j) {
+				font->glyphs[i][j].rasterized = false;
+			}
+		}
+	}
+}
+
+static bool rasterize_glyph(Font *font, uint32_t ch, Glyph *g) {
+	// renders a line of text with just this glyph in it; blank ones have no surface at all
+	SDL_Surface *surf = TTF_RenderGlyph_Blended(font->ttf, ch, (SDL_Color){255, 255, 255});
+
+	if(!surf) {
+		g->w = 0;
+		g->rasterized = true;
+		return true;
+	}
+
+	// SDL_ttf shifts the line to the right if the first glyph extends past the pen position
+	int origin = min(0, g->minx);
+
+	// trim the blank space around the glyph
+	int x0 = surf->w, y0 = surf->h, x1 = -1, y1 = -1;
+	uint32_t amask = surf->format->Amask;
+
+	for(int y = 0; y < surf->h; ++y) {
+		uint32_t *row = (uint32_t*)((uint8_t*)surf->pixels + y * surf->pitch);
+
+		for(int x = 0; x < surf->w; ++x) {
+			if(row[x] & amask) {
+				x0 = min(x0, x);
+				x1 = max(x1, x);
+				y0 = min(y0, y);
+				y1 = max(y1, y);
+			}
+		}
+	}
+
+	if(x1 < 0) {
+		SDL_FreeSurface(surf);
+		g->w = 0;
+		g->rasterized = true;
+		return true;
+	}
+
+	int w = x1 - x0 + 1;
+	int h = y1 - y0 + 1;
+	int ax, ay;
+
+	if(!glyph_atlas_alloc(&font->atlas, w, h, &ax, &ay)) {
+		SDL_FreeSurface(surf);
+		return false;
+	}
+
+	GlyphAtlas *atlas = &font->atlas;
+
+	for(int y = 0; y < h; ++y) {
+		memcpy(
+			atlas->pixels + (ay + y) * atlas->tex.w + ax,
+			(uint8_t*)surf->pixels + (y0 + y) * surf->pitch + x0 * 4,
+			w * 4
+		);
+	}
+
+	SDL_FreeSurface(surf);
+
+	// upload the padding too, in case the area was used by something else before a wipe
+	int pw = w + 2, ph = h + 2;
+	uint32_t upload[pw * ph];
+
+	for(int y = 0; y < ph; ++y) {
+		memcpy(upload + y * pw, atlas->pixels + (ay - 1 + y) * atlas->tex.w + ax - 1, pw * 4);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, atlas->tex.gltex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, ax - 1, ay - 1, pw, ph, GL_RGBA, GL_UNSIGNED_BYTE, upload);
+
+	g->x = ax;
+	g->y = ay;
+	g->w = w;
+	g->h = h;
+	g->ox = origin + x0;
+	g->oy = y0;
+	g->rasterized = true;
+
+	return true;
+}
+
+static inline uint32_t glyph_index(uint32_t ch) {
+	return ch < GLYPH_PAGE_SIZE * GLYPH_NUM_PAGES ? ch : 0xFFFD;
+}
+
+// never fails; glyphs the font doesn't have get zero metrics
+static Glyph* get_glyph_metrics(Font *font, uint32_t ch) {
+	ch = glyph_index(ch);
+	Glyph **page = font->glyphs + ch / GLYPH_PAGE_SIZE;
+
+	if(!*page) {
+		*page = calloc(GLYPH_PAGE_SIZE, sizeof(Glyph));
+	}
+
+	Glyph *g = *page + ch % GLYPH_PAGE_SIZE;
+
+	if(!g->measured) {
+		int minx, maxx, miny, maxy, advance;
+
+		if(TTF_GlyphMetrics(font->ttf, ch, &minx, &maxx, &miny, &maxy, &advance) < 0) {
+			log_warn("TTF_GlyphMetrics() failed for U+%04X: %s", ch, TTF_GetError());
+			minx = advance = 0;
+		}
+
+		g->advance = advance;
+		g->minx = minx;
+		g->measured = true;
+	}
+
+	return g;
+}
+
+// returns NULL if the atlas is full
+static Glyph* get_glyph(Font *font, uint32_t ch) {
+	Glyph *g = get_glyph_metrics(font, ch);
+
+	if(!g->rasterized && !rasterize_glyph(font, glyph_index(ch), g)) {
+		return NULL;
+	}
+
+	return g;
+}
+
+static int get_kerning(Font *font, uint32_t prev, uint32_t ch) {
+#if SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) >= SDL_VERSIONNUM(2, 0, 14)
+	if(!prev) {
+		return 0;
+	}
+
+	prev = glyph_index(prev);
+	ch = glyph_index(ch);
+
+	if(prev >= KERNING_TABLE_SIZE || ch >= KERNING_TABLE_SIZE) {
+		return TTF_GetFontKerningSizeGlyphs(font->ttf, prev, ch);
+	}
+
+	if(!font->kerning) {
+		font->kerning = malloc(KERNING_TABLE_SIZE * KERNING_TABLE_SIZE);
+		memset(font->kerning, KERNING_UNKNOWN, KERNING_TABLE_SIZE * KERNING_TABLE_SIZE);
+	}
+
+	int8_t *k = font->kerning + prev * KERNING_TABLE_SIZE + ch;
+
+	if(*k == KERNING_UNKNOWN) {
+		*k = clamp(TTF_GetFontKerningSizeGlyphs(font->ttf, prev, ch), KERNING_UNKNOWN + 1, INT8_MAX);
+	}
+
+	return *k;
+#else
+	return 0;
+#endif
+}
+
+// width of the text in font pixels, i.e. not scaled by the text quality
+// prev is the character that precedes the text, if any; the last character is written back to it
+static int measure_text(Font *font, const char *text, uint32_t *prev) {
+	uint32_t ch, last = prev ? *prev : 0;
+	int width = 0;
+
+	for(const char *s = text; (ch = utf8_getch(&s));) {
+		width += get_kerning(font, last, ch) + get_glyph_metrics(font, ch)->advance;
+		last = ch;
+	}
+
+	if(prev) {
+		*prev = last;
+	}
+
+	return width;
+}
+
+static inline int text_units(int font_pixels) {
+	return font_pixels / font_renderer.quality;
+}
+
 static Font* load_font(char *vfspath, int size) {
 	TTF_Font *ttf = load_ttf(vfspath, size);
 
 	Font *font = calloc(1, sizeof(Font));
 	font->ttf = ttf;
-	font->cache = hashtable_new_stringkeys(2048);
+	font->layouts = hashtable_new_stringkeys(TEXT_LAYOUT_CACHE_SIZE);
+	glyph_atlas_init(&font->atlas);
 
 	return font;
 }
 
-static void free_cache_entry(CacheEntry *e) {
-	if(!e) {
-		return;
+static uint32_t cache_hash(Font *font, const char *text) {
+	// the font pointer is mixed in, so that equal strings in different fonts don't all probe the same slots
+	return text_cache.hashfunc(0, text) ^ (uint32_t)((uintptr_t)font >> 4) * 2654435761u;
+}
+
+static uint32_t cache_index_find(Font *font, const char *text, uint32_t hash) {
+	uint32_t mask = text_cache.index_size - 1;
+	uint32_t i = hash & mask;
+
+	for(CacheEntry *e; (e = text_cache.index[i]); i = (i + 1) & mask) {
+		if(e->hash == hash && e->font == font && !strcmp(e->text, text)) {
+			break;
+		}
 	}
 
-	if(e->surf) {
-		SDL_FreeSurface(e->surf);
+	return i;
+}
+
+static void cache_index_insert(CacheEntry *e) {
+	uint32_t mask = text_cache.index_size - 1;
+	uint32_t i = e->hash & mask;
+
+	while(text_cache.index[i]) {
+		i = (i + 1) & mask;
 	}
 
-	CACHELOG("Wiping cache entry %p [%s]", (void*)e, e->owner.ht_key);
+	text_cache.index[i] = e;
+}
+
+static void cache_index_resize(uint32_t size) {
+	free(text_cache.index);
+	text_cache.index = calloc(size, sizeof(CacheEntry*));
+	text_cache.index_size = size;
 
-	free(e->owner.ht_key);
-	list_unlink(&cache_entries, e);
-	objpool_release(cache_pool, (ObjectInterface*)e);
+	for(CacheEntry *e = text_cache.head; e; e = e->next) {
+		cache_index_insert(e);
+	}
 }
 
-static CacheEntry* get_cache_entry(Font *font, const char *text) {
-	CacheEntry *e = hashtable_get_unsafe(font->cache, (void*)text);
+static void cache_index_remove(CacheEntry *e) {
+	uint32_t mask = text_cache.index_size - 1;
+	uint32_t i = e->hash & mask;
 
-	if(!e) {
-		if(objpool_is_full(cache_pool)) {
-			CacheEntry *oldest = cache_entries;
+	while(text_cache.index[i] != e) {
+		i = (i + 1) & mask;
+	}
 
-			for(CacheEntry *e = cache_entries->next; e; e = e->next) {
-				if(e->ref_time < oldest->ref_time) {
-					oldest = e;
-				}
-			}
+	text_cache.index[i] = NULL;
+
+	// shift back the entries after the hole that wouldn't be found anymore, so that we don't need tombstones
+	for(uint32_t j = (i + 1) & mask; text_cache.index[j]; j = (j + 1) & mask) {
+		uint32_t home = text_cache.index[j]->hash & mask;
 
-			hashtable_unset_string(oldest->owner.ht, oldest->owner.ht_key);
-			free_cache_entry(oldest);
+		// is home cyclically outside of (i, j]?
+		if(i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+			text_cache.index[i] = text_cache.index[j];
+			text_cache.index[j] = NULL;
+			i = j;
 		}
+	}
+}
+
+static void cache_lru_unlink(CacheEntry *e) {
+	if(e == text_cache.tail) {
+		text_cache.tail = e->prev;
+	}
+
+	list_unlink(&text_cache.head, e);
+}
 
-		e = (CacheEntry*)objpool_acquire(cache_pool);
-		list_push(&cache_entries, e);
-		hashtable_set_string(font->cache, text, e);
-		e->owner.ht = font->cache;
-		e->owner.ht_key = strdup(text);
+static void cache_lru_push(CacheEntry *e) {
+	list_push(&text_cache.head, e);
 
-		CACHELOG("New entry for text: [%s]", text);
+	if(!text_cache.tail) {
+		text_cache.tail = e;
 	}
+}
 
-	e->ref_time = SDL_GetTicks();
-	return e;
+static void free_cache_entry(CacheEntry *e) {
+	CACHELOG("Wiping cache entry %p [%s]", (void*)e, e->text);
+
+	cache_index_remove(e);
+	cache_lru_unlink(e);
+	text_cache.size -= e->size;
+	--text_cache.num_entries;
+
+	if(e->region) {
+		dynatlas_release(e->region);
+	}
+
+	SDL_FreeSurface(e->surf);
+	free(e);
 }
 
-void update_font_cache(void) {
-	uint32_t now = SDL_GetTicks();
+static CacheEntry* get_cache_entry(Font *font, const char *text) {
+	if(!text_cache.index) {
+		return NULL;
+	}
 
-	CacheEntry *next;
-	for(CacheEntry *e = cache_entries; e; e = next) {
-		next = e->next;
+	uint32_t hash = cache_hash(font, text);
+	CacheEntry *e = text_cache.index[cache_index_find(font, text, hash)];
 
-		if(now - e->ref_time > CACHE_EXPIRE_TIME) {
-			hashtable_unset(e->owner.ht, e->owner.ht_key);
-			free_cache_entry(e);
+	if(e) {
+		if(e != text_cache.head) {
+			cache_lru_unlink(e);
+			cache_lru_push(e);
 		}
+
+		e->ref_time = SDL_GetTicks();
 	}
+
+	return e;
 }
 
-static void fontrenderer_init(float quality) {
-	font_renderer.quality = quality = sanitize_scale(quality);
+static CacheEntry* add_cache_entry(Font *font, const char *text, SDL_Surface *surf) {
+	size_t len = strlen(text);
+	size_t size = sizeof(CacheEntry) + len + 1 + surf->pitch * surf->h;
 
-	float r = ftopow2(quality);
-	int w = FONTREN_MAXW * r;
-	int h = FONTREN_MAXH * r;
+	// the new entry may go over the budget by itself; everything else gets evicted in that case
+	while(text_cache.tail && text_cache.size + size > CACHE_BUDGET) {
+		free_cache_entry(text_cache.tail);
+	}
 
-	font_renderer.tex.w = w;
-	font_renderer.tex.h = h;
-	font_renderer.sprite.tex = &font_renderer.tex;
-	font_renderer.pixbuf = calloc(w, h);
+	if((text_cache.num_entries + 1) * 2 > text_cache.index_size) {
+		cache_index_resize(max(CACHE_INDEX_MIN_SIZE, text_cache.index_size * 2));
+	}
 
-	glGenTextures(1, &font_renderer.tex.gltex);
-	glBindTexture(GL_TEXTURE_2D, font_renderer.tex.gltex);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	CacheEntry *e = malloc(sizeof(CacheEntry) + len + 1);
+	memcpy(e->text, text, len + 1);
+	e->font = font;
+	e->surf = surf;
+	e->region = NULL;
+	e->hash = cache_hash(font, text);
+	e->size = size;
+	e->ref_time = SDL_GetTicks();
 
-	log_debug("q=%f, w=%i, h=%i", font_renderer.quality, w, h);
-}
+	cache_lru_push(e);
+	cache_index_insert(e);
+	text_cache.size += size;
+	++text_cache.num_entries;
 
-static void fontrenderer_free(void) {
-	glDeleteTextures(1, &font_renderer.tex.gltex);
-	free(font_renderer.pixbuf);
+	CACHELOG("New entry for text: [%s]", text);
+	return e;
 }
 
-static void fontrenderer_upload(SDL_Surface *surf) {
-	assert(surf != NULL);
+void update_font_cache(void) {
+	uint32_t now = SDL_GetTicks();
 
-	glBindTexture(GL_TEXTURE_2D, font_renderer.tex.gltex);
+	// the least recently used entries are at the tail, so everything that expired is there too
+	while(text_cache.tail && now - text_cache.tail->ref_time > CACHE_EXPIRE_TIME) {
+		free_cache_entry(text_cache.tail);
+	}
+}
 
-	// the written texture is zero padded to avoid bits of previously drawn text bleeding in
-	int winw = surf->w+1;
-	int winh = surf->h+1;
+static void fontrenderer_init(float quality) {
+	font_renderer.quality = quality = sanitize_scale(quality);
 
-	uint32_t *pixels = font_renderer.pixbuf;
+	int size = FONTREN_MAXW * ftopow2(quality);
+	font_renderer.atlas = dynatlas_new("Text atlas", size, 2);
 
-	for(int y = 0; y < surf->h; y++) {
-		memcpy(pixels+y*winw, ((uint8_t*)surf->pixels)+y*surf->pitch, surf->w*4);
-		pixels[y*winw+surf->w]=0;
-	}
+	init_vbo(&font_renderer.vbo, TEXT_VBO_SIZE);
 
-	memset(pixels+(winh-1)*winw, 0, winw*4);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, winw, winh, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	log_debug("q=%f, atlas=%i", font_renderer.quality, size);
+}
 
-	font_renderer.sprite.tex_area.w = surf->w;
-	font_renderer.sprite.tex_area.h = surf->h;
-	font_renderer.sprite.w = font_renderer.sprite.tex_area.w / font_renderer.quality;
-	font_renderer.sprite.h = font_renderer.sprite.tex_area.h / font_renderer.quality;
+static void fontrenderer_free(void) {
+	dynatlas_log_stats(font_renderer.atlas);
+	dynatlas_free(font_renderer.atlas);
+	delete_vbo(&font_renderer.vbo);
 }
 
-static SDL_Surface* fontrender_render(const char *text, Font *font) {
+static CacheEntry* fontrender_render(const char *text, Font *font) {
 	CacheEntry *e = get_cache_entry(font, text);
-	SDL_Surface *surf = e->surf;
 
-	if(surf) {
-		return surf;
+	if(e) {
+		return e;
 	}
 
 	CACHELOG("Rendering text: [%s]", text);
-	surf = e->surf = TTF_RenderUTF8_Blended(font->ttf, text, (SDL_Color){255, 255, 255});
+	SDL_Surface *surf = TTF_RenderUTF8_Blended(font->ttf, text, (SDL_Color){255, 255, 255});
 
 	if(!surf) {
 		log_fatal("TTF_RenderUTF8_Blended() failed: %s", TTF_GetError());
 	}
 
-	if(surf->w > font_renderer.tex.w || surf->h > font_renderer.tex.h) {
-		log_fatal(
-			"Text (%s %dx%d) is too big for the internal buffer (%dx%d).",
-			text,
-			surf->w,
-			surf->h,
-			font_renderer.tex.w,
-			font_renderer.tex.h
-		);
+	return add_cache_entry(font, text, surf);
+}
+
+static void fontrender_region_evicted(DynAtlasRegion *region, void *userdata) {
+	CacheEntry *e = userdata;
+	assert(e->region == region);
+	e->region = NULL;
+}
+
+// the sprite is valid until the next call; it may be evicted from the atlas after that
+static void fontrender_sprite(const char *text, Font *font, Sprite *out_spr) {
+	CacheEntry *e = fontrender_render(text, font);
+
+	if(e->region) {
+		dynatlas_touch(e->region);
+	} else {
+		e->region = dynatlas_alloc(font_renderer.atlas, e->surf->w, e->surf->h, fontrender_region_evicted, e);
+
+		if(!e->region) {
+			log_fatal("Text (%s %dx%d) is too big for the text atlas.", text, e->surf->w, e->surf->h);
+		}
+
+		dynatlas_upload(e->region, e->surf);
 	}
 
-	return surf;
+	*out_spr = e->region->sprite;
+	out_spr->w /= font_renderer.quality;
+	out_spr->h /= font_renderer.quality;
 }
 
 void init_fonts(void) {
 	TTF_Init();
 	memset(&font_renderer, 0, sizeof(font_renderer));
-	cache_pool = OBJPOOL_ALLOC(CacheEntry, 512);
+	memset(&text_cache, 0, sizeof(text_cache));
+	text_cache.hashfunc = SDL_HasSSE42() ? crc32str_sse42 : crc32str;
 }
 
 void uninit_fonts(void) {
@@ -270,49 +708,77 @@ void reload_fonts(float quality) {
 	}
 }
 
+static void free_text_layout(TextLayout *l) {
+	if(l == layout_cache.tail) {
+		layout_cache.tail = l->prev;
+	}
+
+	list_unlink(&layout_cache.head, l);
+	--layout_cache.count;
+
+	free(l->key);
+	free(l->text);
+	free(l);
+}
+
 static void free_font(Font *font) {
-	CacheEntry *e;
+	TextLayout *l;
 	TTF_CloseFont(font->ttf);
+	glyph_atlas_free(&font->atlas);
+
+	for(CacheEntry *e = text_cache.head, *next; e; e = next) {
+		next = e->next;
+
+		if(e->font == font) {
+			free_cache_entry(e);
+		}
+	}
+
+	for(HashtableIterator *i = hashtable_iter(font->layouts); hashtable_iter_next(i, 0, (void**)&l);) {
+		free_text_layout(l);
+	}
 
-	for(HashtableIterator *i = hashtable_iter(font->cache); hashtable_iter_next(i, 0, (void**)&e);) {
-		free_cache_entry(e);
+	for(int i = 0; i < GLYPH_NUM_PAGES; ++i) {
+		free(font->glyphs[i]);
 	}
 
-	hashtable_free(font->cache);
+	hashtable_free(font->layouts);
+	free(font->kerning);
 	free(font);
 }
 
 void free_fonts(void) {
-	fontrenderer_free();
-
 	Font **last = &_fonts.first + (sizeof(_fonts)/sizeof(Font*) - 1);
 	for(Font **font = &_fonts.first; font <= last; ++font) {
 		free_font(*font);
 	}
+
+	fontrenderer_free();
+
+	assert(text_cache.num_entries == 0);
+	free(text_cache.index);
+	text_cache.index = NULL;
+	text_cache.index_size = 0;
 }
 
-static void draw_text_line(Alignment align, float x, float y, const char *text, Font *font) {
+// moves (x, y) from the point the text is aligned to, to the center of a w*h box of it
+static void align_text_line(Alignment align, float *x, float *y, int w, int h) {
 	float m = 1.0 / font_renderer.quality;
 	bool adjust = !(align & AL_Flag_NoAdjust);
 	align &= 0xf;
 
-	fontrenderer_upload(fontrender_render(text, font));
-
 	// XXX: all of these hacks are probably broken
 
-	int w = font_renderer.sprite.tex_area.w;
-	int h = font_renderer.sprite.tex_area.h;
-
 	if(adjust) {
 		switch(align) {
 			case AL_Center:
 				break;
 			// w/2 is integer division and must be done first
 			case AL_Left:
-				x += m*(w/2);
+				*x += m*(w/2);
 				break;
 			case AL_Right:
-				x -= m*(w/2);
+				*x -= m*(w/2);
 				break;
 			default:
 				log_fatal("Invalid alignment %x", align);
@@ -321,31 +787,137 @@ static void draw_text_line(Alignment align, float x, float y, const char *text,
 		// if textures are odd pixeled, align them for ideal sharpness.
 
 		if(w&1) {
-			x += 0.5;
+			*x += 0.5;
 		}
 
 		if(h&1) {
-			y += 0.5;
+			*y += 0.5;
 		}
 	} else {
 		switch(align) {
 			case AL_Center:
 				break;
 			case AL_Left:
-				x += m*(w/2.0);
+				*x += m*(w/2.0);
 				break;
 			case AL_Right:
-				x -= m*(w/2.0);
+				*x -= m*(w/2.0);
 				break;
 			default:
 				log_fatal("Invalid alignment %x", align);
 		}
 	}
+}
 
-	draw_sprite_unaligned_p(x, y, &font_renderer.sprite);
+static void draw_text_line_prerendered(Alignment align, float x, float y, const char *text, Font *font) {
+	Sprite spr;
+	fontrender_sprite(text, font, &spr);
+	align_text_line(align, &x, &y, spr.tex_area.w, spr.tex_area.h);
+	draw_sprite_unaligned_p(x, y, &spr);
 }
 
-void draw_text(Alignment align, float x, float y, const char *text, Font *font) {
+// makes sure every glyph of the line is in the atlas; returns the width of the line
+static int cache_text_line(const char *text, Font *font) {
+	for(int attempt = 0;; ++attempt) {
+		uint32_t ch, prev = 0;
+		int width = 0;
+		bool full = false;
+
+		for(const char *s = text; (ch = utf8_getch(&s));) {
+			Glyph *g = get_glyph(font, ch);
+
+			if(!g) {
+				full = true;
+				break;
+			}
+
+			width += get_kerning(font, prev, ch) + g->advance;
+			prev = ch;
+		}
+
+		if(!full) {
+			return width;
+		}
+
+		if(attempt) {
+			log_fatal("Text is too big for the glyph atlas: %s", text);
+		}
+
+		// start over with only what this line needs
+		log_debug("Glyph atlas %u is full, wiping it", font->atlas.tex.gltex);
+		wipe_glyphs(font);
+	}
+}
+
+static void flush_text_verts(int count) {
+	if(count) {
+		vbo_stream_verts(&font_renderer.vbo, font_renderer.verts, count);
+		glDrawArrays(GL_QUADS, 0, count);
+	}
+}
+
+static void draw_text_line(Alignment align, float x, float y, const char *text, Font *font) {
+	int w = cache_text_line(text, font);
+	int h = TTF_FontHeight(font->ttf);
+
+	if(w <= 0) {
+		return;
+	}
+
+	align_text_line(align, &x, &y, w, h);
+
+	GlyphAtlas *atlas = &font->atlas;
+	float m = 1.0 / font_renderer.quality;
+	float tw = atlas->tex.w;
+	float th = atlas->tex.h;
+
+	glBindTexture(GL_TEXTURE_2D, atlas->tex.gltex);
+	glPushMatrix();
+	glTranslatef(x - m * w * 0.5, y - m * h * 0.5, 0);
+	glScalef(m, m, 1);
+	vbo_bind(&font_renderer.vbo);
+
+	Vertex *v = font_renderer.verts;
+	int count = 0;
+	int pen = 0;
+	uint32_t ch, prev = 0;
+
+	for(const char *s = text; (ch = utf8_getch(&s));) {
+		Glyph *g = get_glyph(font, ch);
+		assert(g != NULL);
+
+		pen += get_kerning(font, prev, ch);
+		prev = ch;
+
+		if(g->w) {
+			if(count + 4 > TEXT_VBO_SIZE) {
+				flush_text_verts(count);
+				count = 0;
+			}
+
+			float x0 = pen + g->ox, x1 = x0 + g->w;
+			float y0 = g->oy, y1 = y0 + g->h;
+			float s0 = g->x / tw, s1 = (g->x + g->w) / tw;
+			float t0 = g->y / th, t1 = (g->y + g->h) / th;
+
+			// the normal holds the position within the line, for shaders that need it (e.g. hud_text)
+			v[count++] = (Vertex){ { x0, y0, 0 }, { x0 / w, y0 / h, 1 }, s0, t0 };
+			v[count++] = (Vertex){ { x0, y1, 0 }, { x0 / w, y1 / h, 1 }, s0, t1 };
+			v[count++] = (Vertex){ { x1, y1, 0 }, { x1 / w, y1 / h, 1 }, s1, t1 };
+			v[count++] = (Vertex){ { x1, y0, 0 }, { x1 / w, y0 / h, 1 }, s1, t0 };
+		}
+
+		pen += g->advance;
+	}
+
+	flush_text_verts(count);
+	vbo_bind(&_vbo);
+	glPopMatrix();
+}
+
+typedef void (*DrawTextLineFunc)(Alignment align, float x, float y, const char *text, Font *font);
+
+static void draw_text_lines(Alignment align, float x, float y, const char *text, Font *font, DrawTextLineFunc draw_line) {
 	assert(text != NULL);
 
 	if(!*text) {
@@ -357,17 +929,24 @@ void draw_text(Alignment align, float x, float y, const char *text, Font *font)
 	strcpy(buf, text);
 
 	if((nl = strchr(buf, '\n')) != NULL && strlen(nl) > 1) {
-		draw_text(align, x, y + 20, nl+1, font);
+		draw_text_lines(align, x, y + 20, nl+1, font, draw_line);
 		*nl = '\0';
 	}
 
-	draw_text_line(align, x, y, buf, font);
+	draw_line(align, x, y, buf, font);
 	free(buf);
 }
 
+void draw_text(Alignment align, float x, float y, const char *text, Font *font) {
+	draw_text_lines(align, x, y, text, font, draw_text_line);
+}
+
+void draw_text_prerendered(Alignment align, float x, float y, const char *text, Font *font) {
+	draw_text_lines(align, x, y, text, font, draw_text_line_prerendered);
+}
+
 void render_text(const char *text, Font *font, Sprite *out_spr) {
-	fontrenderer_upload(fontrender_render(text, font));
-	memcpy(out_spr, &font_renderer.sprite, sizeof(Sprite));
+	fontrender_sprite(text, font, out_spr);
 }
 
 void draw_text_auto_wrapped(Alignment align, float x, float y, const char *text, int width, Font *font) {
@@ -376,40 +955,17 @@ void draw_text_auto_wrapped(Alignment align, float x, float y, const char *text,
 	draw_text(align, x, y, buf, font);
 }
 
-static void string_dimensions(char *s, Font *font, int *w, int *h) {
-	CacheEntry *e = get_cache_entry(font, s);
-
-	if(e->width <= 0 || e->height <= 0) {
-		TTF_SizeUTF8(font->ttf, s, &e->width, &e->height);
-		CACHELOG("Got size %ix%i for text: [%s]", e->width, e->height, s);
-	}
-
-	if(w) {
-		*w = e->width;
-	}
-
-	if(h) {
-		*h = e->height;
-	}
-}
-
 int stringwidth(char *s, Font *font) {
-	int w;
-	string_dimensions(s, font, &w, NULL);
-	return w / font_renderer.quality;
+	return text_units(measure_text(font, s, NULL));
 }
 
 int stringheight(char *s, Font *font) {
-	int h;
-	string_dimensions(s, font, NULL, &h);
-	return h / font_renderer.quality;
+	// there's no multi-line measurement; this is what TTF_SizeUTF8 would say
+	return TTF_FontHeight(font->ttf) / font_renderer.quality;
 }
 
 int charwidth(char c, Font *font) {
-	char s[2];
-	s[0] = c;
-	s[1] = 0;
-	return stringwidth(s, font);
+	return text_units(get_glyph_metrics(font, (uint8_t)c)->advance);
 }
 
 int font_line_spacing(Font *font) {
@@ -417,75 +973,160 @@ int font_line_spacing(Font *font) {
 }
 
 void shorten_text_up_to_width(char *s, float width, Font *font) {
-	while(stringwidth(s, font) > width) {
-		int l = strlen(s);
+	if(stringwidth(s, font) <= width) {
+		return;
+	}
+
+	// find the longest prefix that still fits with an ellipsis after it
+	size_t len = strlen(s);
+	int dots_width = measure_text(font, "...", NULL);
+	int prefix_width = 0;
+	uint32_t ch, prev = 0;
+	ptrdiff_t best = -1;
+
+	for(const char *p = s;;) {
+		ptrdiff_t prefix_len = p - s;
 
-		if(l <= 1) {
-			return;
+		if((size_t)prefix_len + 3 < len && text_units(prefix_width + get_kerning(font, prev, '.') + dots_width) <= width) {
+			best = prefix_len;
 		}
 
-		--l;
-		s[l] = 0;
+		if(!(ch = utf8_getch(&p))) {
+			break;
+		}
+
+		prefix_width += get_kerning(font, prev, ch) + get_glyph_metrics(font, ch)->advance;
+		prev = ch;
+	}
+
+	if(best >= 0) {
+		strcpy(s + best, "...");
+		return;
+	}
+
+	// not even the ellipsis fits; use as many dots as the string has room for
+	strlcpy(s, "...", min(len, 3) + 1);
+
+	while(stringwidth(s, font) > width && strlen(s) > 1) {
+		s[strlen(s) - 1] = 0;
+	}
+}
+
+static TextLayout* get_text_layout(Font *font, const char *key) {
+	TextLayout *l = hashtable_get_string(font->layouts, key);
 
-		for(int i = 0; i < min(3, l); ++i) {
-			s[l - i - 1] = '.';
+	if(l && l != layout_cache.head) {
+		if(l == layout_cache.tail) {
+			layout_cache.tail = l->prev;
 		}
+
+		list_unlink(&layout_cache.head, l);
+		list_push(&layout_cache.head, l);
 	}
+
+	return l;
 }
 
-void wrap_text(char *buf, size_t bufsize, const char *src, int width, Font *font) {
-	assert(buf != NULL);
-	assert(src != NULL);
-	assert(font != NULL);
-	assert(bufsize > strlen(src) + 1);
-	assert(width > 0);
+static void add_text_layout(Font *font, const char *key, const char *text) {
+	if(layout_cache.count >= TEXT_LAYOUT_CACHE_SIZE) {
+		TextLayout *oldest = layout_cache.tail;
+		hashtable_unset_string(oldest->font->layouts, oldest->key);
+		free_text_layout(oldest);
+	}
+
+	TextLayout *l = calloc(1, sizeof(TextLayout));
+	l->font = font;
+	l->key = strdup(key);
+	l->text = strdup(text);
 
+	list_push(&layout_cache.head, l);
+	++layout_cache.count;
+
+	if(!layout_cache.tail) {
+		layout_cache.tail = l;
+	}
+
+	hashtable_set_string(font->layouts, key, l);
+}
+
+static size_t append_text(char *buf, size_t bufsize, size_t len, const char *text) {
+	if(len < bufsize) {
+		len += strlcpy(buf + len, text, bufsize - len);
+	}
+
+	return min(len, bufsize - 1);
+}
+
+static void wrap_text_uncached(char *buf, size_t bufsize, const char *src, int width, Font *font) {
 	char src_copy[strlen(src) + 1];
 	char *sptr = src_copy;
 	char *next = NULL;
-	char *curline = buf;
+	size_t len = 0;
+
+	// the current line so far, in font pixels
+	int linewidth = 0;
+	uint32_t linelast = 0;
+
+	int spacewidth = get_glyph_metrics(font, ' ')->advance;
 
 	strcpy(src_copy, src);
 	*buf = 0;
 
 	while((next = strtok_r(NULL, " \t\n", &sptr))) {
-		int curwidth;
-
 		if(!*next) {
 			continue;
 		}
 
-		if(*curline) {
-			curwidth = stringwidth(curline, font);
-		} else {
-			curwidth = 0;
-		}
-
-		char tmpbuf[strlen(curline) + strlen(next) + 2];
-		strcpy(tmpbuf, curline);
-		strcat(tmpbuf, " ");
-		strcat(tmpbuf, next);
+		uint32_t wordfirst = utf8_getch(&(const char*){ next });
+		uint32_t wordlast = 0;
+		int wordwidth = measure_text(font, next, &wordlast);
+		int totalwidth = wordwidth;
 
-		int totalwidth = stringwidth(tmpbuf, font);
+		if(linelast) {
+			totalwidth += linewidth + get_kerning(font, linelast, ' ') + spacewidth + get_kerning(font, ' ', wordfirst);
+		}
 
-		if(totalwidth > width) {
-			if(curwidth == 0) {
+		if(text_units(totalwidth) > width) {
+			if(!linelast) {
 				log_fatal(
 					"Single word '%s' won't fit on one line. "
 					"Word width: %i, max width: %i, source string: %s",
-					next, stringwidth(next, font), width, src
+					next, text_units(wordwidth), width, src
 				);
 			}
 
-			strlcat(buf, "\n", bufsize);
-			curline = strchr(curline, 0);
+			len = append_text(buf, bufsize, len, "\n");
+			linewidth = wordwidth;
 		} else {
-			if(*curline) {
-				strlcat(buf, " ", bufsize);
+			if(linelast) {
+				len = append_text(buf, bufsize, len, " ");
 			}
 
+			linewidth = totalwidth;
 		}
 
-		strlcat(buf, next, bufsize);
+		linelast = wordlast;
+		len = append_text(buf, bufsize, len, next);
+	}
+}
+
+void wrap_text(char *buf, size_t bufsize, const char *src, int width, Font *font) {
+	assert(buf != NULL);
+	assert(src != NULL);
+	assert(font != NULL);
+	assert(bufsize > strlen(src) + 1);
+	assert(width > 0);
+
+	char key[strlen(src) + 16];
+	snprintf(key, sizeof(key), "%i:%s", width, src);
+
+	TextLayout *l = get_text_layout(font, key);
+
+	if(l) {
+		strlcpy(buf, l->text, bufsize);
+		return;
 	}
+
+	wrap_text_uncached(buf, bufsize, src, width, font);
+	add_text_layout(font, key, buf);
 }
@@ -24,17 +24,23 @@ enum {
 	AL_Flag_NoAdjust = 0x10,
 };
 
-// Size of the buffer used by the font renderer at quality == 1.0.
-// No text larger than this can be drawn.
+// Size of the atlas pages for prerendered text at quality == 1.0.
+// No prerendered text larger than this can be drawn.
 enum {
 	FONTREN_MAXW = 1024,    // must be a power of two that is >= SCREEN_W
-	FONTREN_MAXH = 64,      // must be a power of two that is > largest font size
 };
 
 typedef struct Font Font;
 
+// draws text from a per-font atlas of glyphs, rasterized once
 void draw_text(Alignment align, float x, float y, const char *text, Font *font);
+
+// draws text from a single texture region holding just that text, for shaders that need it that way
+void draw_text_prerendered(Alignment align, float x, float y, const char *text, Font *font);
+
 void draw_text_auto_wrapped(Alignment align, float x, float y, const char *text, int width, Font *font);
+
+// renders text into a region of a shared texture; valid until the next call
 void render_text(const char *text, Font *font, Sprite *out_spr);
 
 int stringwidth(char *s, Font *font);
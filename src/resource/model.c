@@ -235,8 +235,8 @@ static void parse_obj(const char *filename, ObjFileData *data) {
 	SDL_RWclose(rw);
 }
 
-Model* get_model(const char *name) {
-	return get_resource(RES_MODEL, name, RESF_DEFAULT)->model;
+Model* _get_model(const char *name, const char *caller) {
+	return _get_resource(RES_MODEL, name, RESF_DEFAULT, caller)->model;
 }
 
 void draw_model_p(Model *model) {
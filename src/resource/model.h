@@ -42,7 +42,8 @@ void* load_model_begin(const char *path, unsigned int flags);
 void* load_model_end(void *opaque, const char *path, unsigned int flags);
 void unload_model(void*); // Does not delete elements from the VBO, so doing this at runtime is leaking VBO space
 
-Model* get_model(const char *name);
+Model* _get_model(const char *name, const char *caller);
+#define get_model(name) _get_model(name, __func__)
 
 void draw_model_p(Model *model);
 void draw_model(const char *name);
@@ -16,10 +16,31 @@
 #include "menu/mainmenu.h"
 #include "events.h"
 #include "recolor.h"
+#include "spritemap.h"
+#include "flightrec.h"
+#include "metrics.h"
+#include "jobs.h"
 
 Resources resources;
 static SDL_threadID main_thread_id;
 
+static struct {
+	bool tracking;
+	ResourceHitchStats stats;
+} hitches;
+
+static struct {
+	Hashtable *entries[RES_NUMTYPES];
+	char *name;
+	bool recording;
+} manifest;
+
+static struct {
+	struct ResourceAsyncLoadData *deferred;
+	bool preloading;
+	bool deferring;
+} background;
+
 static const char *resource_type_names[] = {
 	[RES_TEXTURE] = "texture",
 	[RES_ANIM] = "animation",
@@ -122,20 +143,21 @@ typedef struct ResourceAsyncLoadData {
 	char *name;
 	ResourceFlags flags;
 	void *opaque;
+	bool background;
+	struct ResourceAsyncLoadData *next_deferred;
 } ResourceAsyncLoadData;
 
-static int load_resource_async_thread(void *vdata) {
+static void load_resource_async_job(void *vdata) {
 	ResourceAsyncLoadData *data = vdata;
 
-	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
 	data->opaque = data->handler->begin_load(data->path, data->flags);
 	events_emit(TE_RESOURCE_ASYNC_LOADED, 0, data, NULL);
-
-	return 0;
 }
 
 static Resource* load_resource_finish(void *opaque, ResourceHandler *handler, const char *path, const char *name, char *allocated_path, char *allocated_name, ResourceFlags flags);
 
+static void resource_async_load_finish(ResourceAsyncLoadData *data);
+
 static bool resource_asyncload_handler(SDL_Event *evt, void *arg) {
 	assert(SDL_ThreadID() == main_thread_id);
 
@@ -145,14 +167,24 @@ static bool resource_asyncload_handler(SDL_Event *evt, void *arg) {
 		return true;
 	}
 
+	if(data->background && background.deferring) {
+		// the loading thread is done, but the main thread part (e.g. texture uploads) waits for the stage transition
+		data->next_deferred = background.deferred;
+		background.deferred = data;
+		return true;
+	}
+
+	resource_async_load_finish(data);
+	return true;
+}
+
+static void resource_async_load_finish(ResourceAsyncLoadData *data) {
 	char name[strlen(data->name) + 1];
 	strcpy(name, data->name);
 
 	load_resource_finish(data->opaque, data->handler, data->path, data->name, data->path, data->name, data->flags);
 	hashtable_unset(data->handler->async_load_data, name);
 	free(data);
-
-	return true;
 }
 
 static void load_resource_async(ResourceHandler *handler, char *path, char *name, ResourceFlags flags) {
@@ -165,16 +197,14 @@ static void load_resource_async(ResourceHandler *handler, char *path, char *name
 	data->path = path;
 	data->name = name;
 	data->flags = flags;
-
-	SDL_Thread *thread = SDL_CreateThread(load_resource_async_thread, __func__, data);
-
-	if(thread) {
-		SDL_DetachThread(thread);
-	} else {
-		log_warn("SDL_CreateThread() failed: %s", SDL_GetError());
-		log_warn("Falling back to synchronous loading. Use TAISEI_NOASYNC=1 to suppress this warning.");
-		load_resource_async_thread(data);
-	}
+	data->background = background.preloading;
+	data->next_deferred = NULL;
+
+	// runs on an idle worker, so a stage's worth of preloads doesn't start a thread per resource;
+	// without workers this loads it right here, and it's finished from the event handler as usual
+	Job *job = job_create(load_resource_async_job, data);
+	job_submit_idle(job);
+	job_release(job);
 }
 
 static void update_async_load_state(void) {
@@ -192,6 +222,18 @@ static bool resource_check_async_load(ResourceHandler *handler, const char *name
 	}
 
 	ResourceAsyncLoadData *data = hashtable_get_string(handler->async_load_data, name);
+
+	if(data && SDL_ThreadID() == main_thread_id) {
+		// needed before the transition it was loaded for
+		for(ResourceAsyncLoadData **d = &background.deferred; *d; d = &(*d)->next_deferred) {
+			if(*d == data) {
+				*d = data->next_deferred;
+				resource_async_load_finish(data);
+				return false;
+			}
+		}
+	}
+
 	return data;
 }
 
@@ -273,6 +315,7 @@ static Resource* load_resource(ResourceHandler *handler, const char *path, const
 
 static Resource* load_resource_finish(void *opaque, ResourceHandler *handler, const char *path, const char *name, char *allocated_path, char *allocated_name, ResourceFlags flags) {
 	const char *typename = resource_type_names[handler->type];
+	uint64_t load_begin = SDL_GetPerformanceCounter();
 	void *raw = handler->end_load(opaque, path, flags);
 
 	if(!raw) {
@@ -291,20 +334,73 @@ static Resource* load_resource_finish(void *opaque, ResourceHandler *handler, co
 		return NULL;
 	}
 
+	// the path doesn't have to exist, e.g. for sprites that come from a sprite map
 	char *sp = vfs_repr(path, true);
-	Resource *res = insert_resource(handler->type, name, raw, flags, sp);
+	Resource *res = insert_resource(handler->type, name, raw, flags, sp ? sp : path);
 	free(sp);
 
+	flightrec_span(FLIGHTREC_RESOURCE_LOAD, name, load_begin, SDL_GetPerformanceCounter(), 0, handler->type);
+
 	free(allocated_path);
 	free(allocated_name);
 
 	return res;
 }
 
-Resource* get_resource(ResourceType type, const char *name, ResourceFlags flags) {
+void resource_hitches_begin(void) {
+	memset(&hitches, 0, sizeof(hitches));
+	hitches.tracking = true;
+}
+
+void resource_hitches_end(const char *context) {
+	ResourceHitchStats *s = &hitches.stats;
+
+	if(s->count) {
+		log_warn("%s: %u resources were loaded on demand, taking %.2f ms in total. The worst was '%s' at %.2f ms",
+			context, s->count, s->total_time * 1000, s->worst_name, s->worst_time * 1000
+		);
+	}
+
+	hitches.tracking = false;
+}
+
+const ResourceHitchStats* resource_get_hitch_stats(void) {
+	return &hitches.stats;
+}
+
+static void resource_report_lazy_load(ResourceType type, const char *name, const char *caller, uint64_t begin, uint64_t end) {
+	double time = (double)(end - begin) / SDL_GetPerformanceFrequency();
+	bool hitch = hitches.tracking && SDL_ThreadID() == main_thread_id;
+
+	log_warn("%s '%s' was not preloaded; loading it for %s() took %.2f ms%s",
+		resource_type_names[type], name, caller, time * 1000, hitch ? " during gameplay" : ""
+	);
+
+	flightrec_span(FLIGHTREC_LAZY_LOAD, name, begin, end, 0, type);
+	metrics_count(METRIC_LAZY_LOADS);
+
+	if(!hitch) {
+		return;
+	}
+
+	ResourceHitchStats *s = &hitches.stats;
+	++s->count;
+	s->total_time += time;
+
+	if(time > s->worst_time) {
+		s->worst_time = time;
+		strlcpy(s->worst_name, name, sizeof(s->worst_name));
+	}
+}
+
+Resource* _get_resource(ResourceType type, const char *name, ResourceFlags flags, const char *caller) {
 	ResourceHandler *handler = get_handler(type);
 	Resource *res;
 
+	if(manifest.recording && manifest.entries[type] && !hashtable_get_string(manifest.entries[type], name)) {
+		hashtable_set_string(manifest.entries[type], name, (void*)1);
+	}
+
 	if(flags & RESF_UNSAFE) {
 		res = hashtable_get_unsafe(handler->mapping, (void*)name);
 		flags &= ~RESF_UNSAFE;
@@ -320,15 +416,20 @@ Resource* get_resource(ResourceType type, const char *name, ResourceFlags flags)
 	res = hashtable_get(handler->mapping, (void*)name);
 
 	if(!res) {
-		if(!(flags & RESF_PRELOAD)) {
-			log_warn("%s '%s' was not preloaded", resource_type_names[type], name);
+		bool lazy = !(flags & RESF_PRELOAD);
+		uint64_t load_begin = SDL_GetPerformanceCounter();
 
-			if(!(flags & RESF_OPTIONAL) && getenvint("TAISEI_PRELOAD_REQUIRED", false)) {
-				log_fatal("Aborting due to TAISEI_PRELOAD_REQUIRED");
-			}
+		if(lazy && !(flags & RESF_OPTIONAL) && getenvint("TAISEI_PRELOAD_REQUIRED", false)) {
+			log_fatal("%s '%s' was not preloaded (requested by %s()). Aborting due to TAISEI_PRELOAD_REQUIRED",
+				resource_type_names[type], name, caller
+			);
 		}
 
 		res = load_resource(handler, NULL, name, flags, false);
+
+		if(lazy) {
+			resource_report_lazy_load(type, name, caller, load_begin, SDL_GetPerformanceCounter());
+		}
 	}
 
 	if(res && flags & RESF_PERMANENT && !(res->flags & RESF_PERMANENT)) {
@@ -343,6 +444,12 @@ void preload_resource(ResourceType type, const char *name, ResourceFlags flags)
 	if(getenvint("TAISEI_NOPRELOAD", false))
 		return;
 
+	if(background.preloading && (getenvint("TAISEI_NOASYNC", false) || jobs_num_threads() < 2)) {
+		// without async loading or worker threads this would load it right now, which would be a hitch;
+		// it'll be preloaded again when it's actually needed
+		return;
+	}
+
 	ResourceHandler *handler = get_handler(type);
 
 	if(hashtable_get_string(handler->mapping, name) ||
@@ -364,6 +471,176 @@ void preload_resources(ResourceType type, ResourceFlags flags, const char *first
 	va_end(args);
 }
 
+static char* manifest_path(const char *prefix, const char *name) {
+	return strjoin(prefix, "/preload/", name, ".preload", NULL);
+}
+
+static void manifest_foreach(const char *name, KVCallback callback, void *arg) {
+	char *path = manifest_path("res", name);
+	SDL_RWops *strm = vfs_open(path, VFS_MODE_READ);
+
+	if(strm) {
+		parse_keyvalue_stream_cb(strm, callback, arg);
+		SDL_RWclose(strm);
+	} else {
+		log_debug("No preload manifest for %s", name);
+	}
+
+	free(path);
+}
+
+static ResourceType manifest_type(const char *key) {
+	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
+		// postprocessing pipelines don't go through get_resource(), so they are never recorded
+		if(type != RES_POSTPROCESS && !strcmp(key, resource_type_names[type])) {
+			return type;
+		}
+	}
+
+	log_warn("Unknown resource type '%s' in preload manifest", key);
+	return RES_NUMTYPES;
+}
+
+static void manifest_preload_entry(const char *key, const char *val, void *arg) {
+	ResourceType type = manifest_type(key);
+
+	if(type != RES_NUMTYPES) {
+		// the manifest may be stale, so a resource that's gone shouldn't be fatal
+		preload_resource(type, val, *(ResourceFlags*)arg | RESF_OPTIONAL);
+	}
+}
+
+void resource_manifest_preload(const char *name, ResourceFlags flags) {
+	manifest_foreach(name, manifest_preload_entry, &flags);
+}
+
+static void manifest_record_entry(const char *key, const char *val, void *arg) {
+	ResourceType type = manifest_type(key);
+
+	if(type != RES_NUMTYPES) {
+		hashtable_set_string(manifest.entries[type], val, (void*)1);
+	}
+}
+
+void resource_manifest_record_begin(const char *name) {
+	if(!getenvint("TAISEI_PRELOAD_RECORD", false)) {
+		return;
+	}
+
+	assert(!manifest.recording);
+
+	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
+		if(type != RES_POSTPROCESS) {
+			manifest.entries[type] = hashtable_new_stringkeys(HT_DYNAMIC_SIZE);
+		}
+	}
+
+	// merge with what's already there, so that runs with different characters and difficulties add up
+	manifest_foreach(name, manifest_record_entry, NULL);
+	manifest.name = strdup(name);
+	manifest.recording = true;
+}
+
+static int manifest_compare_lines(const void *a, const void *b) {
+	return strcmp(*(char**)a, *(char**)b);
+}
+
+static void manifest_export(void) {
+	char **lines = NULL;
+	size_t num_lines = 0;
+
+	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
+		if(!manifest.entries[type]) {
+			continue;
+		}
+
+		char *name;
+		void *dummy;
+
+		for(HashtableIterator *i = hashtable_iter(manifest.entries[type]); hashtable_iter_next(i, (void**)&name, &dummy);) {
+			lines = realloc(lines, sizeof(*lines) * ++num_lines);
+			lines[num_lines - 1] = strjoin(resource_type_names[type], " = ", name, NULL);
+		}
+	}
+
+	qsort(lines, num_lines, sizeof(*lines), manifest_compare_lines);
+
+	// the storage/resources directory overrides the stock assets, so this takes effect immediately
+	vfs_mkdir("storage/resources/preload");
+	char *path = manifest_path("storage/resources", manifest.name);
+	SDL_RWops *out = vfs_open(path, VFS_MODE_WRITE);
+
+	if(out) {
+		SDL_RWprintf(out, "# Resources used by %s, recorded with TAISEI_PRELOAD_RECORD=1\n", manifest.name);
+
+		for(size_t i = 0; i < num_lines; ++i) {
+			SDL_RWprintf(out, "%s\n", lines[i]);
+		}
+
+		SDL_RWclose(out);
+
+		char *syspath = vfs_repr(path, true);
+		log_info("Saved %zu entries of the %s preload manifest to %s", num_lines, manifest.name, syspath);
+		free(syspath);
+	} else {
+		log_warn("VFS error: %s", vfs_get_error());
+	}
+
+	for(size_t i = 0; i < num_lines; ++i) {
+		free(lines[i]);
+	}
+
+	free(lines);
+	free(path);
+}
+
+void resource_manifest_record_end(void) {
+	if(!manifest.recording) {
+		return;
+	}
+
+	manifest.recording = false;
+	manifest_export();
+
+	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
+		if(manifest.entries[type]) {
+			hashtable_free(manifest.entries[type]);
+		}
+	}
+
+	free(manifest.name);
+	memset(&manifest, 0, sizeof(manifest));
+}
+
+void resource_preload_background_begin(void) {
+	background.preloading = true;
+	background.deferring = true;
+}
+
+void resource_preload_background_end(void) {
+	background.preloading = false;
+}
+
+void resource_finish_background_loads(void) {
+	assert(SDL_ThreadID() == main_thread_id);
+
+	// anything still loading from now on is finished as soon as it's ready, like a normal preload
+	background.deferring = false;
+
+	uint32_t count = 0;
+
+	while(background.deferred) {
+		ResourceAsyncLoadData *data = background.deferred;
+		background.deferred = data->next_deferred;
+		resource_async_load_finish(data);
+		++count;
+	}
+
+	if(count) {
+		log_debug("Finished %u resources loaded in the background", count);
+	}
+}
+
 static void init_sdl_image(void) {
 	int want_flags = IMG_INIT_JPG | IMG_INIT_PNG;
 	int init_flags = IMG_Init(want_flags);
@@ -426,6 +703,7 @@ void init_resources(void) {
 		events_register_handler(&h);
 	}
 
+	spritemap_init();
 	recolor_init();
 	preload_resource(RES_SHADER, "texture_post_load", RESF_PERMANENT);
 }
@@ -465,6 +743,12 @@ void load_resources(void) {
 }
 
 void free_resources(bool all) {
+	uint64_t free_begin = SDL_GetPerformanceCounter();
+	int num_freed = 0;
+
+	// the stage these were meant for never came
+	resource_finish_background_loads();
+
 	for(ResourceType type = 0; type < RES_NUMTYPES; ++type) {
 		ResourceHandler *handler = get_handler(type);
 
@@ -480,6 +764,7 @@ void free_resources(bool all) {
 
 			ResourceFlags flags __attribute__((unused)) = res->flags;
 			unload_resource(res);
+			++num_freed;
 			log_debug("Unloaded %s '%s' (%s)", resource_type_names[type], name,
 				(flags & RESF_PERMANENT) ? "permanent" : "transient"
 			);
@@ -497,6 +782,7 @@ void free_resources(bool all) {
 	}
 
 	if(!all) {
+		flightrec_span(FLIGHTREC_RESOURCE_FREE, "free_resources", free_begin, SDL_GetPerformanceCounter(), 0, num_freed);
 		return;
 	}
 
@@ -510,5 +796,6 @@ void free_resources(bool all) {
 		events_unregister_handler(resource_asyncload_handler);
 	}
 
+	spritemap_shutdown();
 	IMG_Quit();
 }
@@ -117,11 +117,38 @@ void init_resources(void);
 void load_resources(void);
 void free_resources(bool all);
 
-Resource* get_resource(ResourceType type, const char *name, ResourceFlags flags);
+// caller is reported when a resource that wasn't preloaded has to be loaded on the spot
+Resource* _get_resource(ResourceType type, const char *name, ResourceFlags flags, const char *caller);
+#define get_resource(type, name, flags) _get_resource(type, name, flags, __func__)
 Resource* insert_resource(ResourceType type, const char *name, void *data, ResourceFlags flags, const char *source);
 void preload_resource(ResourceType type, const char *name, ResourceFlags flags);
 void preload_resources(ResourceType type, ResourceFlags flags, const char *firstname, ...) __attribute__((sentinel));
 
+typedef struct ResourceHitchStats {
+	uint32_t count;      // resources loaded on demand since resource_hitches_begin()
+	double total_time;   // seconds spent loading them
+	double worst_time;
+	char worst_name[64];
+} ResourceHitchStats;
+
+// on-demand loads between these calls are reported as hitches; stage_loop() brackets the gameplay with them
+void resource_hitches_begin(void);
+void resource_hitches_end(const char *context);
+const ResourceHitchStats* resource_get_hitch_stats(void);
+
+// preloads issued between these calls happen in the background, and their main thread part (e.g. texture uploads)
+// is postponed until resource_finish_background_loads(), or until something requests the resource
+void resource_preload_background_begin(void);
+void resource_preload_background_end(void);
+void resource_finish_background_loads(void);
+
+// preload manifests (res/preload/<name>.preload) list the resources something actually uses, one "type = name" per line
+void resource_manifest_preload(const char *name, ResourceFlags flags);
+
+// with TAISEI_PRELOAD_RECORD=1, every resource requested between these calls is added to the named manifest
+void resource_manifest_record_begin(const char *name);
+void resource_manifest_record_end(void);
+
 void resource_util_strip_ext(char *path);
 char* resource_util_basename(const char *prefix, const char *path);
 const char* resource_util_filename(const char *path);
@@ -316,12 +316,12 @@ int uniloc(Shader *sha, const char *name) {
 	return (intptr_t)hashtable_get_string(sha->uniforms, name) - 1;
 }
 
-Shader* get_shader(const char *name) {
-	return get_resource(RES_SHADER, name, RESF_DEFAULT | RESF_UNSAFE)->shader;
+Shader* _get_shader(const char *name, const char *caller) {
+	return _get_resource(RES_SHADER, name, RESF_DEFAULT | RESF_UNSAFE, caller)->shader;
 }
 
-Shader* get_shader_optional(const char *name) {
-	Resource *r = get_resource(RES_SHADER, name, RESF_OPTIONAL);
+Shader* _get_shader_optional(const char *name, const char *caller) {
+	Resource *r = _get_resource(RES_SHADER, name, RESF_OPTIONAL, caller);
 
 	if(!r) {
 		log_warn("Shader %s could not be loaded", name);
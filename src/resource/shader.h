@@ -26,8 +26,10 @@ void unload_shader(void *vsha);
 
 void load_shader_snippets(const char *filename, const char *prefix, unsigned int flags);
 
-Shader* get_shader(const char *name);
-Shader* get_shader_optional(const char *name);
+Shader* _get_shader(const char *name, const char *caller);
+Shader* _get_shader_optional(const char *name, const char *caller);
+#define get_shader(name) _get_shader(name, __func__)
+#define get_shader_optional(name) _get_shader_optional(name, __func__)
 
 int uniloc(Shader *sha, const char *name);
 
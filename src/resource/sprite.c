@@ -9,6 +9,7 @@
 #include "taisei.h"
 
 #include "sprite.h"
+#include "spritemap.h"
 #include "resource.h"
 #include "video.h"
 
@@ -17,7 +18,8 @@ char* sprite_path(const char *name) {
 
 	VFSInfo pinfo = vfs_query(path);
 
-	if(!pinfo.exists) {
+	// load_sprite_begin() falls back to the sprite map if there's no such file
+	if(!pinfo.exists && !spritemap_get_sprite(name)) {
 		free(path);
 		return texture_path(name);
 	}
@@ -46,6 +48,20 @@ void* load_sprite_begin(const char *path, unsigned int flags) {
 		return state;
 	}
 
+	if(!vfs_query(path).exists) {
+		char *name = resource_util_basename(SPRITE_PATH_PREFIX, path);
+		const SpriteMapSprite *def = spritemap_get_sprite(name);
+		free(name);
+
+		if(def) {
+			spr->tex_area = def->tex_area;
+			spr->w = def->w;
+			spr->h = def->h;
+			state->texture_name = strdup(def->texture);
+			return state;
+		}
+	}
+
 	if(!parse_keyvalue_file_with_spec(path, (KVSpec[]){
 		{ "texture",  .out_str   = &state->texture_name },
 		{ "region_x", .out_float = &spr->tex_area.x },
@@ -121,13 +137,13 @@ void* load_sprite_end(void *opaque, const char *path, unsigned int flags) {
 	return spr;
 }
 
-Sprite* get_sprite(const char *name) {
-	return get_resource(RES_SPRITE, name, RESF_DEFAULT | RESF_UNSAFE)->sprite;
+Sprite* _get_sprite(const char *name, const char *caller) {
+	return _get_resource(RES_SPRITE, name, RESF_DEFAULT | RESF_UNSAFE, caller)->sprite;
 }
 
-Sprite* prefix_get_sprite(const char *name, const char *prefix) {
+Sprite* _prefix_get_sprite(const char *name, const char *prefix, const char *caller) {
 	char *full = strjoin(prefix, name, NULL);
-	Sprite *spr = get_sprite(full);
+	Sprite *spr = _get_sprite(full, caller);
 	free(full);
 	return spr;
 }
@@ -32,8 +32,10 @@ void draw_sprite_ex(float x, float y, float scale_x, float scale_y, bool align,
 void begin_draw_sprite(float x, float y, float scale_x, float scale_y, bool align, Sprite *spr);
 void end_draw_sprite(void);
 
-Sprite* get_sprite(const char *name);
-Sprite* prefix_get_sprite(const char *name, const char *prefix);
+Sprite* _get_sprite(const char *name, const char *caller);
+Sprite* _prefix_get_sprite(const char *name, const char *prefix, const char *caller);
+#define get_sprite(name) _get_sprite(name, __func__)
+#define prefix_get_sprite(name, prefix) _prefix_get_sprite(name, prefix, __func__)
 
 #define SPRITE_PATH_PREFIX "res/gfx/"
 #define SPRITE_EXTENSION ".spr"
@@ -0,0 +1,194 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "spritemap.h"
+#include "sprite.h"
+#include "list.h"
+#include "hashtable.h"
+
+// must match write_spritemap() in scripts/gen-atlases.py
+#define SPRITEMAP_MAGIC "TAISEISM"
+#define SPRITEMAP_VERSION 1
+#define SPRITEMAP_HEADER_SIZE 24
+#define SPRITEMAP_SPRITE_SIZE 32
+#define SPRITEMAP_ANIMATION_SIZE 16
+
+typedef struct SpriteMap SpriteMap;
+
+struct SpriteMap {
+	LIST_INTERFACE(SpriteMap);
+
+	char *data; // the whole file; the names point into its string table
+	SpriteMapSprite *sprites;
+	SpriteMapAnimation *animations;
+};
+
+static struct {
+	SpriteMap *maps;
+	Hashtable *sprites;
+	Hashtable *animations;
+} spritemaps;
+
+static uint32_t spritemap_read_u32(const char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return SDL_SwapLE32(v);
+}
+
+static float spritemap_read_float(const char *p) {
+	float v;
+	memcpy(&v, p, sizeof(v));
+	return SDL_SwapFloatLE(v);
+}
+
+static const char* spritemap_read_string(const char *p, const char *strings, uint32_t strings_size) {
+	uint32_t ofs = spritemap_read_u32(p);
+	return ofs < strings_size ? strings + ofs : NULL;
+}
+
+static bool spritemap_load(const char *path) {
+	int size;
+	char *data = read_all(path, &size);
+
+	if(!data) {
+		return false;
+	}
+
+	if(size < SPRITEMAP_HEADER_SIZE || memcmp(data, SPRITEMAP_MAGIC, sizeof(SPRITEMAP_MAGIC) - 1)) {
+		log_warn("%s: not a sprite map", path);
+		free(data);
+		return false;
+	}
+
+	uint32_t version = spritemap_read_u32(data + 8);
+
+	if(version != SPRITEMAP_VERSION) {
+		log_warn("%s: unsupported version %u", path, version);
+		free(data);
+		return false;
+	}
+
+	uint32_t num_sprites = spritemap_read_u32(data + 12);
+	uint32_t num_animations = spritemap_read_u32(data + 16);
+	uint32_t strings_size = spritemap_read_u32(data + 20);
+
+	uint64_t expected_size = SPRITEMAP_HEADER_SIZE +
+		(uint64_t)num_sprites * SPRITEMAP_SPRITE_SIZE +
+		(uint64_t)num_animations * SPRITEMAP_ANIMATION_SIZE +
+		strings_size;
+
+	const char *records = data + SPRITEMAP_HEADER_SIZE;
+	const char *strings = data + size - strings_size;
+
+	// every string must be terminated within the table
+	if(expected_size != size || (strings_size && strings[strings_size - 1])) {
+		log_warn("%s: sprite map is corrupted", path);
+		free(data);
+		return false;
+	}
+
+	SpriteMap *map = calloc(1, sizeof(SpriteMap));
+	map->data = data;
+	map->sprites = calloc(num_sprites, sizeof(SpriteMapSprite));
+	map->animations = calloc(num_animations, sizeof(SpriteMapAnimation));
+	list_push(&spritemaps.maps, map);
+
+	for(uint32_t i = 0; i < num_sprites; ++i, records += SPRITEMAP_SPRITE_SIZE) {
+		SpriteMapSprite *spr = map->sprites + i;
+		const char *name = spritemap_read_string(records, strings, strings_size);
+		spr->texture = spritemap_read_string(records + 4, strings, strings_size);
+
+		if(!name || !spr->texture) {
+			log_warn("%s: bad string offset in sprite #%u", path, i);
+			continue;
+		}
+
+		spr->tex_area.x = spritemap_read_float(records + 8);
+		spr->tex_area.y = spritemap_read_float(records + 12);
+		spr->tex_area.w = spritemap_read_float(records + 16);
+		spr->tex_area.h = spritemap_read_float(records + 20);
+		spr->w = spritemap_read_float(records + 24);
+		spr->h = spritemap_read_float(records + 28);
+
+		if(hashtable_get_string(spritemaps.sprites, name)) {
+			log_warn("%s: sprite '%s' is also defined in another map, overriding", path, name);
+		}
+
+		hashtable_set_string(spritemaps.sprites, name, spr);
+	}
+
+	for(uint32_t i = 0; i < num_animations; ++i, records += SPRITEMAP_ANIMATION_SIZE) {
+		SpriteMapAnimation *ani = map->animations + i;
+		const char *name = spritemap_read_string(records, strings, strings_size);
+
+		if(!name) {
+			log_warn("%s: bad string offset in animation #%u", path, i);
+			continue;
+		}
+
+		ani->rows = (int32_t)spritemap_read_u32(records + 4);
+		ani->cols = (int32_t)spritemap_read_u32(records + 8);
+		ani->speed = (int32_t)spritemap_read_u32(records + 12);
+
+		if(hashtable_get_string(spritemaps.animations, name)) {
+			log_warn("%s: animation '%s' is also defined in another map, overriding", path, name);
+		}
+
+		hashtable_set_string(spritemaps.animations, name, ani);
+	}
+
+	log_debug("Loaded %u sprites and %u animations from %s", num_sprites, num_animations, path);
+	return true;
+}
+
+static bool spritemap_filter(const char *filename) {
+	return strendswith(filename, SPRITEMAP_EXTENSION);
+}
+
+void spritemap_init(void) {
+	spritemaps.sprites = hashtable_new_stringkeys(HT_DYNAMIC_SIZE);
+	spritemaps.animations = hashtable_new_stringkeys(HT_DYNAMIC_SIZE);
+
+	size_t num_maps = 0;
+	char **maplist = vfs_dir_list_sorted(SPRITE_PATH_PREFIX, &num_maps, vfs_dir_list_order_ascending, spritemap_filter);
+
+	for(size_t i = 0; i < num_maps; ++i) {
+		char *path = strjoin(SPRITE_PATH_PREFIX, maplist[i], NULL);
+		spritemap_load(path);
+		free(path);
+	}
+
+	vfs_dir_list_free(maplist, num_maps);
+}
+
+static void* spritemap_free(List **maps, List *elem, void *arg) {
+	SpriteMap *map = (SpriteMap*)elem;
+	list_unlink(maps, elem);
+	free(map->sprites);
+	free(map->animations);
+	free(map->data);
+	free(map);
+	return NULL;
+}
+
+void spritemap_shutdown(void) {
+	list_foreach(&spritemaps.maps, spritemap_free, NULL);
+	hashtable_free(spritemaps.sprites);
+	hashtable_free(spritemaps.animations);
+	memset(&spritemaps, 0, sizeof(spritemaps));
+}
+
+const SpriteMapSprite* spritemap_get_sprite(const char *name) {
+	return hashtable_get_string(spritemaps.sprites, name);
+}
+
+const SpriteMapAnimation* spritemap_get_animation(const char *name) {
+	return hashtable_get_string(spritemaps.animations, name);
+}
@@ -0,0 +1,45 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "util.h"
+
+/*
+ *  Sprite maps.
+ *
+ *  The atlas packer (scripts/gen-atlases.py) writes one binary .spritemap file per atlas. It holds
+ *  the definitions of every sprite in the atlas, and of the animations made out of them. All maps
+ *  in res/gfx are read at startup, one read per map. The sprite and animation loaders fall back to
+ *  them when there is no loose .spr or .ani file, so loose files still override the maps.
+ *
+ *  The maps are never modified after spritemap_init(), so lookups are safe from any thread.
+ */
+
+typedef struct SpriteMapSprite {
+	const char *texture;
+	FloatRect tex_area;
+	float w;  // 0 if not set; inferred from the region like in .spr files
+	float h;
+} SpriteMapSprite;
+
+typedef struct SpriteMapAnimation {
+	int rows;
+	int cols;
+	int speed;
+} SpriteMapAnimation;
+
+void spritemap_init(void);
+void spritemap_shutdown(void);
+
+// these return NULL if the name isn't in any of the maps
+const SpriteMapSprite* spritemap_get_sprite(const char *name);
+const SpriteMapAnimation* spritemap_get_animation(const char *name);
+
+#define SPRITEMAP_EXTENSION ".spritemap"
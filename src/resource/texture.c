@@ -187,13 +187,13 @@ void* load_texture_end(void *opaque, const char *path, unsigned int flags) {
 	return texture;
 }
 
-Texture* get_tex(const char *name) {
-	return get_resource(RES_TEXTURE, name, RESF_DEFAULT | RESF_UNSAFE)->texture;
+Texture* _get_tex(const char *name, const char *caller) {
+	return _get_resource(RES_TEXTURE, name, RESF_DEFAULT | RESF_UNSAFE, caller)->texture;
 }
 
-Texture* prefix_get_tex(const char *name, const char *prefix) {
+Texture* _prefix_get_tex(const char *name, const char *prefix, const char *caller) {
 	char *full = strjoin(prefix, name, NULL);
-	Texture *tex = get_tex(full);
+	Texture *tex = _get_tex(full, caller);
 	free(full);
 	return tex;
 }
@@ -47,8 +47,10 @@ void fill_screen_p(Texture *tex);
 void loop_tex_line_p(complex a, complex b, float w, float t, Texture *texture);
 void loop_tex_line(complex a, complex b, float w, float t, const char *texture);
 
-Texture* get_tex(const char *name);
-Texture* prefix_get_tex(const char *name, const char *prefix);
+Texture* _get_tex(const char *name, const char *caller);
+Texture* _prefix_get_tex(const char *name, const char *prefix, const char *caller);
+#define get_tex(name) _get_tex(name, __func__)
+#define prefix_get_tex(name, prefix) _prefix_get_tex(name, prefix, __func__)
 
 #define TEX_PATH_PREFIX "res/gfx/"
 #define TEX_EXTENSION ".tex"
@@ -25,6 +25,9 @@
 #include "stagetext.h"
 #include "stagedraw.h"
 #include "stageobjects.h"
+#include "glstate.h"
+#include "profiler.h"
+#include "metrics.h"
 
 static size_t numstages = 0;
 StageInfo *stages = NULL;
@@ -110,6 +113,10 @@ void stage_init_array(void) {
 	add_spellpractice_stage(stages, &stage1_spell_benchmark, &spellnum, STAGE_SPELL_BIT, D_Extra);
 #endif
 
+#ifdef STRESS_STAGE
+	add_stage(STRESS_STAGE_ID, &stress_procs, STAGE_SPECIAL, "Stress Test", "Synthetic load for profiling", NULL, D_Any);
+#endif
+
 	end_stages();
 
 #ifdef DEBUG
@@ -400,14 +407,134 @@ void stage_input(void) {
 	player_applymovement(&global.plr);
 }
 
+bool stage_skip_visual_logic(void) {
+	// Old replays were recorded with visual-only logic feeding off rand_game,
+	// so we can only drop it if it has been kept on its own stream.
+	return global.headless_logic && global.separate_visual_rng;
+}
+
+void stage_visual_logic_begin(void) {
+	if(global.separate_visual_rng) {
+		tsrand_lock(&global.rand_game);
+		tsrand_switch(&global.rand_visual);
+	}
+}
+
+void stage_visual_logic_end(void) {
+	if(global.separate_visual_rng) {
+		tsrand_unlock(&global.rand_game);
+		tsrand_switch(&global.rand_game);
+	}
+}
+
+static inline uint32_t checksum_update(uint32_t h, const void *data, size_t size) {
+	// FNV-1a
+	for(const uint8_t *p = data, *end = p + size; p < end; ++p) {
+		h = (h ^ *p) * 16777619u;
+	}
+
+	return h;
+}
+
+#define CHECKSUM(h, x) ((h) = checksum_update((h), &(x), sizeof(x)))
+
+uint32_t stage_logic_checksum(void) {
+	uint32_t h = 2166136261u;
+	RandomState *rng = &global.rand_game;
+
+	CHECKSUM(h, rng->i);
+	CHECKSUM(h, rng->c);
+	CHECKSUM(h, rng->Q[rng->i]);
+	CHECKSUM(h, global.frames);
+	CHECKSUM(h, global.timer);
+
+	Player *plr = &global.plr;
+	CHECKSUM(h, plr->pos);
+	CHECKSUM(h, plr->points);
+	CHECKSUM(h, plr->lives);
+	CHECKSUM(h, plr->bombs);
+	CHECKSUM(h, plr->life_fragments);
+	CHECKSUM(h, plr->bomb_fragments);
+	CHECKSUM(h, plr->power);
+	CHECKSUM(h, plr->graze);
+
+	for(Projectile *p = global.projs; p; p = p->next) {
+		CHECKSUM(h, p->pos);
+		CHECKSUM(h, p->type);
+	}
+
+	for(Enemy *e = global.enemies; e; e = e->next) {
+		CHECKSUM(h, e->pos);
+		CHECKSUM(h, e->hp);
+	}
+
+	for(Item *i = global.items; i; i = i->next) {
+		CHECKSUM(h, i->pos);
+		CHECKSUM(h, i->type);
+	}
+
+	for(Laser *l = global.lasers; l; l = l->next) {
+		CHECKSUM(h, l->pos);
+	}
+
+	if(global.boss) {
+		CHECKSUM(h, global.boss->pos);
+	}
+
+	return h;
+}
+
+#undef CHECKSUM
+
+#ifdef DEBUG
+static StageChecksumTrace *checksum_trace;
+
+void stage_trace_checksums(StageChecksumTrace *trace) {
+	checksum_trace = trace;
+}
+
+static void stage_record_checksum(void) {
+	StageChecksumTrace *t = checksum_trace;
+
+	if(!t) {
+		return;
+	}
+
+	if(t->num_sums == t->capacity) {
+		t->capacity = t->capacity ? t->capacity * 2 : 4096;
+		t->sums = realloc(t->sums, t->capacity * sizeof(*t->sums));
+	}
+
+	t->sums[t->num_sums++] = stage_logic_checksum();
+}
+#endif
+
 static void stage_logic(void) {
-	player_logic(&global.plr);
+	PROFILE_BEGIN("stage_logic");
 
-	process_enemies(&global.enemies);
-	process_projectiles(&global.projs, true);
-	process_items();
-	process_lasers();
-	process_projectiles(&global.particles, false);
+	PROFILE_ZONE("player") {
+		player_logic(&global.plr);
+	}
+
+	PROFILE_ZONE("enemies") {
+		process_enemies(&global.enemies);
+	}
+
+	PROFILE_ZONE("projectiles") {
+		process_projectiles(&global.projs, true);
+	}
+
+	PROFILE_ZONE("items") {
+		process_items();
+	}
+
+	PROFILE_ZONE("lasers") {
+		process_lasers();
+	}
+
+	PROFILE_ZONE("particles") {
+		process_particles(&global.particles);
+	}
 
 	update_sounds();
 
@@ -423,7 +550,9 @@ static void stage_logic(void) {
 	}
 
 	if(global.boss) {
-		process_boss(&global.boss);
+		PROFILE_ZONE("boss") {
+			process_boss(&global.boss);
+		}
 	}
 
 	global.frames++;
@@ -442,6 +571,8 @@ static void stage_logic(void) {
 		stage_start_bgm(global.dialog->messages[global.dialog->pos].msg);
 		page_dialog(&global.dialog);
 	}
+
+	PROFILE_END("stage_logic");
 }
 
 void stage_clear_hazards(ClearHazardsFlags flags) {
@@ -509,7 +640,20 @@ void stage_finish(int gameover) {
 	}
 }
 
+static void stage_manifest_name(StageInfo *stage, char *buf, size_t bufsize) {
+	snprintf(buf, bufsize, "stage%04x", stage->id);
+}
+
 static void stage_preload(void) {
+	char manifest[16];
+	stage_manifest_name(global.stage, manifest, sizeof(manifest));
+
+	// if the previous stage preloaded this one, only the main thread part of loading is left
+	resource_finish_background_loads();
+
+	// everything the stage used last time it was recorded; the lists below only cover what the manifest misses
+	resource_manifest_preload(manifest, RESF_DEFAULT);
+
 	difficulty_preload();
 	projectiles_preload();
 	player_preload();
@@ -522,6 +666,47 @@ static void stage_preload(void) {
 	global.stage->procs->preload();
 }
 
+static StageInfo* stage_get_next(StageInfo *stage) {
+	if(global.replaymode == REPLAY_PLAY) {
+		if(global.replay_stage && global.replay_stage + 1 < global.replay.stages + global.replay.numstages) {
+			return stage_get(global.replay_stage[1].stage);
+		}
+
+		return NULL;
+	}
+
+	if(stage->type != STAGE_STORY || global.is_practice_mode) {
+		return NULL;
+	}
+
+	StageInfo *next = stage + 1;
+	return next->type == STAGE_STORY ? next : NULL;
+}
+
+static void stage_preload_next(StageInfo *stage) {
+	StageInfo *next = stage_get_next(stage);
+
+	if(!next) {
+		return;
+	}
+
+	log_debug("Preloading %s in the background", next->title);
+
+	char manifest[16];
+	stage_manifest_name(next, manifest, sizeof(manifest));
+
+	resource_preload_background_begin();
+
+	// the music is the first thing the stage needs, and the largest file it loads, so it goes first
+	if(next->procs->bgm) {
+		preload_resource(RES_BGM, next->procs->bgm, RESF_OPTIONAL);
+	}
+
+	resource_manifest_preload(manifest, RESF_DEFAULT);
+	next->procs->preload();
+	resource_preload_background_end();
+}
+
 static void display_stage_title(StageInfo *info) {
 	stagetext_add(info->title,    VIEWPORT_W/2 + I * (VIEWPORT_H/2-40), AL_Center, &_fonts.mainmenu, rgb(1, 1, 1), 50, 85, 35, 35);
 	stagetext_add(info->subtitle, VIEWPORT_W/2 + I * (VIEWPORT_H/2),    AL_Center, &_fonts.standard, rgb(1, 1, 1), 60, 85, 35, 35);
@@ -549,6 +734,7 @@ typedef struct StageFrameState {
 	StageInfo *stage;
 	int transition_delay;
 	uint16_t last_replay_fps;
+	bool next_stage_preloaded;
 } StageFrameState;
 
 static void stage_update_fps(StageFrameState *fstate) {
@@ -562,10 +748,19 @@ static void stage_update_fps(StageFrameState *fstate) {
 	}
 }
 
+static bool stage_want_headless_logic(void) {
+	switch(global.headless_mode) {
+		case HEADLESS_LOGIC_NEVER:  return false;
+		case HEADLESS_LOGIC_ALWAYS: return true;
+		default:                    return global.replaymode == REPLAY_PLAY && gamekeypressed(KEY_SKIP);
+	}
+}
+
 static FrameAction stage_logic_frame(void *arg) {
 	StageFrameState *fstate = arg;
 	StageInfo *stage = fstate->stage;
 
+	global.headless_logic = stage_want_headless_logic();
 	stage_update_fps(fstate);
 	((global.replaymode == REPLAY_PLAY) ? replay_input : stage_input)();
 
@@ -584,6 +779,17 @@ static FrameAction stage_logic_frame(void *arg) {
 
 	replay_stage_check_desync(global.replay_stage, global.frames, (tsrand() ^ global.plr.points) & 0xFFFF, global.replaymode);
 	stage_logic();
+	metrics_frame();
+
+	if(!fstate->next_stage_preloaded && global.boss && global.dialog) {
+		// the boss intro dialog; the rest of the stage is the boss fight, which is enough time to load the next one
+		stage_preload_next(stage);
+		fstate->next_stage_preloaded = true;
+	}
+
+#ifdef DEBUG
+	stage_record_checksum();
+#endif
 
 	if(fstate->transition_delay) {
 		--fstate->transition_delay;
@@ -642,9 +848,15 @@ void stage_loop(StageInfo *stage) {
 	// I really want to separate all of the game state from the global struct sometime
 	global.stage = stage;
 
+	char manifest[16];
+	stage_manifest_name(stage, manifest, sizeof(manifest));
+	resource_manifest_record_begin(manifest);
+
 	stage_objpools_alloc();
+	particle_workers_init();
 	stage_preload();
 	stage_draw_preload();
+	glstate_reset_stats();
 
 	uint32_t seed = (uint32_t)time(0);
 	tsrand_switch(&global.rand_game);
@@ -653,6 +865,8 @@ void stage_loop(StageInfo *stage) {
 
 	if(global.replaymode == REPLAY_RECORD) {
 		global.replay_stage = replay_create_stage(&global.replay, stage, seed, global.diff, &global.plr);
+		global.replay_stage->flags |= REPLAY_SFLAG_VISUAL_RNG;
+		global.separate_visual_rng = true;
 
 		// make sure our player state is consistent with what goes into the replay
 		player_init(&global.plr);
@@ -684,6 +898,9 @@ void stage_loop(StageInfo *stage) {
 		tsrand_seed_p(&global.rand_game, stg->seed);
 		log_debug("Random seed: %u", stg->seed);
 
+		global.separate_visual_rng = stg->flags & REPLAY_SFLAG_VISUAL_RNG;
+		log_debug("Separate visual RNG: %s", global.separate_visual_rng ? "yes" : "no");
+
 		global.diff = stg->diff;
 		player_init(&global.plr);
 		replay_stage_sync_player_state(stg, &global.plr);
@@ -698,7 +915,10 @@ void stage_loop(StageInfo *stage) {
 	}
 
 	StageFrameState fstate = { .stage = stage };
+	resource_hitches_begin();
 	loop_at_fps(stage_logic_frame, stage_render_frame, &fstate, FPS);
+	resource_manifest_record_end();
+	resource_hitches_end(stage->title);
 
 	if(global.replaymode == REPLAY_RECORD) {
 		replay_stage_event(global.replay_stage, global.frames, EV_OVER, 0);
@@ -708,6 +928,10 @@ void stage_loop(StageInfo *stage) {
 		}
 	}
 
+	global.headless_logic = false;
+	glstate_log_stats(stage->title);
+	particle_workers_shutdown();
+	projectiles_free_drawbuffer();
 	stage->procs->end();
 	stage_free();
 	player_free(&global.plr);
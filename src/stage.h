@@ -67,6 +67,7 @@ typedef enum StageType {
 	STAGE_STORY = 1,
 	STAGE_EXTRA,
 	STAGE_SPELL,
+	STAGE_SPECIAL,
 } StageType;
 
 typedef struct StageProcs StageProcs;
@@ -81,6 +82,7 @@ struct StageProcs {
 	ShaderRule *shader_rules;
 	ShaderRule *postprocess_rules;
 	StageProcs *spellpractice_procs;
+	const char *bgm; // the music the stage opens with, if any
 };
 
 typedef struct StageInfo {
@@ -127,9 +129,29 @@ typedef enum ClearHazardsFlags {
 
 void stage_clear_hazards(ClearHazardsFlags flags);
 
+// Visual-only logic (enemy visual rules, boss glow, particles) must be wrapped in these,
+// so that it does not consume rand_game when the stage keeps the two streams apart.
+bool stage_skip_visual_logic(void);
+void stage_visual_logic_begin(void);
+void stage_visual_logic_end(void);
+
+uint32_t stage_logic_checksum(void);
+
+#ifdef DEBUG
+typedef struct StageChecksumTrace {
+	uint32_t *sums;
+	size_t num_sums;
+	size_t capacity;
+} StageChecksumTrace;
+
+// records stage_logic_checksum() after every logic frame; pass NULL to stop
+void stage_trace_checksums(StageChecksumTrace *trace);
+#endif
+
 #include "stages/stage1.h"
 #include "stages/stage2.h"
 #include "stages/stage3.h"
 #include "stages/stage4.h"
 #include "stages/stage5.h"
 #include "stages/stage6.h"
+#include "stages/stress.h"
@@ -12,6 +12,9 @@
 #include "stagedraw.h"
 #include "stagetext.h"
 #include "video.h"
+#include "glstats.h"
+#include "glstate.h"
+#include "profiler.h"
 
 #ifdef DEBUG
 	#define GRAPHS_DEFAULT 1
@@ -107,6 +110,7 @@ static void draw_wall_of_text(float f, const char *txt) {
 	glUseProgram(shader->prog);
 	glUniform1f(uniloc(shader, "w"), spr.tex_area.w/spr.tex->w);
 	glUniform1f(uniloc(shader, "h"), spr.tex_area.h/spr.tex->h);
+	glUniform2f(uniloc(shader, "texofs"), spr.tex_area.x/spr.tex->w, spr.tex_area.y/spr.tex->h);
 	glUniform1f(uniloc(shader, "ratio"), h/w);
 	glUniform2f(uniloc(shader, "origin"), creal(global.boss->pos)/h, cimag(global.boss->pos)/w);
 	glUniform1f(uniloc(shader, "t"), f);
@@ -353,6 +357,9 @@ void stage_draw_scene(StageInfo *stage) {
 
 	bool draw_bg = !config_get_int(CONFIG_NO_STAGEBG) && !key_nobg;
 
+	PROFILE_BEGIN("stage_draw_scene");
+	PROFILE_BEGIN("background");
+
 	if(draw_bg) {
 		// render the 3D background
 		stage_render_bg(stage);
@@ -384,11 +391,16 @@ void stage_draw_scene(StageInfo *stage) {
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
 
+	PROFILE_END("background");
+
 	// draw the 2D objects
-	set_ortho_ex(VIEWPORT_W, VIEWPORT_H);
-	stage_draw_objects();
+	PROFILE_ZONE("objects") {
+		set_ortho_ex(VIEWPORT_W, VIEWPORT_H);
+		stage_draw_objects();
+	}
 
 	// everything drawn, now apply postprocessing
+	PROFILE_BEGIN("postprocess");
 	swap_fbo_pair(&resources.fbo_pairs.fg);
 
 	// stage postprocessing
@@ -415,7 +427,13 @@ void stage_draw_scene(StageInfo *stage) {
 
 	// finally, draw stuff to the actual screen
 	stage_draw_foreground();
-	stage_draw_hud();
+	PROFILE_END("postprocess");
+
+	PROFILE_ZONE("hud") {
+		stage_draw_hud();
+	}
+
+	PROFILE_END("stage_draw_scene");
 }
 
 static inline void stage_draw_hud_power_value(float ypos, char *buf, size_t bufsize) {
@@ -443,7 +461,7 @@ static void stage_draw_hud_scores(float ypos_hiscore, float ypos_score, char *bu
 	glUniform1f(stagedraw.hud_text.u_split, 0.0);
 }
 
-static void stage_draw_hud_objpool_stats(float x, float y, float width, Font *font) {
+static float stage_draw_hud_objpool_stats(float x, float y, float width, Font *font) {
 	ObjectPool **last = &stage_object_pools.first + (sizeof(StageObjectPools)/sizeof(ObjectPool*) - 1);
 
 	for(ObjectPool **pool = &stage_object_pools.first; pool <= last; ++pool) {
@@ -457,6 +475,66 @@ static void stage_draw_hud_objpool_stats(float x, float y, float width, Font *fo
 
 		y += stringheight(buf, font) * 1.1;
 	}
+
+	return y;
+}
+
+static float stage_draw_hud_hitch_stats(float x, float y, float width, Font *font) {
+	const ResourceHitchStats *stats = resource_get_hitch_stats();
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%u | %5.1fms", stats->count, stats->worst_time * 1000);
+	draw_text(AL_Left  | AL_Flag_NoAdjust, (int)x,           (int)y, "Lazy loads", font);
+	draw_text(AL_Right | AL_Flag_NoAdjust, (int)(x + width), (int)y, buf,          font);
+
+	return y + stringheight(buf, font) * 1.1;
+}
+
+static void stage_draw_hud_glstats(float x, float y, float width, Font *font) {
+	const GLFrameStats *last = glstats_get_frame(0);
+	GLFrameStats peak;
+
+	if(!last) {
+		return;
+	}
+
+	glstats_get_peak(&peak);
+
+	struct { const char *tag; uint64_t last, peak; } rows[] = {
+		{ "Draw calls", last->draw_calls,        peak.draw_calls },
+		{ "Vertices",   last->vertices,          peak.vertices },
+		{ "Tex binds",  last->texture_binds,     peak.texture_binds },
+		{ "Programs",   last->program_switches,  peak.program_switches },
+		{ "Uniforms",   last->uniform_uploads,   peak.uniform_uploads },
+		{ "Blending",   last->blend_changes,     peak.blend_changes },
+		{ "FBO binds",  last->framebuffer_binds, peak.framebuffer_binds },
+	};
+
+	for(size_t i = 0; i < sizeof(rows)/sizeof(*rows); ++i) {
+		char buf[48];
+		snprintf(buf, sizeof(buf), "%"PRIu64" | %7"PRIu64, rows[i].last, rows[i].peak);
+		draw_text(AL_Left  | AL_Flag_NoAdjust, (int)x,           (int)y, rows[i].tag, font);
+		draw_text(AL_Right | AL_Flag_NoAdjust, (int)(x + width), (int)y, buf,         font);
+
+		y += stringheight(buf, font) * 1.1;
+	}
+
+	if(glstate_enabled()) {
+		GLStateCacheStats cstats;
+		uint64_t calls = 0, skipped = 0;
+		char buf[32];
+
+		glstate_get_stats(&cstats);
+
+		for(int i = 0; i < GLSTATE_NUM_CATEGORIES; ++i) {
+			calls += cstats.calls[i];
+			skipped += cstats.skipped[i];
+		}
+
+		snprintf(buf, sizeof(buf), "%.1f%%", calls ? 100.0 * skipped / calls : 0.0);
+		draw_text(AL_Left  | AL_Flag_NoAdjust, (int)x,           (int)y, "Redundant", font);
+		draw_text(AL_Right | AL_Flag_NoAdjust, (int)(x + width), (int)y, buf,         font);
+	}
 }
 
 struct labels_s {
@@ -492,8 +570,15 @@ void stage_draw_hud_text(struct labels_s* labels) {
 	draw_text(AL_Left, labels->x.ofs, labels->y.graze,   "Graze:",    _fonts.hud);
 	glUniform4f(stagedraw.hud_text.u_colortint, 1.00, 1.00, 1.00, 1.00);
 
+	float stats_y = labels->y.graze + 32;
+
 	if(stagedraw.objpool_stats) {
-		stage_draw_hud_objpool_stats(labels->x.ofs, labels->y.graze + 32, 250, _fonts.monotiny);
+		stats_y = stage_draw_hud_objpool_stats(labels->x.ofs, stats_y, 250, _fonts.monotiny);
+		stats_y = stage_draw_hud_hitch_stats(labels->x.ofs, stats_y, 250, _fonts.monotiny) + 8;
+	}
+
+	if(glstats_enabled()) {
+		stage_draw_hud_glstats(labels->x.ofs, stats_y, 250, _fonts.monotiny);
 	}
 
 	// Score/Hi-Score values
@@ -238,6 +238,7 @@ StageProcs stage1_procs = {
 	.event = stage1_events,
 	.shader_rules = stage1_shaders,
 	.spellpractice_procs = &stage1_spell_procs,
+	.bgm = "stage1",
 };
 
 StageProcs stage1_spell_procs = {
@@ -269,6 +269,7 @@ StageProcs stage2_procs = {
 	.event = stage2_events,
 	.shader_rules = stage2_shaders,
 	.spellpractice_procs = &stage2_spell_procs,
+	.bgm = "stage2",
 };
 
 StageProcs stage2_spell_procs = {
@@ -398,6 +398,7 @@ StageProcs stage3_procs = {
 	.shader_rules = stage3_shaders,
 	.postprocess_rules = stage3_postprocess,
 	.spellpractice_procs = &stage3_spell_procs,
+	.bgm = "stage3",
 };
 
 StageProcs stage3_spell_procs = {
@@ -333,6 +333,7 @@ StageProcs stage4_procs = {
 	.event = stage4_events,
 	.shader_rules = stage4_shaders,
 	.spellpractice_procs = &stage4_spell_procs,
+	.bgm = "stage4",
 };
 
 StageProcs stage4_spell_procs = {
@@ -223,6 +223,7 @@ StageProcs stage5_procs = {
 	.event = stage5_events,
 	.shader_rules = stage5_shaders,
 	.spellpractice_procs = &stage5_spell_procs,
+	.bgm = "stage5",
 };
 
 StageProcs stage5_spell_procs = {
@@ -346,6 +346,7 @@ StageProcs stage6_procs = {
 	.event = stage6_events,
 	.shader_rules = stage6_shaders,
 	.spellpractice_procs = &stage6_spell_procs,
+	.bgm = "stage6",
 };
 
 StageProcs stage6_spell_procs = {
@@ -0,0 +1,286 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "stress.h"
+#include "global.h"
+
+#ifdef STRESS_STAGE
+
+/*
+ *  A synthetic stage for measuring how frame times scale with object counts.
+ *
+ *  The load is raised in levels; at level N there are N times the per-level step of every kind
+ *  of object alive, topped up every frame as they die or leave the screen. Spawn positions come
+ *  from a private RNG with a fixed seed, so runs are comparable between builds. After each level
+ *  the average and worst logic/render times are logged. All knobs are environment variables:
+ *
+ *      TAISEI_STRESS_PROJECTILES, TAISEI_STRESS_PARTICLES, TAISEI_STRESS_LASERS,
+ *      TAISEI_STRESS_ENEMIES, TAISEI_STRESS_ITEMS: objects added per level (0 disables a kind)
+ *      TAISEI_STRESS_LEVELS: number of levels
+ *      TAISEI_STRESS_FRAMES: frames per level, the first TAISEI_STRESS_WARMUP are not measured
+ *      TAISEI_STRESS_SEED: seed for the spawn RNG
+ */
+
+typedef enum StressKind {
+	STRESS_PROJECTILES,
+	STRESS_PARTICLES,
+	STRESS_LASERS,
+	STRESS_ENEMIES,
+	STRESS_ITEMS,
+	NUM_STRESS_KINDS,
+} StressKind;
+
+static const struct {
+	const char *name;
+	const char *env;
+	int default_step;
+} stress_kinds[] = {
+	[STRESS_PROJECTILES] = { "projectiles", "TAISEI_STRESS_PROJECTILES", 500 },
+	[STRESS_PARTICLES]   = { "particles",   "TAISEI_STRESS_PARTICLES",   1000 },
+	[STRESS_LASERS]      = { "lasers",      "TAISEI_STRESS_LASERS",      4 },
+	[STRESS_ENEMIES]     = { "enemies",     "TAISEI_STRESS_ENEMIES",     20 },
+	[STRESS_ITEMS]       = { "items",       "TAISEI_STRESS_ITEMS",       100 },
+};
+
+typedef struct StressTiming {
+	hrtime_t total;
+	hrtime_t worst;
+	int samples;
+} StressTiming;
+
+static struct {
+	int step[NUM_STRESS_KINDS];
+	int levels;
+	int frames_per_level;
+	int warmup_frames;
+	uint32_t seed;
+
+	RandomState rng;
+	int level;
+	int level_frame;
+
+	StressTiming logic;
+	StressTiming render;
+	hrtime_t last_render_update;
+} stress;
+
+static double stress_frand(void) {
+	return tsrand_p(&stress.rng) / (double)TSRAND_MAX;
+}
+
+static complex stress_random_pos(void) {
+	return VIEWPORT_W * stress_frand() + I * VIEWPORT_H * stress_frand();
+}
+
+static complex stress_random_dir(double speed) {
+	return speed * cexp(2 * M_PI * I * stress_frand());
+}
+
+static Color stress_random_color(void) {
+	return rgb(0.2 + 0.8 * stress_frand(), 0.2 + 0.8 * stress_frand(), 0.2 + 0.8 * stress_frand());
+}
+
+static int stress_enemy_logic(Enemy *e, int t) {
+	if(t < 0) {
+		return 1;
+	}
+
+	e->pos += e->args[0];
+	return 1;
+}
+
+static void stress_spawn(StressKind kind) {
+	switch(kind) {
+		case STRESS_PROJECTILES:
+			PROJECTILE("ball", stress_random_pos(), stress_random_color(), linear, {
+				stress_random_dir(0.5 + 2 * stress_frand())
+			});
+			break;
+
+		case STRESS_PARTICLES:
+			PARTICLE("flare", stress_random_pos(), stress_random_color(), timeout_linear, {
+				30 + 90 * stress_frand(),
+				stress_random_dir(0.5 + stress_frand())
+			});
+			break;
+
+		case STRESS_LASERS:
+			create_laserline(stress_random_pos(), stress_random_dir(10), 30, 120 + 60 * stress_frand(), stress_random_color());
+			break;
+
+		case STRESS_ENEMIES:
+			create_enemy1c(stress_random_pos(), 1000, Fairy, stress_enemy_logic, stress_random_dir(0.5 + stress_frand()));
+			break;
+
+		case STRESS_ITEMS:
+			create_item(VIEWPORT_W * stress_frand() + I * VIEWPORT_H * 0.5 * stress_frand(), stress_random_dir(2), stress_frand() > 0.5 ? Point : Power);
+			break;
+
+		default: log_fatal("Unknown object kind %i", kind);
+	}
+}
+
+#define STRESS_COUNT(head, out) do { (out) = 0; for(__typeof__(head) _o = (head); _o; _o = _o->next) ++(out); } while(0)
+
+static int stress_count(StressKind kind) {
+	int n;
+
+	switch(kind) {
+		case STRESS_PROJECTILES: STRESS_COUNT(global.projs, n); break;
+		case STRESS_PARTICLES:   STRESS_COUNT(global.particles, n); break;
+		case STRESS_LASERS:      STRESS_COUNT(global.lasers, n); break;
+		case STRESS_ENEMIES:     STRESS_COUNT(global.enemies, n); break;
+		case STRESS_ITEMS:       STRESS_COUNT(global.items, n); break;
+		default: log_fatal("Unknown object kind %i", kind);
+	}
+
+	return n;
+}
+
+#undef STRESS_COUNT
+
+static void stress_timing_add(StressTiming *timing, hrtime_t t) {
+	timing->total += t;
+	if(t > timing->worst) {
+		timing->worst = t;
+	}
+
+	++timing->samples;
+}
+
+static double stress_timing_avg_ms(StressTiming *timing) {
+	return timing->samples ? 1000.0 * timing->total / timing->samples : 0;
+}
+
+static void stress_begin_level(int level) {
+	stress.level = level;
+	stress.level_frame = 0;
+	memset(&stress.logic, 0, sizeof(stress.logic));
+	memset(&stress.render, 0, sizeof(stress.render));
+
+	// every level starts from the same state regardless of what happened before
+	tsrand_init(&stress.rng, stress.seed + level);
+}
+
+static void stress_end_level(void) {
+	char counts[256] = { 0 };
+	char *p = counts;
+
+	for(StressKind k = 0; k < NUM_STRESS_KINDS; ++k) {
+		p += snprintf(p, counts + sizeof(counts) - p, "%s%i %s", k ? ", " : "", stress.step[k] * stress.level, stress_kinds[k].name);
+	}
+
+	log_info("Level %i/%i (%s): logic %.3f ms avg, %.3f ms max; render %.3f ms avg, %.3f ms max (%i/%i samples)",
+		stress.level, stress.levels, counts,
+		stress_timing_avg_ms(&stress.logic), 1000.0 * (double)stress.logic.worst,
+		stress_timing_avg_ms(&stress.render), 1000.0 * (double)stress.render.worst,
+		stress.logic.samples, stress.render.samples
+	);
+}
+
+static void stress_start(void) {
+	memset(&stress, 0, sizeof(stress));
+
+	for(StressKind k = 0; k < NUM_STRESS_KINDS; ++k) {
+		stress.step[k] = max(0, getenvint(stress_kinds[k].env, stress_kinds[k].default_step));
+	}
+
+	stress.levels = max(1, getenvint("TAISEI_STRESS_LEVELS", 10));
+	stress.frames_per_level = max(1, getenvint("TAISEI_STRESS_FRAMES", 300));
+	stress.warmup_frames = clamp(getenvint("TAISEI_STRESS_WARMUP", 60), 0, stress.frames_per_level - 1);
+	stress.seed = getenvint("TAISEI_STRESS_SEED", 0x5EED);
+
+	// nothing should die while we're measuring
+	global.plr.iddqd = true;
+
+	log_info("Stress test: %i levels of %i frames, seed %u", stress.levels, stress.frames_per_level, stress.seed);
+	stress_begin_level(1);
+}
+
+static void stress_events(void) {
+	if(global.game_over == GAMEOVER_TRANSITIONING) {
+		return;
+	}
+
+	if(stress.level_frame >= stress.warmup_frames) {
+		// these describe the previous frame, which already ran at this level's load
+		stress_timing_add(&stress.logic, global.fps.logic_time);
+
+		if(global.fps.render.last_update_time != stress.last_render_update) {
+			stress_timing_add(&stress.render, global.fps.render_time);
+		}
+	}
+
+	stress.last_render_update = global.fps.render.last_update_time;
+
+	if(++stress.level_frame > stress.frames_per_level) {
+		stress_end_level();
+
+		if(stress.level == stress.levels) {
+			stage_finish(GAMEOVER_ABORT);
+			return;
+		}
+
+		stress_begin_level(stress.level + 1);
+	}
+
+	for(StressKind k = 0; k < NUM_STRESS_KINDS; ++k) {
+		for(int n = stress_count(k), target = stress.step[k] * stress.level; n < target; ++n) {
+			stress_spawn(k);
+		}
+	}
+}
+
+static void stress_preload(void) {
+	preload_resources(RES_SPRITE, RESF_DEFAULT,
+		"proj/ball",
+		"part/flare",
+		"fairy_circle",
+		"item/point",
+		"item/power",
+	NULL);
+	preload_resources(RES_TEXTURE, RESF_DEFAULT,
+		"part/lasercurve",
+	NULL);
+	preload_resources(RES_ANIM, RESF_DEFAULT,
+		"enemy/fairy",
+	NULL);
+	// only exists with instanced drawing, see load_resources(); the lasers fall back to the texture otherwise
+	preload_resources(RES_SHADER, RESF_OPTIONAL,
+		"laser_linear",
+	NULL);
+	preload_resources(RES_SFX, RESF_OPTIONAL,
+		"enemydeath",
+		"item_generic",
+	NULL);
+}
+
+static void stress_end(void) {
+}
+
+static void stress_draw(void) {
+}
+
+static void stress_update(void) {
+}
+
+static ShaderRule stress_shaders[] = { NULL };
+
+StageProcs stress_procs = {
+	.begin = stress_start,
+	.preload = stress_preload,
+	.end = stress_end,
+	.draw = stress_draw,
+	.update = stress_update,
+	.event = stress_events,
+	.shader_rules = stress_shaders,
+};
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "stage.h"
+
+#if defined(DEBUG) && !defined(STRESS_STAGE)
+#define STRESS_STAGE
+#endif
+
+#ifdef STRESS_STAGE
+#define STRESS_STAGE_ID 0xFF
+
+extern StageProcs stress_procs;
+#endif
@@ -84,9 +84,9 @@ static void stagetext_draw_single(StageText *txt) {
 	glActiveTexture(GL_TEXTURE0);
 
 	glUniform3f(uniloc(sha, "color"), 0,0,0);
-	draw_text(txt->align, creal(txt->pos)+10*f*f+1, cimag(txt->pos)+10*f*f+1, txt->text, *txt->font);
+	draw_text_prerendered(txt->align, creal(txt->pos)+10*f*f+1, cimag(txt->pos)+10*f*f+1, txt->text, *txt->font);
 	glUniform3fv(uniloc(sha, "color"), 1, txt->clr);
-	draw_text(txt->align, creal(txt->pos)+10*f*f, cimag(txt->pos)+10*f*f, txt->text, *txt->font);
+	draw_text_prerendered(txt->align, creal(txt->pos)+10*f*f, cimag(txt->pos)+10*f*f, txt->text, *txt->font);
 
 	glUseProgram(0);
 }
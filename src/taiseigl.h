@@ -46,6 +46,7 @@ glfuncs = sorted(glfuncs | force_funcs)
 
 typedefs = []
 prototypes = []
+nulldefs = []
 
 for func in glfuncs:
 	try:
@@ -63,6 +64,11 @@ for func in glfuncs:
 	typedefs.append(typedef)
 	prototypes.append(proto)
 
+	if rtype.strip() == 'void':
+		nulldefs.append('GLNULL_VOID(%s, %s, (%s))' % (callconv, func, params))
+	else:
+		nulldefs.append('GLNULL(%s, %s, %s, (%s))' % (rtype.strip(), callconv, func, params))
+
 text = thisfile.read_text()
 
 subs = {
@@ -72,6 +78,7 @@ subs = {
 	'reversedefs': '\n'.join('#define ts%s %s' % (f, f) for f in glfuncs),
 	'typedefs': '\n'.join(typedefs),
 	'protos': '\n'.join(prototypes),
+	'nulldefs': '#define GLNULLDEFS \\\n' + ' \\\n'.join(nulldefs),
 }
 
 for key, val in subs.items():
@@ -111,6 +118,7 @@ extern struct glext_s glext;
 
 void load_gl_library(void);
 void load_gl_functions(void);
+void load_gl_functions_null(void);
 void check_gl_extensions(void);
 void unload_gl_library(void);
 
@@ -191,6 +199,7 @@ typedef const GLubyte * (GLAPIENTRY *tsglGetString_ptr)(GLenum name);
 typedef GLint (APIENTRY *tsglGetUniformLocation_ptr)(GLuint program, const GLchar *name);
 typedef void (APIENTRY *tsglLinkProgram_ptr)(GLuint program);
 typedef void (GLAPIENTRY *tsglLoadIdentity_ptr)(void);
+typedef void (GLAPIENTRY *tsglLoadMatrixf_ptr)(const GLfloat *m);
 typedef void * (APIENTRY *tsglMapBuffer_ptr)(GLenum target, GLenum access);
 typedef void (GLAPIENTRY *tsglMatrixMode_ptr)(GLenum mode);
 typedef void (GLAPIENTRY *tsglNormalPointer_ptr)(GLenum type, GLsizei stride, const GLvoid *ptr);
@@ -285,6 +294,7 @@ typedef void (GLAPIENTRY *tsglViewport_ptr)(GLint x, GLint y, GLsizei width, GLs
 #undef glGetUniformLocation
 #undef glLinkProgram
 #undef glLoadIdentity
+#undef glLoadMatrixf
 #undef glMapBuffer
 #undef glMatrixMode
 #undef glNormalPointer
@@ -380,6 +390,7 @@ typedef void (GLAPIENTRY *tsglViewport_ptr)(GLint x, GLint y, GLsizei width, GLs
 #define glGetUniformLocation tsglGetUniformLocation
 #define glLinkProgram tsglLinkProgram
 #define glLoadIdentity tsglLoadIdentity
+#define glLoadMatrixf tsglLoadMatrixf
 #define glMapBuffer tsglMapBuffer
 #define glMatrixMode tsglMatrixMode
 #define glNormalPointer tsglNormalPointer
@@ -477,6 +488,7 @@ GLDEF(glGetString, tsglGetString, tsglGetString_ptr) \
 GLDEF(glGetUniformLocation, tsglGetUniformLocation, tsglGetUniformLocation_ptr) \
 GLDEF(glLinkProgram, tsglLinkProgram, tsglLinkProgram_ptr) \
 GLDEF(glLoadIdentity, tsglLoadIdentity, tsglLoadIdentity_ptr) \
+GLDEF(glLoadMatrixf, tsglLoadMatrixf, tsglLoadMatrixf_ptr) \
 GLDEF(glMapBuffer, tsglMapBuffer, tsglMapBuffer_ptr) \
 GLDEF(glMatrixMode, tsglMatrixMode, tsglMatrixMode_ptr) \
 GLDEF(glNormalPointer, tsglNormalPointer, tsglNormalPointer_ptr) \
@@ -521,6 +533,102 @@ GLDEF(glViewport, tsglViewport, tsglViewport_ptr)
 GLDEFS
 #undef GLDEF
 
+// @BEGIN:nulldefs@
+#define GLNULLDEFS \
+GLNULL_VOID(GLAPIENTRY, glActiveTexture, (GLenum texture)) \
+GLNULL_VOID(APIENTRY, glAttachShader, (GLuint program, GLuint shader)) \
+GLNULL_VOID(APIENTRY, glBindBuffer, (GLenum target, GLuint buffer)) \
+GLNULL_VOID(APIENTRY, glBindFramebuffer, (GLenum target, GLuint framebuffer)) \
+GLNULL_VOID(GLAPIENTRY, glBindTexture, (GLenum target, GLuint texture)) \
+GLNULL_VOID(GLAPIENTRY, glBlendEquation, (GLenum mode)) \
+GLNULL_VOID(APIENTRY, glBlendEquationSeparate, (GLenum modeRGB, GLenum modeAlpha)) \
+GLNULL_VOID(GLAPIENTRY, glBlendFunc, (GLenum sfactor, GLenum dfactor)) \
+GLNULL_VOID(APIENTRY, glBlendFuncSeparate, (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha)) \
+GLNULL_VOID(APIENTRY, glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage)) \
+GLNULL_VOID(APIENTRY, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data)) \
+GLNULL_VOID(GLAPIENTRY, glClear, (GLbitfield mask)) \
+GLNULL_VOID(GLAPIENTRY, glClearColor, (GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)) \
+GLNULL_VOID(GLAPIENTRY, glColor3f, (GLfloat red, GLfloat green, GLfloat blue)) \
+GLNULL_VOID(GLAPIENTRY, glColor4f, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)) \
+GLNULL_VOID(APIENTRY, glCompileShader, (GLuint shader)) \
+GLNULL(GLuint, APIENTRY, glCreateProgram, (void)) \
+GLNULL(GLuint, APIENTRY, glCreateShader, (GLenum type)) \
+GLNULL_VOID(GLAPIENTRY, glCullFace, (GLenum mode)) \
+GLNULL_VOID(APIENTRY, glDebugMessageCallback, (GLDEBUGPROC callback, const void *userParam)) \
+GLNULL_VOID(APIENTRY, glDebugMessageCallbackARB, (GLDEBUGPROCARB callback, const void *userParam)) \
+GLNULL_VOID(APIENTRY, glDebugMessageControl, (GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled)) \
+GLNULL_VOID(APIENTRY, glDebugMessageControlARB, (GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled)) \
+GLNULL_VOID(APIENTRY, glDeleteBuffers, (GLsizei n, const GLuint *buffers)) \
+GLNULL_VOID(APIENTRY, glDeleteFramebuffers, (GLsizei n, const GLuint *framebuffers)) \
+GLNULL_VOID(APIENTRY, glDeleteProgram, (GLuint program)) \
+GLNULL_VOID(APIENTRY, glDeleteShader, (GLuint shader)) \
+GLNULL_VOID(GLAPIENTRY, glDeleteTextures, (GLsizei n, const GLuint *textures)) \
+GLNULL_VOID(GLAPIENTRY, glDepthFunc, (GLenum func)) \
+GLNULL_VOID(GLAPIENTRY, glDepthMask, (GLboolean flag)) \
+GLNULL_VOID(GLAPIENTRY, glDisable, (GLenum cap)) \
+GLNULL_VOID(GLAPIENTRY, glDrawArrays, (GLenum mode, GLint first, GLsizei count)) \
+GLNULL_VOID(APIENTRY, glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount)) \
+GLNULL_VOID(APIENTRY, glDrawArraysInstancedARB, (GLenum mode, GLint first, GLsizei count, GLsizei primcount)) \
+GLNULL_VOID(APIENTRY, glDrawArraysInstancedEXT, (GLenum mode, GLint start, GLsizei count, GLsizei primcount)) \
+GLNULL_VOID(GLAPIENTRY, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)) \
+GLNULL_VOID(GLAPIENTRY, glEnable, (GLenum cap)) \
+GLNULL_VOID(GLAPIENTRY, glEnableClientState, (GLenum cap)) \
+GLNULL_VOID(APIENTRY, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)) \
+GLNULL_VOID(GLAPIENTRY, glFrustum, (GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble near_val, GLdouble far_val)) \
+GLNULL_VOID(APIENTRY, glGenBuffers, (GLsizei n, GLuint *buffers)) \
+GLNULL_VOID(APIENTRY, glGenFramebuffers, (GLsizei n, GLuint *framebuffers)) \
+GLNULL_VOID(GLAPIENTRY, glGenTextures, (GLsizei n, GLuint *textures)) \
+GLNULL_VOID(APIENTRY, glGetActiveUniform, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name)) \
+GLNULL_VOID(GLAPIENTRY, glGetIntegerv, (GLenum pname, GLint *params)) \
+GLNULL_VOID(APIENTRY, glGetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog)) \
+GLNULL_VOID(APIENTRY, glGetProgramiv, (GLuint program, GLenum pname, GLint *params)) \
+GLNULL_VOID(APIENTRY, glGetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog)) \
+GLNULL_VOID(APIENTRY, glGetShaderiv, (GLuint shader, GLenum pname, GLint *params)) \
+GLNULL(const GLubyte *, GLAPIENTRY, glGetString, (GLenum name)) \
+GLNULL(GLint, APIENTRY, glGetUniformLocation, (GLuint program, const GLchar *name)) \
+GLNULL_VOID(APIENTRY, glLinkProgram, (GLuint program)) \
+GLNULL_VOID(GLAPIENTRY, glLoadIdentity, (void)) \
+GLNULL_VOID(GLAPIENTRY, glLoadMatrixf, (const GLfloat *m)) \
+GLNULL(void *, APIENTRY, glMapBuffer, (GLenum target, GLenum access)) \
+GLNULL_VOID(GLAPIENTRY, glMatrixMode, (GLenum mode)) \
+GLNULL_VOID(GLAPIENTRY, glNormalPointer, (GLenum type, GLsizei stride, const GLvoid *ptr)) \
+GLNULL_VOID(GLAPIENTRY, glOrtho, (GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble near_val, GLdouble far_val)) \
+GLNULL_VOID(GLAPIENTRY, glPopMatrix, (void)) \
+GLNULL_VOID(GLAPIENTRY, glPushMatrix, (void)) \
+GLNULL_VOID(GLAPIENTRY, glReadBuffer, (GLenum mode)) \
+GLNULL_VOID(GLAPIENTRY, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid *pixels)) \
+GLNULL_VOID(GLAPIENTRY, glRotatef, (GLfloat angle, GLfloat x, GLfloat y, GLfloat z)) \
+GLNULL_VOID(GLAPIENTRY, glScalef, (GLfloat x, GLfloat y, GLfloat z)) \
+GLNULL_VOID(APIENTRY, glShaderSource, (GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length)) \
+GLNULL_VOID(GLAPIENTRY, glTexCoordPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *ptr)) \
+GLNULL_VOID(GLAPIENTRY, glTexImage2D, (GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels)) \
+GLNULL_VOID(GLAPIENTRY, glTexParameterf, (GLenum target, GLenum pname, GLfloat param)) \
+GLNULL_VOID(GLAPIENTRY, glTexParameteri, (GLenum target, GLenum pname, GLint param)) \
+GLNULL_VOID(GLAPIENTRY, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)) \
+GLNULL_VOID(GLAPIENTRY, glTranslatef, (GLfloat x, GLfloat y, GLfloat z)) \
+GLNULL_VOID(APIENTRY, glUniform1f, (GLint location, GLfloat v0)) \
+GLNULL_VOID(APIENTRY, glUniform1fv, (GLint location, GLsizei count, const GLfloat *value)) \
+GLNULL_VOID(APIENTRY, glUniform1i, (GLint location, GLint v0)) \
+GLNULL_VOID(APIENTRY, glUniform1iv, (GLint location, GLsizei count, const GLint *value)) \
+GLNULL_VOID(APIENTRY, glUniform1uiv, (GLint location, GLsizei count, const GLuint *value)) \
+GLNULL_VOID(APIENTRY, glUniform2f, (GLint location, GLfloat v0, GLfloat v1)) \
+GLNULL_VOID(APIENTRY, glUniform2fv, (GLint location, GLsizei count, const GLfloat *value)) \
+GLNULL_VOID(APIENTRY, glUniform2iv, (GLint location, GLsizei count, const GLint *value)) \
+GLNULL_VOID(APIENTRY, glUniform2uiv, (GLint location, GLsizei count, const GLuint *value)) \
+GLNULL_VOID(APIENTRY, glUniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2)) \
+GLNULL_VOID(APIENTRY, glUniform3fv, (GLint location, GLsizei count, const GLfloat *value)) \
+GLNULL_VOID(APIENTRY, glUniform3iv, (GLint location, GLsizei count, const GLint *value)) \
+GLNULL_VOID(APIENTRY, glUniform3uiv, (GLint location, GLsizei count, const GLuint *value)) \
+GLNULL_VOID(APIENTRY, glUniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)) \
+GLNULL_VOID(APIENTRY, glUniform4fv, (GLint location, GLsizei count, const GLfloat *value)) \
+GLNULL_VOID(APIENTRY, glUniform4iv, (GLint location, GLsizei count, const GLint *value)) \
+GLNULL_VOID(APIENTRY, glUniform4uiv, (GLint location, GLsizei count, const GLuint *value)) \
+GLNULL(GLboolean, APIENTRY, glUnmapBuffer, (GLenum target)) \
+GLNULL_VOID(APIENTRY, glUseProgram, (GLuint program)) \
+GLNULL_VOID(GLAPIENTRY, glVertexPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *ptr)) \
+GLNULL_VOID(GLAPIENTRY, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height))
+// @END:nulldefs@
+
 #endif // !LINK_TO_LIBGL
 
 #ifdef LINK_TO_LIBGL
@@ -578,6 +686,7 @@ GLAPI const GLubyte * GLAPIENTRY glGetString( GLenum name );
 GLAPI GLint APIENTRY glGetUniformLocation (GLuint program, const GLchar *name);
 GLAPI void APIENTRY glLinkProgram (GLuint program);
 GLAPI void GLAPIENTRY glLoadIdentity( void );
+GLAPI void GLAPIENTRY glLoadMatrixf( const GLfloat *m );
 GLAPI void *APIENTRY glMapBuffer (GLenum target, GLenum access);
 GLAPI void GLAPIENTRY glMatrixMode( GLenum mode );
 GLAPI void GLAPIENTRY glNormalPointer( GLenum type, GLsizei stride, const GLvoid *ptr );
@@ -672,6 +781,7 @@ GLAPI void GLAPIENTRY glViewport( GLint x, GLint y, GLsizei width, GLsizei heigh
 #define tsglGetUniformLocation glGetUniformLocation
 #define tsglLinkProgram glLinkProgram
 #define tsglLoadIdentity glLoadIdentity
+#define tsglLoadMatrixf glLoadMatrixf
 #define tsglMapBuffer glMapBuffer
 #define tsglMatrixMode glMatrixMode
 #define tsglNormalPointer glNormalPointer
@@ -0,0 +1,145 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include "global.h"
+
+#define TAISEIGL_NO_EXT_ABSTRACTION
+#include "taiseigl.h"
+#undef TAISEIGL_NO_EXT_ABSTRACTION
+
+/*
+ *  A GL "implementation" that does nothing, for running the game without a GPU.
+ *
+ *  Most functions are generated no-ops. The few that the game reads results back from are
+ *  implemented by hand below, and only as far as needed to make resource loading succeed:
+ *  object names are handed out from a counter, shaders always compile and link, and queries
+ *  return zeroes.
+ */
+
+#ifndef LINK_TO_LIBGL
+
+#define GLNULL_VOID(callconv, glname, params) \
+	static void callconv null_##glname params { }
+
+#define GLNULL(rtype, callconv, glname, params) \
+	static rtype callconv null_##glname params { return (rtype)0; }
+
+GLNULLDEFS
+
+#undef GLNULL
+#undef GLNULL_VOID
+
+static GLuint nullgl_names;
+
+static void nullgl_gen(GLsizei n, GLuint *names) {
+	for(GLsizei i = 0; i < n; ++i) {
+		names[i] = ++nullgl_names;
+	}
+}
+
+static void APIENTRY nullgl_GenBuffers(GLsizei n, GLuint *buffers) {
+	nullgl_gen(n, buffers);
+}
+
+static void APIENTRY nullgl_GenFramebuffers(GLsizei n, GLuint *framebuffers) {
+	nullgl_gen(n, framebuffers);
+}
+
+static void GLAPIENTRY nullgl_GenTextures(GLsizei n, GLuint *textures) {
+	nullgl_gen(n, textures);
+}
+
+static GLuint APIENTRY nullgl_CreateProgram(void) {
+	return ++nullgl_names;
+}
+
+static GLuint APIENTRY nullgl_CreateShader(GLenum type) {
+	return ++nullgl_names;
+}
+
+static GLint APIENTRY nullgl_GetUniformLocation(GLuint program, const GLchar *name) {
+	return -1;
+}
+
+static void nullgl_get_object_param(GLenum pname, GLint *params) {
+	switch(pname) {
+		case GL_COMPILE_STATUS:
+		case GL_LINK_STATUS:
+			*params = GL_TRUE;
+			break;
+
+		default:
+			*params = 0;
+			break;
+	}
+}
+
+static void APIENTRY nullgl_GetShaderiv(GLuint shader, GLenum pname, GLint *params) {
+	nullgl_get_object_param(pname, params);
+}
+
+static void APIENTRY nullgl_GetProgramiv(GLuint program, GLenum pname, GLint *params) {
+	nullgl_get_object_param(pname, params);
+}
+
+static void GLAPIENTRY nullgl_GetIntegerv(GLenum pname, GLint *params) {
+	*params = 0;
+}
+
+static const GLubyte* GLAPIENTRY nullgl_GetString(GLenum name) {
+	switch(name) {
+		case GL_VERSION:                  return (const GLubyte*)"2.1 (null)";
+		case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte*)"1.20 (null)";
+		case GL_VENDOR:                   return (const GLubyte*)"Taisei";
+		case GL_RENDERER:                 return (const GLubyte*)"Null renderer";
+		case GL_EXTENSIONS:               return (const GLubyte*)"";
+		default:                          return NULL;
+	}
+}
+
+static void GLAPIENTRY nullgl_ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid *pixels) {
+	// at least don't hand out uninitialized memory
+	if(format == GL_RGB && type == GL_UNSIGNED_BYTE) {
+		memset(pixels, 0, 3 * width * height);
+	}
+}
+
+#endif // !LINK_TO_LIBGL
+
+void load_gl_functions_null(void) {
+#ifdef LINK_TO_LIBGL
+	log_fatal("The null GL backend is not available in builds linked directly to libGL");
+#else
+	#define GLDEF(glname,tsname,typename) tsname = null_##glname;
+	GLDEFS
+	#undef GLDEF
+
+	tsglGenBuffers = nullgl_GenBuffers;
+	tsglGenFramebuffers = nullgl_GenFramebuffers;
+	tsglGenTextures = nullgl_GenTextures;
+	tsglCreateProgram = nullgl_CreateProgram;
+	tsglCreateShader = nullgl_CreateShader;
+	tsglGetUniformLocation = nullgl_GetUniformLocation;
+	tsglGetShaderiv = nullgl_GetShaderiv;
+	tsglGetProgramiv = nullgl_GetProgramiv;
+	tsglGetIntegerv = nullgl_GetIntegerv;
+	tsglGetString = nullgl_GetString;
+	tsglReadPixels = nullgl_ReadPixels;
+
+	memset(&glext, 0, sizeof(glext));
+	glext.version.major = 2;
+	glext.version.minor = 1;
+	glext.draw_instanced = true;
+	glext.ARB_draw_instanced = true;
+	glext.DrawArraysInstanced = tsglDrawArraysInstancedARB;
+
+	log_info("Using the null GL backend, nothing will be rendered");
+#endif
+}
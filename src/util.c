@@ -189,6 +189,45 @@ char* ucs4_to_utf8(const uint32_t *ucs4) {
 	return utf8;
 }
 
+uint32_t utf8_getch(const char **src) {
+	const uint8_t *s = (const uint8_t*)*src;
+	uint32_t ch = *s;
+	int len;
+
+	if(!ch) {
+		return 0;
+	}
+
+	if(ch < 0x80) {
+		len = 1;
+	} else if((ch & 0xE0) == 0xC0) {
+		ch &= 0x1F;
+		len = 2;
+	} else if((ch & 0xF0) == 0xE0) {
+		ch &= 0x0F;
+		len = 3;
+	} else if((ch & 0xF8) == 0xF0) {
+		ch &= 0x07;
+		len = 4;
+	} else {
+		*src += 1;
+		return 0xFFFD;
+	}
+
+	for(int i = 1; i < len; ++i) {
+		if((s[i] & 0xC0) != 0x80) {
+			// truncated sequence; resume at the offending byte
+			*src += i;
+			return 0xFFFD;
+		}
+
+		ch = (ch << 6) | (s[i] & 0x3F);
+	}
+
+	*src += len;
+	return ch;
+}
+
 /*
  * public domain strtok_r() by Charlie Gordon
  *
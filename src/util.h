@@ -59,6 +59,9 @@ size_t ucs4len(const uint32_t *ucs4);
 uint32_t* utf8_to_ucs4(const char *utf8);
 char* ucs4_to_utf8(const uint32_t *ucs4);
 
+// decodes one character and advances *src past it; returns 0 at the end of the string
+uint32_t utf8_getch(const char **src);
+
 //
 // math utils
 //
@@ -23,10 +23,7 @@ void init_vbo(VBO *vbo, int size) {
 	glBindBuffer(GL_ARRAY_BUFFER, vbo->vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*size, NULL, GL_STATIC_DRAW);
 
-	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), NULL);
-	glNormalPointer(GL_FLOAT, sizeof(Vertex), (uint8_t*)NULL + sizeof(Vector));
-	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (uint8_t*)NULL + 2*sizeof(Vector));
-
+	vbo_bind(vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glEnableClientState(GL_VERTEX_ARRAY);
@@ -34,6 +31,24 @@ void init_vbo(VBO *vbo, int size) {
 	glEnableClientState(GL_NORMAL_ARRAY);
 }
 
+void vbo_bind(VBO *vbo) {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->vbo);
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), NULL);
+	glNormalPointer(GL_FLOAT, sizeof(Vertex), (uint8_t*)NULL + sizeof(Vector));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (uint8_t*)NULL + 2*sizeof(Vector));
+}
+
+void vbo_stream_verts(VBO *vbo, Vertex *verts, int count) {
+	if(count > vbo->size)
+		log_fatal("Cannot stream Vertices: VBO too small!");
+
+	// orphan the old storage, so that we don't have to wait for the GPU to finish with it
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*vbo->size, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex)*count, verts);
+
+	vbo->offset = count;
+}
+
 void vbo_add_verts(VBO *vbo, Vertex *verts, int count) {
 	if(vbo->offset + count > vbo->size)
 		log_fatal("Cannot add Vertices: VBO too small!");
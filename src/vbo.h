@@ -38,6 +38,12 @@ struct Vertex {
 void init_vbo(VBO *vbo, int size);
 void vbo_add_verts(VBO *vbo, Vertex *verts, int count);
 
+// binds the buffer and points the vertex arrays into it
+void vbo_bind(VBO *vbo);
+
+// replaces the whole contents of the buffer; for data that changes every draw
+void vbo_stream_verts(VBO *vbo, Vertex *verts, int count);
+
 void init_quadvbo(void);
 void draw_quad(void);
 void delete_vbo(VBO *vbo);
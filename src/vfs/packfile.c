@@ -0,0 +1,473 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#include "taisei.h"
+
+#include <zlib.h>
+
+#include "packfile.h"
+#include "syspath.h"
+#include "rwops/all.h"
+
+// a pack node is the package root; a pack path node is an entry in it, and keeps the root alive
+
+typedef struct VFSPackData {
+	VFSNode *source;
+	const uint8_t *data;
+	size_t size;
+	bool mapped;
+	PackHeader header;
+} VFSPackData;
+
+typedef struct VFSPackPathData {
+	VFSNode *packnode;
+	uint32_t index;
+	PackEntry entry;
+} VFSPackPathData;
+
+typedef struct VFSPackIterData {
+	uint64_t next;
+	uint64_t end;
+	size_t prefix_len;
+} VFSPackIterData;
+
+static VFSNodeFuncs vfs_funcs_packfile;
+static VFSNodeFuncs vfs_funcs_packpath;
+
+static uint32_t vfs_pack_hash(const char *str) {
+	// FNV-1a, same as in pack.py
+	uint32_t hash = 2166136261u;
+
+	for(const uint8_t *p = (const uint8_t*)str; *p; ++p) {
+		hash = (hash ^ *p) * 16777619u;
+	}
+
+	return hash;
+}
+
+static bool vfs_pack_get_entry(VFSPackData *pdata, uint64_t index, PackEntry *out) {
+	if(index >= pdata->header.num_entries) {
+		return false;
+	}
+
+	memcpy(out, pdata->data + pdata->header.entries_offset + index * sizeof(PackEntry), sizeof(PackEntry));
+
+	out->name_offset = SDL_SwapLE32(out->name_offset);
+	out->name_length = SDL_SwapLE32(out->name_length);
+	out->hash = SDL_SwapLE32(out->hash);
+	out->flags = SDL_SwapLE32(out->flags);
+	out->offset = SDL_SwapLE64(out->offset);
+	out->size = SDL_SwapLE64(out->size);
+	out->orig_size = SDL_SwapLE64(out->orig_size);
+	out->crc32 = SDL_SwapLE32(out->crc32);
+
+	// entries are validated as they're used, so that mounting doesn't have to go over all of them
+	if((uint64_t)out->name_offset + out->name_length >= pdata->header.names_size) {
+		return false;
+	}
+
+	if(out->flags & PACK_ENTRY_DIR) {
+		return out->offset + out->size <= pdata->header.num_entries;
+	}
+
+	return out->offset + out->size <= pdata->size;
+}
+
+static inline const char* vfs_pack_entry_name(VFSPackData *pdata, PackEntry *e) {
+	return (const char*)pdata->data + pdata->header.names_offset + e->name_offset;
+}
+
+static VFSNode* vfs_pack_lookup(VFSNode *packnode, const char *path) {
+	VFSPackData *pdata = packnode->data1;
+	uint32_t mask = pdata->header.num_buckets - 1;
+	uint32_t hash = vfs_pack_hash(path);
+	const uint8_t *buckets = pdata->data + pdata->header.buckets_offset;
+
+	for(uint32_t i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes) {
+		uint32_t bucket;
+		memcpy(&bucket, buckets + i * sizeof(bucket), sizeof(bucket));
+		bucket = SDL_SwapLE32(bucket);
+
+		if(!bucket) {
+			break;
+		}
+
+		PackEntry e;
+
+		if(!vfs_pack_get_entry(pdata, bucket - 1, &e)) {
+			vfs_set_error("Corrupt entry %u in package", bucket - 1);
+			return NULL;
+		}
+
+		if(e.hash == hash && !strcmp(vfs_pack_entry_name(pdata, &e), path)) {
+			VFSNode *n = vfs_alloc();
+			VFSPackPathData *ppdata = calloc(1, sizeof(VFSPackPathData));
+			ppdata->packnode = packnode;
+			ppdata->index = bucket - 1;
+			ppdata->entry = e;
+			vfs_incref(packnode);
+
+			n->data1 = ppdata;
+			n->funcs = &vfs_funcs_packpath;
+			return n;
+		}
+	}
+
+	return NULL;
+}
+
+static const char* vfs_pack_iter_shared(VFSPackData *pdata, VFSPackIterData *idata) {
+	while(idata->next < idata->end) {
+		PackEntry e;
+
+		if(!vfs_pack_get_entry(pdata, idata->next++, &e) || e.name_length <= idata->prefix_len) {
+			continue;
+		}
+
+		const char *name = vfs_pack_entry_name(pdata, &e) + idata->prefix_len;
+
+		if(!strchr(name, VFS_PATH_SEP)) {
+			// a direct child, not something deeper down
+			return name;
+		}
+	}
+
+	return NULL;
+}
+
+static void vfs_pack_iter_stop(VFSNode *node, void **opaque) {
+	free(*opaque);
+	*opaque = NULL;
+}
+
+/* package root */
+
+static void vfs_packfile_free(VFSNode *node) {
+	VFSPackData *pdata = node->data1;
+
+	if(!pdata) {
+		return;
+	}
+
+	if(pdata->mapped) {
+		vfs_syspath_unmap((void*)pdata->data, pdata->size);
+	} else {
+		free((void*)pdata->data);
+	}
+
+	if(pdata->source) {
+		vfs_decref(pdata->source);
+	}
+
+	free(pdata);
+}
+
+static VFSInfo vfs_packfile_query(VFSNode *node) {
+	return (VFSInfo) {
+		.exists = true,
+		.is_dir = true,
+	};
+}
+
+static char* vfs_packfile_syspath(VFSNode *node) {
+	VFSPackData *pdata = node->data1;
+
+	if(pdata->source->funcs->syspath) {
+		return pdata->source->funcs->syspath(pdata->source);
+	}
+
+	return NULL;
+}
+
+static char* vfs_packfile_repr(VFSNode *node) {
+	VFSPackData *pdata = node->data1;
+	char *srcrepr = vfs_repr_node(pdata->source, false);
+	char *packrepr = strfmt("package %s", srcrepr);
+	free(srcrepr);
+	return packrepr;
+}
+
+static VFSNode* vfs_packfile_locate(VFSNode *node, const char *path) {
+	return vfs_pack_lookup(node, path);
+}
+
+static const char* vfs_packfile_iter(VFSNode *node, void **opaque) {
+	VFSPackData *pdata = node->data1;
+	VFSPackIterData *idata = *opaque;
+
+	if(!idata) {
+		*opaque = idata = calloc(1, sizeof(VFSPackIterData));
+		idata->end = pdata->header.num_entries;
+	}
+
+	return vfs_pack_iter_shared(pdata, idata);
+}
+
+static VFSNodeFuncs vfs_funcs_packfile = {
+	.repr = vfs_packfile_repr,
+	.query = vfs_packfile_query,
+	.free = vfs_packfile_free,
+	.syspath = vfs_packfile_syspath,
+	.locate = vfs_packfile_locate,
+	.iter = vfs_packfile_iter,
+	.iter_stop = vfs_pack_iter_stop,
+};
+
+/* entries */
+
+static inline VFSPackData* vfs_packpath_pack(VFSNode *node) {
+	return ((VFSPackPathData*)node->data1)->packnode->data1;
+}
+
+static inline const char* vfs_packpath_name(VFSNode *node) {
+	VFSPackPathData *ppdata = node->data1;
+	return vfs_pack_entry_name(vfs_packpath_pack(node), &ppdata->entry);
+}
+
+static void vfs_packpath_free(VFSNode *node) {
+	VFSPackPathData *ppdata = node->data1;
+	vfs_decref(ppdata->packnode);
+	free(ppdata);
+}
+
+static VFSInfo vfs_packpath_query(VFSNode *node) {
+	VFSPackPathData *ppdata = node->data1;
+
+	return (VFSInfo) {
+		.exists = true,
+		.is_dir = ppdata->entry.flags & PACK_ENTRY_DIR,
+	};
+}
+
+static char* vfs_packpath_syspath(VFSNode *node) {
+	VFSPackPathData *ppdata = node->data1;
+	char *packpath = vfs_repr_node(ppdata->packnode, true);
+	char *subpath = strfmt("%s%c%s", packpath, vfs_syspath_preferred_separator, vfs_packpath_name(node));
+	free(packpath);
+	return subpath;
+}
+
+static char* vfs_packpath_repr(VFSNode *node) {
+	VFSPackPathData *ppdata = node->data1;
+	char *packrepr = vfs_repr_node(ppdata->packnode, false);
+	char *r = strfmt("%s '%s' in %s",
+		(ppdata->entry.flags & PACK_ENTRY_DIR) ? "directory" : "file", vfs_packpath_name(node), packrepr);
+	free(packrepr);
+	return r;
+}
+
+static VFSNode* vfs_packpath_locate(VFSNode *node, const char *path) {
+	VFSPackPathData *ppdata = node->data1;
+	const char *mypath = vfs_packpath_name(node);
+	char fullpath[strlen(mypath) + strlen(path) + 2];
+	snprintf(fullpath, sizeof(fullpath), "%s%c%s", mypath, VFS_PATH_SEP, path);
+
+	return vfs_pack_lookup(ppdata->packnode, fullpath);
+}
+
+static const char* vfs_packpath_iter(VFSNode *node, void **opaque) {
+	VFSPackPathData *ppdata = node->data1;
+	VFSPackIterData *idata = *opaque;
+
+	if(!(ppdata->entry.flags & PACK_ENTRY_DIR)) {
+		return NULL;
+	}
+
+	if(!idata) {
+		*opaque = idata = calloc(1, sizeof(VFSPackIterData));
+		idata->next = ppdata->entry.offset;
+		idata->end = ppdata->entry.offset + ppdata->entry.size;
+		idata->prefix_len = ppdata->entry.name_length + 1;
+	}
+
+	return vfs_pack_iter_shared(vfs_packpath_pack(node), idata);
+}
+
+static SDL_RWops* vfs_packpath_open(VFSNode *node, VFSOpenMode mode) {
+	if(mode & VFS_MODE_WRITE) {
+		vfs_set_error("Packages are read-only");
+		return NULL;
+	}
+
+	VFSPackPathData *ppdata = node->data1;
+	VFSPackData *pdata = vfs_packpath_pack(node);
+	PackEntry *e = &ppdata->entry;
+	const uint8_t *data = pdata->data + e->offset;
+
+	if(e->flags & PACK_ENTRY_DIR) {
+		vfs_set_error("'%s' is a directory", vfs_packpath_name(node));
+		return NULL;
+	}
+
+	if(!e->orig_size) {
+		// SDL doesn't do empty memory streams
+		vfs_set_error("'%s' is empty", vfs_packpath_name(node));
+		return NULL;
+	}
+
+	if(!(e->flags & PACK_ENTRY_ZLIB)) {
+#ifdef DEBUG
+		if(crc32(0, data, e->size) != e->crc32) {
+			vfs_set_error("'%s' is corrupt (checksum mismatch)", vfs_packpath_name(node));
+			return NULL;
+		}
+#endif
+
+		// straight from the package, no copies
+		return SDL_RWFromConstMem(data, e->size);
+	}
+
+	void *buf;
+	SDL_RWops *rw = SDL_RWAutoBuffer(&buf, e->orig_size);
+	uLongf size = e->orig_size;
+
+	if(uncompress(buf, &size, data, e->size) != Z_OK || size != e->orig_size || crc32(0, buf, size) != e->crc32) {
+		vfs_set_error("'%s' is corrupt", vfs_packpath_name(node));
+		SDL_RWclose(rw);
+		return NULL;
+	}
+
+	return rw;
+}
+
+static VFSNodeFuncs vfs_funcs_packpath = {
+	.repr = vfs_packpath_repr,
+	.query = vfs_packpath_query,
+	.free = vfs_packpath_free,
+	.syspath = vfs_packpath_syspath,
+	.locate = vfs_packpath_locate,
+	.iter = vfs_packpath_iter,
+	.iter_stop = vfs_pack_iter_stop,
+	.open = vfs_packpath_open,
+};
+
+static bool vfs_packfile_load(VFSPackData *pdata) {
+	void *map = vfs_syspath_map(pdata->source, &pdata->size);
+
+	if(map) {
+		pdata->data = map;
+		pdata->mapped = true;
+		return true;
+	}
+
+	// not a real file; read it all into memory instead
+	if(!pdata->source->funcs->open) {
+		vfs_set_error("Package can't be opened as a file");
+		return false;
+	}
+
+	SDL_RWops *rw = pdata->source->funcs->open(pdata->source, VFS_MODE_READ);
+
+	if(!rw) {
+		return false;
+	}
+
+	int64_t size = SDL_RWsize(rw);
+
+	if(size > 0) {
+		void *data = malloc(size);
+
+		if(SDL_RWread(rw, data, size, 1) == 1) {
+			pdata->data = data;
+			pdata->size = size;
+		} else {
+			vfs_set_error_from_sdl();
+			free(data);
+		}
+	} else {
+		vfs_set_error("Can't determine the size of the package");
+	}
+
+	SDL_RWclose(rw);
+	return pdata->data;
+}
+
+static bool vfs_packfile_validate(VFSPackData *pdata) {
+	PackHeader *h = &pdata->header;
+
+	if(pdata->size < sizeof(*h)) {
+		vfs_set_error("Package is truncated");
+		return false;
+	}
+
+	memcpy(h, pdata->data, sizeof(*h));
+
+	if(memcmp(h->magic, PACK_MAGIC, sizeof(h->magic))) {
+		vfs_set_error("Not a Taisei package");
+		return false;
+	}
+
+	h->version = SDL_SwapLE32(h->version);
+	h->num_entries = SDL_SwapLE32(h->num_entries);
+	h->num_buckets = SDL_SwapLE32(h->num_buckets);
+	h->entries_offset = SDL_SwapLE64(h->entries_offset);
+	h->buckets_offset = SDL_SwapLE64(h->buckets_offset);
+	h->names_offset = SDL_SwapLE64(h->names_offset);
+	h->names_size = SDL_SwapLE64(h->names_size);
+
+	if(h->version != PACK_VERSION) {
+		vfs_set_error("Unsupported package version %u", h->version);
+		return false;
+	}
+
+	if(
+		!h->num_buckets || (h->num_buckets & (h->num_buckets - 1)) ||
+		h->entries_offset + (uint64_t)h->num_entries * sizeof(PackEntry) > pdata->size ||
+		h->buckets_offset + (uint64_t)h->num_buckets * sizeof(uint32_t) > pdata->size ||
+		h->names_offset + h->names_size > pdata->size ||
+		(h->names_size && pdata->data[h->names_offset + h->names_size - 1])
+	) {
+		vfs_set_error("Package header is corrupt");
+		return false;
+	}
+
+	return true;
+}
+
+bool vfs_packfile_init(VFSNode *node, VFSNode *source) {
+	VFSPackData *pdata = calloc(1, sizeof(VFSPackData));
+	pdata->source = source;
+
+	if(!vfs_packfile_load(pdata) || !vfs_packfile_validate(pdata)) {
+		pdata->source = NULL; // don't decref it
+		node->data1 = pdata;
+		vfs_packfile_free(node);
+		node->data1 = NULL;
+		return false;
+	}
+
+	node->data1 = pdata;
+	node->funcs = &vfs_funcs_packfile;
+	return true;
+}
+
+bool vfs_mount_packfile(const char *mountpoint, const char *packpath) {
+	char p[strlen(packpath)+1];
+	packpath = vfs_path_normalize(packpath, p);
+	VFSNode *node = vfs_locate(vfs_root, packpath);
+
+	if(!node) {
+		vfs_set_error("Node '%s' does not exist", packpath);
+		return false;
+	}
+
+	VFSNode *pnode = vfs_alloc();
+
+	if(!vfs_packfile_init(pnode, node)) {
+		vfs_decref(pnode);
+		vfs_decref(node);
+		return false;
+	}
+
+	if(!vfs_mount(vfs_root, mountpoint, pnode)) {
+		vfs_decref(pnode);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * This software is licensed under the terms of the MIT-License
+ * See COPYING for further information.
+ * ---
+ * Copyright (c) 2011-2018, Lukas Weber <laochailan@web.de>.
+ * Copyright (c) 2012-2018, Andrei Alexeyev <akari@alienslab.net>.
+ */
+
+#pragma once
+#include "taisei.h"
+
+#include "private.h"
+#include "packfile_public.h"
+
+/*
+ *  Taisei package (.tpk) format, written by scripts/pack.py. All integers are little-endian.
+ *
+ *  header      PackHeader
+ *  entries     PackEntry[num_entries], sorted by name (bytewise)
+ *  buckets     uint32_t[num_buckets], entry index + 1 or 0 if empty; open addressing with linear probing,
+ *              starting at fnv1a32(name) & (num_buckets - 1)
+ *  names       NUL-terminated paths relative to the package root, without leading or trailing slashes
+ *  data        entry contents. Uncompressed ones start on a 4K boundary so that they can be used straight
+ *              from the mapped package
+ *
+ *  Every directory has an entry too. Since entries are sorted, the ones inside a directory are contiguous;
+ *  a directory's offset and size give the index of the first of them and their count.
+ */
+
+#define PACK_MAGIC "TAISEIPK"
+#define PACK_VERSION 1
+
+enum {
+	PACK_ENTRY_DIR = 1,
+	PACK_ENTRY_ZLIB = 2,
+};
+
+typedef struct PackHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_entries;
+	uint32_t num_buckets;
+	uint32_t reserved;
+	uint64_t entries_offset;
+	uint64_t buckets_offset;
+	uint64_t names_offset;
+	uint64_t names_size;
+} PackHeader;
+
+typedef struct PackEntry {
+	uint32_t name_offset;  // relative to names_offset
+	uint32_t name_length;
+	uint32_t hash;
+	uint32_t flags;
+	uint64_t offset;       // of the data, or of the first entry inside for directories
+	uint64_t size;         // of the data as stored, or the number of entries inside for directories
+	uint64_t orig_size;
+	uint32_t crc32;        // of the uncompressed data
+	uint32_t reserved;
+} PackEntry;
+
+bool vfs_packfile_init(VFSNode *node, VFSNode *source);
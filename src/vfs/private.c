@@ -26,6 +26,7 @@ typedef struct vfs_shutdownhook_t {
 static SDL_TLSID vfs_tls_id;
 static vfs_tls_t *vfs_tls_fallback;
 static vfs_shutdownhook_t *shutdown_hooks;
+static SDL_atomic_t vfs_generation_counter;
 
 static void vfs_free(VFSNode *node);
 
@@ -161,6 +162,14 @@ VFSNode* vfs_locate(VFSNode *root, const char *path) {
 	return NULL;
 }
 
+int vfs_generation(void) {
+	return SDL_AtomicGet(&vfs_generation_counter);
+}
+
+void vfs_invalidate_caches(void) {
+	SDL_AtomicIncRef(&vfs_generation_counter);
+}
+
 bool vfs_mount(VFSNode *root, const char *mountpoint, VFSNode *subtree) {
 	VFSNode *mpnode;
 	char buf[2][strlen(mountpoint)+1];
@@ -177,6 +186,7 @@ bool vfs_mount(VFSNode *root, const char *mountpoint, VFSNode *subtree) {
 		if(mpnode->funcs->mount) {
 			// expected to set error on failure
 			result = mpnode->funcs->mount(mpnode, NULL, subtree);
+			vfs_invalidate_caches();
 		} else {
 			result = false;
 			vfs_set_error("Mountpoint '%s' already exists and does not support merging", mountpoint);
@@ -192,6 +202,7 @@ bool vfs_mount(VFSNode *root, const char *mountpoint, VFSNode *subtree) {
 		if(mpnode->funcs->mount) {
 			// expected to set error on failure
 			result = mpnode->funcs->mount(mpnode, mpname, subtree);
+			vfs_invalidate_caches();
 		} else {
 			result = false;
 			vfs_set_error("Parent directory '%s' of mountpoint '%s' does not support mounting", mpbase, mountpoint);
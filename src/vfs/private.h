@@ -68,6 +68,10 @@ bool vfs_mount_or_decref(VFSNode *root, const char *mountpoint, VFSNode *subtree
 const char* vfs_iter(VFSNode *node, void **opaque);
 void vfs_iter_stop(VFSNode *node, void **opaque);
 
+// changes whenever the contents of the tree might have, so that cached lookups know to start over
+int vfs_generation(void);
+void vfs_invalidate_caches(void);
+
 void vfs_set_error(char *fmt, ...) __attribute__((format(FORMAT_ATTR, 1, 2)));
 void vfs_set_error_from_sdl(void);
 
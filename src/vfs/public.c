@@ -43,6 +43,7 @@ bool vfs_unmount(const char *path) {
 
 		if(node->funcs->unmount) {
 			result = node->funcs->unmount(node, subdir);
+			vfs_invalidate_caches();
 		} else {
 			result = false;
 			vfs_set_error("Node '%s' doesn't support unmounting", parent);
@@ -77,6 +78,11 @@ SDL_RWops* vfs_open(const char *path, VFSOpenMode mode) {
 		vfs_set_error("Node '%s' does not exist", path);
 	}
 
+	if(rwops && (mode & VFS_MODE_WRITE)) {
+		// may have created a file
+		vfs_invalidate_caches();
+	}
+
 	return rwops;
 }
 
@@ -100,7 +106,7 @@ VFSInfo vfs_query(const char *path) {
 	return VFSINFO_ERROR;
 }
 
-bool vfs_mkdir(const char *path) {
+static bool vfs_mkdir_internal(const char *path) {
 	char p[strlen(path)+1];
 	path = vfs_path_normalize(path, p);
 	VFSNode *node = vfs_locate(vfs_root, path);
@@ -134,6 +140,12 @@ bool vfs_mkdir(const char *path) {
 	return false;
 }
 
+bool vfs_mkdir(const char *path) {
+	bool ok = vfs_mkdir_internal(path);
+	vfs_invalidate_caches();
+	return ok;
+}
+
 void vfs_mkdir_required(const char *path) {
 	if(!vfs_mkdir(path)) {
 		log_fatal("%s", vfs_get_error());
@@ -155,6 +167,26 @@ char* vfs_repr(const char *path, bool try_syspath) {
 	return NULL;
 }
 
+char* vfs_syspath(const char *path) {
+	char buf[strlen(path)+1];
+	path = vfs_path_normalize(path, buf);
+	VFSNode *node = vfs_locate(vfs_root, path);
+
+	if(!node) {
+		vfs_set_error("Node '%s' does not exist", path);
+		return NULL;
+	}
+
+	char *p = node->funcs->syspath ? node->funcs->syspath(node) : NULL;
+	vfs_decref(node);
+
+	if(!p) {
+		vfs_set_error("Node '%s' is not backed by a system path", path);
+	}
+
+	return p;
+}
+
 bool vfs_print_tree(SDL_RWops *dest, const char *path) {
 	char p[strlen(path)+3], *trail;
 	vfs_path_normalize(path, p);
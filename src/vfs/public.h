@@ -12,6 +12,7 @@
 #include <SDL.h>
 #include <stdbool.h>
 
+#include "packfile_public.h"
 #include "syspath_public.h"
 #include "union_public.h"
 #include "zipfile_public.h"
@@ -53,6 +54,7 @@ int vfs_dir_list_order_ascending(const char **a, const char **b);
 int vfs_dir_list_order_descending(const char **a, const char **b);
 
 char* vfs_repr(const char *path, bool try_syspath);
+char* vfs_syspath(const char *path);
 bool vfs_print_tree(SDL_RWops *dest, const char *path);
 
 // these are defined in private.c, but need to be accessible from external code
@@ -43,6 +43,7 @@ static struct pkg_loader_t {
 	const char *const ext;
 	bool (*mount)(const char *mp, const char *arg);
 } pkg_loaders[] = {
+	{ ".tpk",       vfs_mount_packfile },
 	{ ".zip",       vfs_mount_zipfile },
 	{ NULL },
 };
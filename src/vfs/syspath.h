@@ -15,3 +15,7 @@
 extern char vfs_syspath_preferred_separator;
 bool vfs_syspath_init(VFSNode *node, const char *path);
 void vfs_syspath_normalize(char *buf, size_t bufsize, const char *path);
+
+// maps a whole file read-only; returns NULL if the node isn't a file on the real filesystem, or on failure
+void* vfs_syspath_map(VFSNode *node, size_t *out_size);
+void vfs_syspath_unmap(void *map, size_t size);
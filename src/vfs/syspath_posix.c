@@ -9,6 +9,8 @@
 #include "taisei.h"
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
@@ -154,6 +156,40 @@ void vfs_syspath_normalize(char *buf, size_t bufsize, const char *path) {
 	}
 }
 
+void* vfs_syspath_map(VFSNode *node, size_t *out_size) {
+	if(node->funcs != &vfs_funcs_syspath) {
+		vfs_set_error("Node is not a file on the real filesystem");
+		return NULL;
+	}
+
+	int fd = open(node->_path_, O_RDONLY);
+
+	if(fd < 0) {
+		vfs_set_error("Can't open %s (errno: %i)", (char*)node->_path_, errno);
+		return NULL;
+	}
+
+	struct stat st;
+	void *map = NULL;
+
+	if(fstat(fd, &st) < 0 || st.st_size <= 0) {
+		vfs_set_error("Can't map %s: not a regular file, or empty", (char*)node->_path_);
+	} else if((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		vfs_set_error("Can't map %s (errno: %i)", (char*)node->_path_, errno);
+		map = NULL;
+	} else {
+		*out_size = st.st_size;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+	return map;
+}
+
+void vfs_syspath_unmap(void *map, size_t size) {
+	munmap(map, size);
+}
+
 static void vfs_syspath_init_internal(VFSNode *node, char *path) {
 	vfs_syspath_normalize_inplace(path);
 	node->funcs = &vfs_funcs_syspath;
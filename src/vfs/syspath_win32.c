@@ -274,6 +274,46 @@ static bool vfs_syspath_validate(char *path) {
 	return true;
 }
 
+void* vfs_syspath_map(VFSNode *node, size_t *out_size) {
+	if(node->funcs != &vfs_funcs_syspath) {
+		vfs_set_error("Node is not a file on the real filesystem");
+		return NULL;
+	}
+
+	HANDLE file = CreateFile(node->_wpath_, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if(file == INVALID_HANDLE_VALUE) {
+		vfs_set_error_win32();
+		return NULL;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	void *map = NULL;
+
+	if(!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+		vfs_set_error("Can't map %s: not a regular file, or empty", (char*)node->_path_);
+	} else if(!(mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL))) {
+		vfs_set_error_win32();
+	} else if(!(map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0))) {
+		vfs_set_error_win32();
+	} else {
+		*out_size = size.QuadPart;
+	}
+
+	// the view keeps the mapping and the file alive
+	if(mapping) {
+		CloseHandle(mapping);
+	}
+
+	CloseHandle(file);
+	return map;
+}
+
+void vfs_syspath_unmap(void *map, size_t size) {
+	UnmapViewOfFile(map);
+}
+
 static bool vfs_syspath_init_internal(VFSNode *node, char *path) {
 	vfs_syspath_normalize_inplace(path);
 
@@ -10,10 +10,33 @@
 
 #include "union.h"
 
-#define _members_ data1
 #define _primary_member_ data2
 
+/*
+ *  Locating a path in a union asks every member, so the lookups are cached. The cache maps a path to
+ *  the member that has it rather than to a node, because nodes from zip packages are bound to the thread
+ *  that located them, and the async resource loaders do lookups from their own threads. Paths that no
+ *  member has are cached too, since finding a resource probes several extensions for every name.
+ *
+ *  The cache is dropped whenever the VFS generation changes, i.e. on any mount, unmount, mkdir or write.
+ */
+
+typedef struct VFSUnionData {
+	ListContainer *members;
+	Hashtable *cache;  // NULL for the temporary unions made by vfs_union_locate
+	SDL_mutex *cache_mutex;
+	int cache_generation;
+} VFSUnionData;
+
+// cached for paths that aren't in the union, as opposed to NULL for paths that aren't cached
+static VFSNode vfs_union_not_found;
+
 static bool vfs_union_mount_internal(VFSNode *unode, const char *mountpoint, VFSNode *mountee, VFSInfo info, bool seterror);
+static void vfs_union_init_internal(VFSNode *node, bool cache);
+
+static inline VFSUnionData* vfs_union_data(VFSNode *node) {
+	return node->data1;
+}
 
 static void* vfs_union_delete_callback(List **list, List *elem, void *arg) {
 	ListContainer *c = (ListContainer*)elem;
@@ -24,15 +47,24 @@ static void* vfs_union_delete_callback(List **list, List *elem, void *arg) {
 }
 
 static void vfs_union_free(VFSNode *node) {
-	list_foreach((ListContainer**)&node->_members_, vfs_union_delete_callback, NULL);
+	VFSUnionData *udata = vfs_union_data(node);
+	list_foreach(&udata->members, vfs_union_delete_callback, NULL);
+
+	if(udata->cache) {
+		hashtable_free(udata->cache);
+		SDL_DestroyMutex(udata->cache_mutex);
+	}
+
+	free(udata);
 }
 
-static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
+static VFSNode* vfs_union_locate_uncached(VFSNode *node, const char *path, VFSNode **out_member) {
 	VFSNode *u = vfs_alloc();
-	vfs_union_init(u); // uniception!
+	vfs_union_init_internal(u, false); // uniception!
 
 	VFSInfo prim_info = VFSINFO_ERROR;
-	ListContainer *first = node->_members_;
+	VFSNode *prim_member = NULL;
+	ListContainer *first = vfs_union_data(node)->members;
 	ListContainer *last = first;
 	ListContainer *c;
 
@@ -49,14 +81,17 @@ static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
 
 			if(vfs_union_mount_internal(u, NULL, o, i, false)) {
 				prim_info = i;
+				prim_member = n;
 			} else {
 				vfs_decref(o);
 			}
 		}
 	}
 
+	*out_member = &vfs_union_not_found;
+
 	if(u->_primary_member_) {
-		if(!((List*)(u->_members_))->next || !prim_info.is_dir) {
+		if(!vfs_union_data(u)->members->next || !prim_info.is_dir) {
 			// the temporary union contains just one member, or doesn't represent a directory
 			// in those cases it's just a useless wrapper, so let's just return the primary member directly
 			VFSNode *n = u->_primary_member_;
@@ -68,8 +103,12 @@ static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
 			vfs_decref(u);
 
 			// no need to incref n, vfs_locate did that for us earlier
+			*out_member = prim_member;
 			return n;
 		}
+
+		// a directory merged from several members; can't be reproduced from just one of them
+		*out_member = NULL;
 	} else {
 		// all in vain...
 		vfs_decref(u);
@@ -79,6 +118,58 @@ static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
 	return u;
 }
 
+static VFSNode* vfs_union_locate(VFSNode *node, const char *path) {
+	VFSUnionData *udata = vfs_union_data(node);
+
+	if(!udata->cache) {
+		VFSNode *member;
+		return vfs_union_locate_uncached(node, path, &member);
+	}
+
+	int generation = vfs_generation();
+	VFSNode *member = NULL;
+
+	SDL_LockMutex(udata->cache_mutex);
+
+	if(udata->cache_generation != generation) {
+		hashtable_unset_all(udata->cache);
+		udata->cache_generation = generation;
+	} else {
+		member = hashtable_get_string(udata->cache, path);
+	}
+
+	SDL_UnlockMutex(udata->cache_mutex);
+
+	if(member == &vfs_union_not_found) {
+		return NULL;
+	}
+
+	if(member) {
+		VFSNode *o = vfs_locate(member, path);
+
+		if(o && vfs_query_node(o).exists) {
+			return o;
+		}
+
+		// gone behind our back, e.g. deleted outside of the game
+		vfs_decref(o);
+	}
+
+	VFSNode *o = vfs_union_locate_uncached(node, path, &member);
+
+	if(member) {
+		SDL_LockMutex(udata->cache_mutex);
+
+		if(udata->cache_generation == generation) {
+			hashtable_set_string(udata->cache, path, member);
+		}
+
+		SDL_UnlockMutex(udata->cache_mutex);
+	}
+
+	return o;
+}
+
 typedef struct VFSUnionIterData {
 	Hashtable *visited;
 	ListContainer *current;
@@ -91,7 +182,7 @@ static const char* vfs_union_iter(VFSNode *node, void **opaque) {
 
 	if(!i) {
 		i = malloc(sizeof(VFSUnionIterData));
-		i->current = node->_members_;
+		i->current = vfs_union_data(node)->members;
 		i->opaque = NULL;
 
 		 // XXX: this may not be the most efficient implementation of a "set" structure...
@@ -160,7 +251,7 @@ static bool vfs_union_mount_internal(VFSNode *unode, const char *mountpoint, VFS
 		return false;
 	}
 
-	list_push((ListContainer**)&unode->_members_, list_wrap_container(mountee));
+	list_push(&vfs_union_data(unode)->members, list_wrap_container(mountee));
 	unode->_primary_member_ = mountee;
 
 	return true;
@@ -194,7 +285,7 @@ static SDL_RWops* vfs_union_open(VFSNode *unode, VFSOpenMode mode) {
 static char* vfs_union_repr(VFSNode *node) {
 	char *mlist = strdup("union: "), *r;
 
-	for(ListContainer *c = node->_members_; c; c = c->next) {
+	for(ListContainer *c = vfs_union_data(node)->members; c; c = c->next) {
 		VFSNode *n = c->data;
 
 		strappend(&mlist, r = vfs_repr_node(n, false));
@@ -251,7 +342,20 @@ static VFSNodeFuncs vfs_funcs_union = {
 	.open = vfs_union_open,
 };
 
-void vfs_union_init(VFSNode *node) {
+static void vfs_union_init_internal(VFSNode *node, bool cache) {
+	VFSUnionData *udata = calloc(1, sizeof(VFSUnionData));
+
+	if(cache) {
+		udata->cache = hashtable_new_stringkeys(HT_DYNAMIC_SIZE);
+		udata->cache_mutex = SDL_CreateMutex();
+		udata->cache_generation = vfs_generation();
+	}
+
 	node->funcs = &vfs_funcs_union;
-	node->data1 = node->data2 = NULL;
+	node->data1 = udata;
+	node->data2 = NULL;
+}
+
+void vfs_union_init(VFSNode *node) {
+	vfs_union_init_internal(node, true);
 }
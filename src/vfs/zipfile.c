@@ -10,6 +10,7 @@
 
 #include "zipfile.h"
 #include "zipfile_impl.h"
+#include "syspath.h"
 
 static VFSZipFileTLS* vfs_zipfile_get_tls(VFSNode *node, bool create);
 
@@ -152,7 +153,12 @@ static void vfs_zipfile_free(VFSNode *node) {
 				vfs_decref(zdata->source);
 			}
 
+			if(zdata->map) {
+				vfs_syspath_unmap(zdata->map, zdata->map_size);
+			}
+
 			hashtable_free(zdata->pathmap);
+			free(zdata->stored_offsets);
 			free(zdata);
 		}
 	}
@@ -316,6 +322,119 @@ static void vfs_zipfile_init_pathmap(VFSNode *node) {
 	}
 }
 
+static inline uint16_t zip_read16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t zip_read32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool vfs_zipfile_scan_stored_entries(VFSZipFileData *zdata, zip_t *zip) {
+	// libzip doesn't tell where an entry's data is, so find out from the central directory ourselves.
+	// zip64 archives aren't handled; ours are nowhere near big enough to need it.
+
+	const uint8_t *map = zdata->map;
+	size_t size = zdata->map_size;
+	const uint8_t *eocd = NULL;
+
+	if(size < 22) {
+		return false;
+	}
+
+	// the end of central directory record is followed by a comment of up to 64K
+	for(size_t ofs = size - 22;; --ofs) {
+		if(zip_read32(map + ofs) == 0x06054b50) {
+			eocd = map + ofs;
+			break;
+		}
+
+		if(ofs == 0 || size - ofs > 22 + 0xFFFF) {
+			return false;
+		}
+	}
+
+	uint64_t num = zip_read16(eocd + 10);
+	uint64_t cd_size = zip_read32(eocd + 12);
+	uint64_t cd_ofs = zip_read32(eocd + 16);
+
+	if(num != zip_get_num_entries(zip, 0) || cd_ofs + cd_size > size) {
+		return false;
+	}
+
+	uint64_t *offsets = calloc(num, sizeof(*offsets));
+	const uint8_t *p = map + cd_ofs, *cd_end = p + cd_size;
+
+	for(uint64_t i = 0; i < num; ++i) {
+		if(p + 46 > cd_end || zip_read32(p) != 0x02014b50) {
+			goto fail;
+		}
+
+		uint16_t flags = zip_read16(p + 8);
+		uint16_t method = zip_read16(p + 10);
+		uint32_t comp_size = zip_read32(p + 20);
+		uint32_t orig_size = zip_read32(p + 24);
+		uint16_t name_len = zip_read16(p + 28);
+		uint16_t extra_len = zip_read16(p + 30);
+		uint16_t comment_len = zip_read16(p + 32);
+		uint64_t header_ofs = zip_read32(p + 42);
+		const char *name = (const char*)p + 46;
+
+		if(p + 46 + name_len > cd_end) {
+			goto fail;
+		}
+
+		// make sure our idea of which entry is which matches libzip's
+		const char *zname = zip_get_name(zip, i, ZIP_FL_ENC_RAW);
+
+		if(!zname || strlen(zname) != name_len || memcmp(zname, name, name_len)) {
+			goto fail;
+		}
+
+		// bit 0 means encrypted
+		if(method == ZIP_CM_STORE && !(flags & 1) && comp_size == orig_size && orig_size > 0) {
+			const uint8_t *lh = map + header_ofs;
+
+			if(header_ofs + 30 <= size && zip_read32(lh) == 0x04034b50) {
+				uint64_t data_ofs = header_ofs + 30 + zip_read16(lh + 26) + zip_read16(lh + 28);
+
+				if(data_ofs + orig_size <= size) {
+					offsets[i] = data_ofs;
+				}
+			}
+		}
+
+		p += 46 + name_len + extra_len + comment_len;
+	}
+
+	zdata->stored_offsets = offsets;
+	zdata->num_entries = num;
+	return true;
+
+fail:
+	free(offsets);
+	return false;
+}
+
+static void vfs_zipfile_init_map(VFSNode *node) {
+	VFSZipFileData *zdata = node->data1;
+	VFSZipFileTLS *tls = vfs_zipfile_get_tls(node, true);
+
+	if(!(zdata->map = vfs_syspath_map(zdata->source, &zdata->map_size))) {
+		log_debug("Archive not mapped: %s", vfs_get_error());
+		return;
+	}
+
+	if(!vfs_zipfile_scan_stored_entries(zdata, tls->zip)) {
+		char *r = vfs_repr_node(zdata->source, true);
+		log_warn("Couldn't parse the central directory of '%s'; its entries will be copied on load", r);
+		free(r);
+
+		vfs_syspath_unmap(zdata->map, zdata->map_size);
+		zdata->map = NULL;
+	}
+}
+
 static VFSZipFileTLS* vfs_zipfile_get_tls(VFSNode *node, bool create) {
 	VFSZipFileData *zdata = node->data1;
 	VFSZipFileTLS *tls = SDL_TLSGet(zdata->tls_id);
@@ -364,6 +483,7 @@ bool vfs_zipfile_init(VFSNode *node, VFSNode *source) {
 	}
 
 	vfs_zipfile_init_pathmap(node);
+	vfs_zipfile_init_map(node);
 	return true;
 
 error:
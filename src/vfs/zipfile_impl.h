@@ -25,6 +25,14 @@ typedef struct VFSZipFileData {
 	VFSNode *source;
 	Hashtable *pathmap;
 	SDL_TLSID tls_id;
+
+	// the whole archive mapped into memory, if it's a real file; NULL otherwise
+	uint8_t *map;
+	size_t map_size;
+
+	// per entry: offset of the data in the map if it's stored uncompressed, 0 otherwise
+	uint64_t *stored_offsets;
+	uint64_t num_entries;
 } VFSZipFileData;
 
 typedef struct VFSZipFileIterData {
@@ -84,6 +84,18 @@ static SDL_RWops* vfs_zippath_open(VFSNode *node, VFSOpenMode mode) {
 	}
 
 	VFSZipPathData *zdata = node->data1;
+	VFSZipFileData *zfdata = zdata->zipnode->data1;
+
+	if(zfdata->map && zdata->index < zfdata->num_entries && zfdata->stored_offsets[zdata->index]) {
+		// stored uncompressed: read it straight from the mapped archive, no copies.
+		// the map lives as long as the archive is mounted, which is longer than any resource is loaded.
+		zip_stat_t zstat;
+
+		if(zip_stat_index(zdata->tls->zip, zdata->index, 0, &zstat) == 0 && (zstat.valid & ZIP_STAT_SIZE)) {
+			return SDL_RWFromConstMem(zfdata->map + zfdata->stored_offsets[zdata->index], zstat.size);
+		}
+	}
+
 	zip_file_t *zipfile = zip_fopen_index(zdata->tls->zip, zdata->index, 0);
 
 	if(!zipfile) {
@@ -91,6 +103,26 @@ static SDL_RWops* vfs_zippath_open(VFSNode *node, VFSOpenMode mode) {
 		return NULL;
 	}
 
+	if(mode & VFS_MODE_SEEKABLE) {
+		// decompress into a buffer of the final size in one go, instead of growing one as we read
+		zip_stat_t zstat;
+
+		if(zip_stat_index(zdata->tls->zip, zdata->index, 0, &zstat) == 0 && (zstat.valid & ZIP_STAT_SIZE) && zstat.size > 0) {
+			void *buf;
+			SDL_RWops *bufrw = SDL_RWAutoBuffer(&buf, zstat.size);
+			zip_int64_t read = zip_fread(zipfile, buf, zstat.size);
+
+			if(read != (zip_int64_t)zstat.size) {
+				vfs_set_error("ZIP error: %s", zip_file_strerror(zipfile));
+				SDL_RWclose(bufrw);
+				bufrw = NULL;
+			}
+
+			zip_fclose(zipfile);
+			return bufrw;
+		}
+	}
+
 	SDL_RWops *ziprw = SDL_RWFromZipFile(zipfile, true);
 	assert(ziprw != NULL);
 
@@ -13,6 +13,10 @@
 #include "global.h"
 #include "video.h"
 #include "taiseigl.h"
+#include "glstats.h"
+#include "glmatrix.h"
+#include "glstate.h"
+#include "profiler.h"
 
 Video video;
 static bool libgl_loaded = false;
@@ -75,6 +79,10 @@ void video_set_viewport(void) {
 }
 
 static void video_update_vsync(void) {
+	if(global.null_gl) {
+		return;
+	}
+
 	if(global.frameskip || config_get_int(CONFIG_VSYNC) == 0) {
 		SDL_GL_SetSwapInterval(0);
 	} else {
@@ -139,10 +147,17 @@ static void APIENTRY video_gl_debug_enable(void) {
 #endif
 
 static void video_init_gl(void) {
-	video.glcontext = SDL_GL_CreateContext(video.window);
+	if(global.null_gl) {
+		load_gl_functions_null();
+	} else {
+		video.glcontext = SDL_GL_CreateContext(video.window);
+		load_gl_functions();
+		check_gl_extensions();
+	}
 
-	load_gl_functions();
-	check_gl_extensions();
+	glstats_init();
+	glstate_init();
+	glmatrix_init();
 
 #ifdef DEBUG_GL
 	if(glext.debug_output) {
@@ -281,6 +296,19 @@ static void video_new_window_internal(int w, int h, uint32_t flags, bool fallbac
 	video_new_window_internal(RESX, RESY, flags & ~SDL_WINDOW_FULLSCREEN_DESKTOP, true);
 }
 
+static void video_new_null_window(int w, int h) {
+	// there's no window, we just pretend that we got exactly what was asked for
+	if(!video.current.width) {
+		video_init_gl();
+	}
+
+	video.current.width = video.real.width = w;
+	video.current.height = video.real.height = h;
+	video_set_viewport();
+	video_update_quality();
+	events_emit(TE_VIDEO_MODE_CHANGED, 0, NULL, NULL);
+}
+
 static void video_new_window(int w, int h, bool fs, bool resizable) {
 	uint32_t flags = SDL_WINDOW_OPENGL;
 
@@ -338,6 +366,14 @@ void video_set_mode(int w, int h, bool fs, bool resizable) {
 	video.intended.width = w;
 	video.intended.height = h;
 
+	if(global.null_gl) {
+		if(w != video.current.width || h != video.current.height) {
+			video_new_null_window(w, h);
+		}
+
+		return;
+	}
+
 	if(!video.window) {
 		video_new_window(w, h, fs, resizable);
 		return;
@@ -371,6 +407,11 @@ void video_take_screenshot(void) {
 	struct tm * timeinfo;
 	int w, h, rw, rh;
 
+	if(global.null_gl) {
+		log_warn("Can't take screenshots with the null GL backend");
+		return;
+	}
+
 	w = video.current.width;
 	h = video.current.height;
 
@@ -440,10 +481,18 @@ void video_take_screenshot(void) {
 }
 
 bool video_is_resizable(void) {
+	if(!video.window) {
+		return false;
+	}
+
 	return SDL_GetWindowFlags(video.window) & SDL_WINDOW_RESIZABLE;
 }
 
 bool video_is_fullscreen(void) {
+	if(!video.window) {
+		return false;
+	}
+
 	return WINFLAGS_IS_FULLSCREEN(SDL_GetWindowFlags(video.window));
 }
 
@@ -466,7 +515,11 @@ static void video_cfg_vsync_callback(ConfigIndex idx, ConfigValue v) {
 }
 
 static void video_cfg_resizable_callback(ConfigIndex idx, ConfigValue v) {
-	SDL_SetWindowResizable(video.window, config_set_int(idx, v.i));
+	bool resizable = config_set_int(idx, v.i);
+
+	if(video.window) {
+		SDL_SetWindowResizable(video.window, resizable);
+	}
 }
 
 static void video_quality_callback(ConfigIndex idx, ConfigValue v) {
@@ -548,12 +601,16 @@ void video_init(void) {
 	memset(&video, 0, sizeof(video));
 	memset(&resources.fbo_pairs, 0, sizeof(resources.fbo_pairs));
 
-	video_init_sdl();
-	log_info("Using driver '%s'", SDL_GetCurrentVideoDriver());
+	if(global.null_gl) {
+		log_info("Running without a window");
+	} else {
+		video_init_sdl();
+		log_info("Using driver '%s'", SDL_GetCurrentVideoDriver());
+	}
 
 	// Register all resolutions that are available in fullscreen
 
-	for(int s = 0; s < SDL_GetNumVideoDisplays(); ++s) {
+	for(int s = 0; !global.null_gl && s < SDL_GetNumVideoDisplays(); ++s) {
 		for(int i = 0; i < SDL_GetNumDisplayModes(s); ++i) {
 			SDL_DisplayMode mode = { SDL_PIXELFORMAT_UNKNOWN, 0, 0, 0, 0 };
 
@@ -566,7 +623,7 @@ void video_init(void) {
 		}
 	}
 
-	if(!fullscreen_available) {
+	if(!fullscreen_available && !global.null_gl) {
 		log_warn("No available fullscreen modes");
 		config_set_int(CONFIG_FULLSCREEN, false);
 	}
@@ -605,14 +662,25 @@ void video_init(void) {
 }
 
 void video_shutdown(void) {
-	SDL_DestroyWindow(video.window);
-	SDL_GL_DeleteContext(video.glcontext);
-	unload_gl_library();
+	glstats_shutdown();
+
+	if(!global.null_gl) {
+		SDL_DestroyWindow(video.window);
+		SDL_GL_DeleteContext(video.glcontext);
+		unload_gl_library();
+		SDL_VideoQuit();
+	}
+
 	free(video.modes);
-	SDL_VideoQuit();
 	events_unregister_handler(video_handle_window_event);
 }
 
 void video_swap_buffers(void) {
-	SDL_GL_SwapWindow(video.window);
+	glstats_frame_end();
+
+	if(video.window) {
+		PROFILE_ZONE("swap_buffers") {
+			SDL_GL_SwapWindow(video.window);
+		}
+	}
 }